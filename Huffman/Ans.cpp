@@ -0,0 +1,371 @@
+/*
+ * Ans.cpp - Table-based asymmetric numeral system (tANS) coding of blocks
+ *
+ * Built for EECS2510 - Nonlinear Data Structures
+ *	at The University of Toledo, Spring 2016
+ *
+ * Copyright (c) 2016 Nathan Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "stdafx.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Ans.h"
+
+namespace ans
+{
+	// Returns: The index of the highest set bit of <value>, which must not be zero
+	static unsigned highBit(unsigned value)
+	{
+		unsigned bit = 0;
+		while (value >>= 1) bit++;
+
+		return bit;
+	}
+
+	// Returns: The state after <state> when spreading the bytes over a table of <size> states
+	//
+	// The step is odd and about 5/8 of the table, so it visits every state once before coming back
+	// around, and the states of each byte end up spread out over the whole table
+	static unsigned nextSpreadState(unsigned state, unsigned size)
+	{
+		return (state + (size >> 1) + (size >> 3) + 3) & (size - 1);
+	}
+
+	// Fills <symbols> with the byte that owns each of the 1 << tableLog states
+	static void spread(const Distribution& distribution, std::vector<unsigned char>& symbols)
+	{
+		auto size = 1u << distribution.TableLog;
+		symbols.assign(size, 0);
+
+		unsigned state = 0;
+		for (auto b = 0; b < 256; b++)
+		{
+			for (unsigned i = 0; i < distribution.Counts[b]; i++)
+			{
+				symbols[state] = static_cast<unsigned char>(b);
+				state = nextSpreadState(state, size);
+			}
+		}
+	}
+
+	// Normalizes the weights so they add up to 1 << tableLog, giving every byte with a weight at least one state
+	//
+	// Each byte gets its share of the states, rounded to the nearest state. Rounding (and giving rare
+	// bytes a whole state) leaves the total a little off, which is made up by the most common bytes,
+	// since a state more or less changes their cost the least
+	void Normalize(const unsigned long long weights[256], unsigned tableLog, Distribution& distribution)
+	{
+		if (tableLog < MIN_TABLE_LOG || tableLog > MAX_TABLE_LOG) throw std::invalid_argument("Unsupported table log: " + std::to_string(tableLog));
+
+		distribution.TableLog = tableLog;
+		std::fill(distribution.Counts, distribution.Counts + 256, 0);
+
+		unsigned long long total = 0;
+		for (auto b = 0; b < 256; b++) total += weights[b];
+
+		auto size = 1u << tableLog;
+		if (total == 0)
+		{
+			distribution.Counts[0] = static_cast<unsigned short>(size);
+			return;
+		}
+
+		unsigned sum = 0;
+		auto largest = 0;
+		for (auto b = 0; b < 256; b++)
+		{
+			if (weights[b] == 0) continue;
+
+			auto share = static_cast<double>(weights[b]) * size / total;
+			auto count = std::max(1u, static_cast<unsigned>(share + 0.5));
+
+			distribution.Counts[b] = static_cast<unsigned short>(count);
+			sum += count;
+			if (weights[b] > weights[largest]) largest = b;
+		}
+
+		if (sum < size) distribution.Counts[largest] += static_cast<unsigned short>(size - sum);
+
+		// Too many states: take them back from whichever byte has the most, never going below one
+		while (sum > size)
+		{
+			auto most = std::max_element(distribution.Counts, distribution.Counts + 256) - distribution.Counts;
+			distribution.Counts[most]--;
+			sum--;
+		}
+	}
+
+	// Returns: The number of bits the specified weights encode to with the specified distribution, not
+	// counting the final state
+	//
+	// A byte that owns n of the T states costs log2(T / n) bits, so this is exact up to rounding
+	unsigned long long EncodedBits(const unsigned long long weights[256], const Distribution& distribution)
+	{
+		double bits = 0;
+		for (auto b = 0; b < 256; b++)
+		{
+			if (weights[b] == 0 || distribution.Counts[b] == 0) continue;
+
+			bits += weights[b] * (distribution.TableLog - std::log2(static_cast<double>(distribution.Counts[b])));
+		}
+
+		return static_cast<unsigned long long>(std::ceil(bits));
+	}
+
+	// Appends the distribution to <out>
+	void AppendDistribution(const Distribution& distribution, std::vector<unsigned char>& out)
+	{
+		auto used = 0;
+		for (auto b = 0; b < 256; b++)
+		{
+			if (distribution.Counts[b] > 0) used++;
+		}
+
+		out.push_back(static_cast<unsigned char>(distribution.TableLog));
+		out.push_back(static_cast<unsigned char>(used - 1));
+
+		for (auto b = 0; b < 256; b++)
+		{
+			if (distribution.Counts[b] == 0) continue;
+
+			out.push_back(static_cast<unsigned char>(b));
+			out.push_back(static_cast<unsigned char>(distribution.Counts[b] >> 8));
+			out.push_back(static_cast<unsigned char>(distribution.Counts[b]));
+		}
+	}
+
+	// Reads a distribution written by AppendDistribution from the <size> bytes at <data>
+	size_t ParseDistribution(const unsigned char* data, size_t size, Distribution& distribution)
+	{
+		if (size < 2) throw std::invalid_argument("Unexpected end of block in ANS distribution");
+
+		auto tableLog = data[0];
+		if (tableLog < MIN_TABLE_LOG || tableLog > MAX_TABLE_LOG) throw std::invalid_argument("Unsupported ANS table log: " + std::to_string(tableLog));
+
+		auto used = static_cast<size_t>(data[1]) + 1;
+		if (size - 2 < 3 * used) throw std::invalid_argument("Unexpected end of block in ANS distribution");
+
+		distribution.TableLog = tableLog;
+		std::fill(distribution.Counts, distribution.Counts + 256, 0);
+
+		unsigned sum = 0;
+		for (size_t i = 0; i < used; i++)
+		{
+			auto entry = data + 2 + 3 * i;
+			auto count = static_cast<unsigned short>((entry[1] << 8) | entry[2]);
+			if (count == 0 || distribution.Counts[entry[0]] != 0) throw std::invalid_argument("Invalid ANS distribution entry for byte " + std::to_string(entry[0]));
+
+			distribution.Counts[entry[0]] = count;
+			sum += count;
+		}
+
+		if (sum != 1u << tableLog) throw std::invalid_argument("ANS distribution doesn't add up to the number of states");
+
+		return 2 + 3 * used;
+	}
+
+	// Rebuilds the table for the specified distribution
+	//
+	// The states a byte owns are numbered in table order, and the encoder's next state for the i-th
+	// of them is where it sits in the table. A byte owning n states takes the coder from a state x in
+	// [T, 2T) down to [n, 2n) by giving up the low bits of x, then to the state in the table. Giving up
+	// k bits works for x >= n << k, so the number of bits only depends on which side of that x falls,
+	// which DeltaBits works out with an add and a shift
+	void EncodeTable::Build(const Distribution& distribution)
+	{
+		tableLog = distribution.TableLog;
+		auto size = 1u << tableLog;
+
+		std::vector<unsigned char> symbols;
+		spread(distribution, symbols);
+
+		// Where the states of each byte start in the state table
+		unsigned starts[256];
+		unsigned total = 0;
+		for (auto b = 0; b < 256; b++)
+		{
+			starts[b] = total;
+			total += distribution.Counts[b];
+		}
+
+		states.assign(size, 0);
+		unsigned next[256];
+		std::copy(starts, starts + 256, next);
+		for (unsigned state = 0; state < size; state++)
+		{
+			states[next[symbols[state]]++] = static_cast<unsigned short>(size + state);
+		}
+
+		for (auto b = 0; b < 256; b++)
+		{
+			auto count = distribution.Counts[b];
+			auto& transform = transforms[b];
+
+			if (count == 0)
+			{
+				transform = Transform{ 0, 0 };
+			}
+			else if (count == 1)
+			{
+				transform.DeltaBits = (tableLog << 16) - size;
+				transform.DeltaState = static_cast<int>(starts[b]) - 1;
+			}
+			else
+			{
+				auto maxBits = tableLog - highBit(count - 1u);
+				transform.DeltaBits = (maxBits << 16) - (static_cast<unsigned>(count) << maxBits);
+				transform.DeltaState = static_cast<int>(starts[b]) - count;
+			}
+		}
+	}
+
+	// Appends the <size> bytes at <data>, encoded, to <out>
+	//
+	// The bytes are encoded last to first, starting from the lowest state, and the bits each one gives
+	// up are written little-endian in the order they were given up. The final state comes last, followed
+	// by a single set bit that marks where the bits end, so the decoder can find it from the last byte
+	void EncodeTable::Encode(const unsigned char* data, size_t size, std::vector<unsigned char>& out) const
+	{
+		out.reserve(out.size() + size + 16);
+
+		unsigned long long accumulator = 0;
+		unsigned count = 0;
+		auto put = [&](unsigned value, unsigned bits)
+		{
+			accumulator |= static_cast<unsigned long long>(value) << count;
+			count += bits;
+
+			if (count >= 32)
+			{
+				for (auto i = 0; i < 4; i++)
+				{
+					out.push_back(static_cast<unsigned char>(accumulator));
+					accumulator >>= 8;
+				}
+				count -= 32;
+			}
+		};
+
+		unsigned state = 1u << tableLog;
+		for (auto i = size; i > 0; i--)
+		{
+			auto& transform = transforms[data[i - 1]];
+
+			// A byte that owns no states has an empty transform, which would index past the state table
+			if (transform.DeltaBits == 0) throw std::invalid_argument("Byte " + std::to_string(data[i - 1]) + " does not own any states");
+
+			auto bits = (state + transform.DeltaBits) >> 16;
+
+			put(state & ((1u << bits) - 1), bits);
+			state = states[static_cast<int>(state >> bits) + transform.DeltaState];
+		}
+
+		put(state - (1u << tableLog), tableLog);
+		put(1, 1);
+
+		for (; count > 0; count = count > 8 ? count - 8 : 0)
+		{
+			out.push_back(static_cast<unsigned char>(accumulator));
+			accumulator >>= 8;
+		}
+	}
+
+	// Rebuilds the table for the specified distribution
+	//
+	// Decoding a state undoes the encoder's step: the i-th state a byte owning n states has in the
+	// table came from n + i, which is shifted back up into [T, 2T) with the bits the encoder gave up
+	void DecodeTable::Build(const Distribution& distribution)
+	{
+		tableLog = distribution.TableLog;
+		auto size = 1u << tableLog;
+
+		std::vector<unsigned char> symbols;
+		spread(distribution, symbols);
+
+		unsigned next[256];
+		for (auto b = 0; b < 256; b++) next[b] = distribution.Counts[b];
+
+		entries.resize(size);
+		for (unsigned state = 0; state < size; state++)
+		{
+			auto symbol = symbols[state];
+			auto from = next[symbol]++;
+			auto bits = tableLog - highBit(from);
+
+			entries[state] = Entry{ static_cast<unsigned short>((from << bits) - size), symbol, static_cast<unsigned char>(bits) };
+		}
+	}
+
+	// Decodes the <size> encoded bytes at <data> into the <count> bytes at <out>
+	//
+	// The bits are read backwards from the marker at the end. Each read loads the eight bytes around
+	// the bits it wants, except in the last eight bytes of the input, where it gathers them one at a time
+	bool DecodeTable::Decode(const unsigned char* data, size_t size, unsigned char* out, size_t count) const
+	{
+		if (size == 0 || data[size - 1] == 0) return false;
+
+		// The number of bits left to read, which are the ones before the marker
+		auto position = (size - 1) * 8 + highBit(data[size - 1]);
+
+		auto read = [&](unsigned bits, unsigned& value)
+		{
+			if (bits > position) return false;
+			position -= bits;
+
+			auto byte = position >> 3;
+			unsigned long long word = 0;
+			if (byte + 8 <= size)
+			{
+				// All of our targets are little-endian
+				std::memcpy(&word, data + byte, sizeof(word));
+			}
+			else
+			{
+				for (auto i = byte; i < size; i++) word |= static_cast<unsigned long long>(data[i]) << (8 * (i - byte));
+			}
+
+			value = static_cast<unsigned>(word >> (position & 7)) & ((1u << bits) - 1);
+			return true;
+		};
+
+		unsigned state;
+		if (!read(tableLog, state)) return false;
+
+		for (size_t i = 0; i < count; i++)
+		{
+			auto& entry = entries[state];
+			out[i] = entry.Symbol;
+
+			unsigned bits;
+			if (!read(entry.Bits, bits)) return false;
+			state = entry.NextState + bits;
+		}
+
+		// The encoder started from the lowest state and every bit it wrote has been read back
+		return state == 0 && position == 0;
+	}
+}
@@ -0,0 +1,145 @@
+/*
+ * Ans.h - Table-based asymmetric numeral system (tANS) coding of blocks
+ *
+ * Built for EECS2510 - Nonlinear Data Structures
+ *	at The University of Toledo, Spring 2016
+ *
+ * Copyright (c) 2016 Nathan Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+#include <vector>
+
+// Table-based asymmetric numeral systems (tANS), as an alternative to Huffman codes
+//
+// A Huffman code spends a whole number of bits on every byte, so a byte that makes up 90% of
+// the input still costs a full bit instead of the 0.15 bits it carries. tANS gets around that
+// by keeping the coder in one of 1 << tableLog states: each byte moves the coder to a new state
+// and gives up however many bits that takes, which over many bytes averages out to very close
+// to the information the byte carries. Decoding is a table lookup and a bit read per byte, like
+// a Huffman decoding table.
+//
+// The byte weights are normalized so they add up to the number of states, and each byte owns as
+// many states as its normalized weight. The encoder works through the input backwards, so the
+// decoder can go forwards, which means the decoder reads the encoded bits from the end.
+namespace ans
+{
+	// The number of bits the states are indexed by, unless asked for something else
+	const unsigned DEFAULT_TABLE_LOG = 11;
+	// The fewest bits the states can be indexed by. There must be a state for every byte
+	const unsigned MIN_TABLE_LOG = 8;
+	// The most bits the states can be indexed by. Bigger tables code closer to the weights but
+	// stop fitting in the first level cache
+	const unsigned MAX_TABLE_LOG = 12;
+
+	// Byte weights normalized to add up to the number of states
+	struct Distribution
+	{
+		// The number of bits the states are indexed by
+		unsigned TableLog = DEFAULT_TABLE_LOG;
+		// The number of states each byte owns. Bytes that never occur own none
+		unsigned short Counts[256] = {};
+	};
+
+	// Normalizes the weights so they add up to 1 << tableLog, giving every byte with a weight at least one state
+	//
+	// If there are no weights at all, byte 0 gets every state
+	void Normalize(const unsigned long long weights[256], unsigned tableLog, Distribution& distribution);
+
+	// Returns: The number of bits the specified weights encode to with the specified distribution, not
+	// counting the final state
+	unsigned long long EncodedBits(const unsigned long long weights[256], const Distribution& distribution);
+
+	// Appends the distribution to <out>
+	//
+	// Format:
+	//		1 Byte  - The table log
+	//		1 Byte  - The number of bytes that own states, minus one
+	//		3 Bytes - For each of them, the byte and the number of states it owns, big-endian
+	void AppendDistribution(const Distribution& distribution, std::vector<unsigned char>& out);
+
+	// Reads a distribution written by AppendDistribution from the <size> bytes at <data>
+	//
+	// Returns: The number of bytes the distribution took up
+	// Throws: std::invalid_argument if it's malformed or the counts don't add up to the number of states
+	size_t ParseDistribution(const unsigned char* data, size_t size, Distribution& distribution);
+
+	// Encodes bytes with the states of a distribution
+	class EncodeTable
+	{
+	public:
+		// Rebuilds the table for the specified distribution
+		void Build(const Distribution& distribution);
+
+		// Appends the <size> bytes at <data>, encoded, to <out>
+		//
+		// Throws: std::invalid_argument if a byte doesn't own any states in the distribution
+		void Encode(const unsigned char* data, size_t size, std::vector<unsigned char>& out) const;
+
+	private:
+		// How to move to a new state for each byte
+		struct Transform
+		{
+			// Added to the state to get the number of bits to give up, in the high 16 bits
+			unsigned DeltaBits;
+			// Added to the state (after the bits are given up) to find the next state in the table
+			int DeltaState;
+		};
+
+		// The number of bits the states are indexed by
+		unsigned tableLog = 0;
+		// The transform for each byte
+		Transform transforms[256] = {};
+		// The next state for each (byte, reduced state), grouped by byte. States are offset by the table size
+		std::vector<unsigned short> states;
+	};
+
+	// Decodes bytes encoded with the states of a distribution
+	class DecodeTable
+	{
+	public:
+		// Rebuilds the table for the specified distribution
+		void Build(const Distribution& distribution);
+
+		// Decodes the <size> encoded bytes at <data> into the <count> bytes at <out>
+		//
+		// Returns: false iff the input ran out of bits before <count> bytes were decoded, or didn't end
+		// where the encoder started
+		bool Decode(const unsigned char* data, size_t size, unsigned char* out, size_t count) const;
+
+	private:
+		// What to do in each state
+		struct Entry
+		{
+			// Added to the bits read to get the next state
+			unsigned short NextState;
+			// The byte decoded in this state
+			unsigned char Symbol;
+			// The number of bits to read for the next state
+			unsigned char Bits;
+		};
+
+		// The number of bits the states are indexed by
+		unsigned tableLog = 0;
+		// The entry for each state
+		std::vector<Entry> entries;
+	};
+}
@@ -0,0 +1,438 @@
+/*
+ * Batch.cpp - Encodes and decodes many files at once on a pool of workers, to separate files or an archive
+ *
+ * Built for EECS2510 - Nonlinear Data Structures
+ *	at The University of Toledo, Spring 2016
+ *
+ * Copyright (c) 2016 Nathan Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "stdafx.h"
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Batch.h"
+#include "ByteSink.h"
+#include "Dictionary.h"
+#include "HuffmanEncoder.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+#include "Pipeline.h"
+#include "Verbose.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace batch
+{
+#ifdef _WIN32
+	// Separates a directory from the names inside it
+	static const char SEPARATOR = '\\';
+#else
+	static const char SEPARATOR = '/';
+#endif
+
+	// The size of the index entry of a member, not counting its name
+	static const size_t INDEX_ENTRY_SIZE = 2 + 8 + 8;
+	// The size of the member count and index offset at the end of an archive
+	static const size_t TRAILER_SIZE = 4 + 8;
+
+	// An encoded file on its way into an archive
+	struct Member
+	{
+		// The encoded file
+		std::vector<unsigned char> Data;
+		// The size of the original file
+		unsigned long long Size = 0;
+	};
+
+	// Returns: The part of <path> after its last directory separator
+	static std::string fileName(const std::string& path)
+	{
+		auto slash = path.find_last_of("/\\");
+		return slash == std::string::npos ? path : path.substr(slash + 1);
+	}
+
+	// Returns: true iff <name> can be written inside a directory without ending up outside of it
+	static bool isPlainName(const std::string& name)
+	{
+		return !name.empty() && name != "." && name != ".." && name.find_first_of("/\\") == std::string::npos;
+	}
+
+	// Returns: <directory> and <name> joined with a separator
+	static std::string joinPath(const std::string& directory, const std::string& name)
+	{
+		return directory + SEPARATOR + name;
+	}
+
+	// Returns: true iff <path> is a directory
+	static bool isDirectory(const std::string& path)
+	{
+#ifdef _WIN32
+		auto attributes = GetFileAttributesA(path.c_str());
+		return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+#else
+		struct stat info;
+		return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+	}
+
+	// Creates the directory at <path> and any of its parents that don't exist yet
+	//
+	// Throws: std::runtime_error if a directory can't be created
+	static void makeDirectory(const std::string& path)
+	{
+		if (path.empty() || isDirectory(path)) return;
+
+		auto slash = path.find_last_of("/\\");
+		if (slash != std::string::npos && slash > 0) makeDirectory(path.substr(0, slash));
+
+#ifdef _WIN32
+		auto created = CreateDirectoryA(path.c_str(), nullptr) != 0;
+#else
+		auto created = mkdir(path.c_str(), 0777) == 0;
+#endif
+
+		// Another process may have made it in the meantime
+		if (!created && !isDirectory(path)) throw std::runtime_error("Cannot create directory " + path);
+	}
+
+	// Appends the low <bytes> bytes of <value> to <out>, big-endian
+	static void appendUInt(std::vector<unsigned char>& out, unsigned long long value, unsigned bytes)
+	{
+		for (auto shift = static_cast<int>(bytes * 8) - 8; shift >= 0; shift -= 8)
+		{
+			out.push_back(static_cast<unsigned char>(value >> shift));
+		}
+	}
+
+	// Reads a <bytes> byte big-endian integer at <position> and moves past it
+	//
+	// Throws: std::invalid_argument if it runs past <size>
+	static unsigned long long readUInt(const unsigned char* data, size_t size, size_t& position, unsigned bytes)
+	{
+		if (size - position < bytes) throw std::invalid_argument("Archive index is corrupt");
+
+		unsigned long long value = 0;
+		for (unsigned i = 0; i < bytes; i++) value = (value << 8) | data[position++];
+
+		return value;
+	}
+
+	// Returns: The contents of <source>, which are read into <contents> if it isn't mapped, and their size in <size>
+	static const unsigned char* loadFile(const MappedFile& source, std::vector<unsigned char>& contents, size_t& size)
+	{
+		if (source.IsMapped())
+		{
+			size = source.Size();
+			return source.Data();
+		}
+
+		std::ifstream reader;
+		reader.open(source.Path(), std::ios::binary);
+		if (!reader.is_open() || !reader.good()) throw std::runtime_error("Cannot open " + source.Path() + " for read");
+
+		contents.assign(std::istreambuf_iterator<char>(reader), std::istreambuf_iterator<char>());
+		size = contents.size();
+		return contents.data();
+	}
+
+	// Writes the <size> bytes at <data> to a new file at <path>
+	static void saveFile(const std::string& path, const unsigned char* data, size_t size)
+	{
+		std::ofstream writer;
+		writer.open(path, std::ios::binary);
+		if (!writer.is_open() || !writer.good()) throw std::runtime_error("Cannot open " + path + " for write");
+
+		if (!writer.write(reinterpret_cast<const char*>(data), size)) throw std::runtime_error("Failed to write " + path);
+	}
+
+	// Encodes the file at <path> with an encoder built by <factory> into <encoded>
+	//
+	// Returns: The size of the original file
+	static unsigned long long encodeFile(const std::string& path, const Factory& factory, std::vector<unsigned char>& encoded)
+	{
+		MappedFile source(path);
+		std::vector<unsigned char> contents;
+		size_t size;
+		auto data = loadFile(source, contents, size);
+
+		// The batch is spread over the workers, so every file is coded on a single thread
+		std::unique_ptr<HuffmanEncoder> encoder(factory(data, size));
+		encoder->SetThreads(1);
+		encoder->Encode(data, size, encoded);
+
+		return size;
+	}
+
+	// Throws: std::invalid_argument if two of the files have the same name, since they would be
+	// written to the same place
+	static void checkNames(const std::vector<std::string>& files)
+	{
+		std::set<std::string> names;
+		for (auto& path : files)
+		{
+			auto name = fileName(path);
+			if (!isPlainName(name)) throw std::invalid_argument("Not a file name: " + path);
+			if (!names.insert(name).second) throw std::invalid_argument("More than one file is named " + name);
+		}
+	}
+
+	// Returns: The files in <input>, which is either a directory or a text file listing one path per line
+	std::vector<std::string> ListInputs(const std::string& input)
+	{
+		if (isDirectory(input)) return dictionary::ListFiles(input);
+
+		std::ifstream reader;
+		reader.open(input);
+		if (!reader.is_open() || !reader.good()) throw std::runtime_error("Unable to read file list " + input);
+
+		std::vector<std::string> result;
+		std::string line;
+		while (std::getline(reader, line))
+		{
+			// Lists written on Windows end their lines with "\r\n"
+			if (!line.empty() && line.back() == '\r') line.pop_back();
+			if (!line.empty()) result.push_back(line);
+		}
+
+		return result;
+	}
+
+	// Encodes every file in <files>, writing each one to <directory> under its own name with ENCODED_EXTENSION added
+	Totals EncodeToDirectory(const std::vector<std::string>& files, const std::string& directory, const Factory& factory, unsigned workers)
+	{
+		checkNames(files);
+		makeDirectory(directory);
+
+		auto threads = parallel::ThreadCount(workers);
+		verbose::write("Encoding " + std::to_string(files.size()) + " files to " + directory + " on " + std::to_string(threads) + " workers");
+
+		Totals totals;
+		std::mutex totalsLock;
+
+		parallel::For(files.size(), threads, [&](size_t i)
+		{
+			std::vector<unsigned char> encoded;
+			auto size = encodeFile(files[i], factory, encoded);
+			saveFile(joinPath(directory, fileName(files[i]) + ENCODED_EXTENSION), encoded.data(), encoded.size());
+
+			std::lock_guard<std::mutex> guard(totalsLock);
+			totals.Files++;
+			totals.BytesRead += size;
+			totals.BytesWritten += encoded.size();
+		});
+
+		return totals;
+	}
+
+	// Encodes every file in <files> into a single archive at <path>
+	//
+	// The files are encoded by a pipeline (see pipeline::Run), which hands them to the workers in turn
+	// and gives them back in the same order, so the archive is the same however many workers there are
+	Totals EncodeToArchive(const std::vector<std::string>& files, const std::string& path, const Factory& factory, unsigned workers)
+	{
+		checkNames(files);
+
+		auto threads = parallel::ThreadCount(workers);
+		verbose::write("Encoding " + std::to_string(files.size()) + " files into " + path + " on " + std::to_string(threads) + " workers");
+
+		std::ofstream writer;
+		writer.open(path, std::ios::binary);
+		if (!writer.is_open() || !writer.good()) throw std::runtime_error("Cannot open " + path + " for write");
+
+		StreamSink out(writer);
+		out.Put(static_cast<unsigned char>(ARCHIVE_HEADER >> 8));
+		out.Put(static_cast<unsigned char>(ARCHIVE_HEADER & 0xFF));
+		out.Put(ARCHIVE_VERSION);
+
+		Totals totals;
+		std::vector<unsigned char> index;
+		size_t next = 0;
+
+		pipeline::Run<size_t, Member>(threads,
+			[&](size_t& item)
+			{
+				if (next == files.size()) return false;
+
+				item = next++;
+				return true;
+			},
+			[&](size_t& item, Member& member)
+			{
+				member.Data.clear();
+				member.Size = encodeFile(files[item], factory, member.Data);
+			},
+			[&](Member& member)
+			{
+				// Members come back in the order their files were handed out
+				auto name = fileName(files[totals.Files]);
+				out.Write(member.Data.data(), member.Data.size());
+
+				appendUInt(index, name.size(), 2);
+				index.insert(index.end(), name.begin(), name.end());
+				appendUInt(index, member.Size, 8);
+				appendUInt(index, member.Data.size(), 8);
+
+				totals.Files++;
+				totals.BytesRead += member.Size;
+			});
+
+		auto indexOffset = out.BytesWritten();
+		appendUInt(index, totals.Files, 4);
+		appendUInt(index, indexOffset, 8);
+		out.Write(index.data(), index.size());
+
+		writer.flush();
+		totals.BytesWritten = out.BytesWritten();
+
+		return totals;
+	}
+
+	// Decodes every encoded file in <files>, writing each one to <directory> under its own name with ENCODED_EXTENSION removed
+	Totals DecodeToDirectory(const std::vector<std::string>& files, const std::string& directory, const Factory& factory, unsigned workers)
+	{
+		checkNames(files);
+		makeDirectory(directory);
+
+		auto threads = parallel::ThreadCount(workers);
+		verbose::write("Decoding " + std::to_string(files.size()) + " files to " + directory + " on " + std::to_string(threads) + " workers");
+
+		Totals totals;
+		std::mutex totalsLock;
+
+		parallel::For(files.size(), threads, [&](size_t i)
+		{
+			auto name = fileName(files[i]);
+			auto extension = ENCODED_EXTENSION.size();
+			if (name.size() > extension && name.compare(name.size() - extension, extension, ENCODED_EXTENSION) == 0) name.resize(name.size() - extension);
+
+			MappedFile source(files[i]);
+			std::vector<unsigned char> contents;
+			size_t size;
+			auto data = loadFile(source, contents, size);
+
+			std::vector<unsigned char> decoded;
+			std::unique_ptr<HuffmanEncoder> decoder(factory(data, size));
+			decoder->SetThreads(1);
+			decoder->Decode(data, size, decoded);
+
+			saveFile(joinPath(directory, name), decoded.data(), decoded.size());
+
+			std::lock_guard<std::mutex> guard(totalsLock);
+			totals.Files++;
+			totals.BytesRead += size;
+			totals.BytesWritten += decoded.size();
+		});
+
+		return totals;
+	}
+
+	// Decodes every member of the archive at <path>, writing each one to <directory> under its own name
+	//
+	// The index is read and checked first, so the members can be decoded in any order
+	Totals ExtractArchive(const std::string& path, const std::string& directory, const Factory& factory, unsigned workers)
+	{
+		MappedFile source(path);
+		std::vector<unsigned char> contents;
+		size_t size;
+		auto data = loadFile(source, contents, size);
+
+		if (size < 3 + TRAILER_SIZE || ((data[0] << 8) | data[1]) != ARCHIVE_HEADER) throw std::invalid_argument("Not an archive");
+		if (data[2] != ARCHIVE_VERSION) throw std::invalid_argument("Don't know how to read archive version " + std::to_string(data[2]));
+
+		size_t position = size - TRAILER_SIZE;
+		auto count = static_cast<size_t>(readUInt(data, size, position, 4));
+		auto indexOffset = readUInt(data, size, position, 8);
+		if (indexOffset < 3 || indexOffset > size - TRAILER_SIZE) throw std::invalid_argument("Archive index is corrupt");
+
+		// Every entry takes up at least its sizes, which bounds the count before anything is allocated
+		auto indexSize = size - TRAILER_SIZE - static_cast<size_t>(indexOffset);
+		if (count > indexSize / INDEX_ENTRY_SIZE) throw std::invalid_argument("Archive index is corrupt");
+
+		std::vector<std::string> names(count);
+		std::vector<unsigned long long> sizes(count);
+		std::vector<size_t> starts(count + 1);
+
+		position = static_cast<size_t>(indexOffset);
+		auto indexEnd = size - TRAILER_SIZE;
+		starts[0] = 3;
+		for (size_t i = 0; i < count; i++)
+		{
+			auto nameSize = static_cast<size_t>(readUInt(data, indexEnd, position, 2));
+			if (indexEnd - position < nameSize) throw std::invalid_argument("Archive index is corrupt");
+
+			names[i].assign(reinterpret_cast<const char*>(data + position), nameSize);
+			position += nameSize;
+			if (!isPlainName(names[i])) throw std::invalid_argument("Archive member has an invalid name: " + names[i]);
+
+			sizes[i] = readUInt(data, indexEnd, position, 8);
+			auto encodedSize = readUInt(data, indexEnd, position, 8);
+			if (encodedSize > indexOffset - starts[i]) throw std::invalid_argument("Archive index is corrupt");
+
+			starts[i + 1] = starts[i] + static_cast<size_t>(encodedSize);
+		}
+
+		if (position != indexEnd || starts[count] != indexOffset) throw std::invalid_argument("Archive index is corrupt");
+
+		makeDirectory(directory);
+
+		auto threads = parallel::ThreadCount(workers);
+		verbose::write("Extracting " + std::to_string(count) + " files to " + directory + " on " + std::to_string(threads) + " workers");
+
+		Totals totals;
+		totals.BytesRead = size;
+		std::mutex totalsLock;
+
+		parallel::For(count, threads, [&](size_t i)
+		{
+			auto member = data + starts[i];
+			auto memberSize = starts[i + 1] - starts[i];
+
+			std::ofstream writer;
+			auto output = joinPath(directory, names[i]);
+			writer.open(output, std::ios::binary);
+			if (!writer.is_open() || !writer.good()) throw std::runtime_error("Cannot open " + output + " for write");
+
+			StreamSink sink(writer);
+			std::unique_ptr<HuffmanEncoder> decoder(factory(member, memberSize));
+			decoder->SetThreads(1);
+			decoder->Decode(member, memberSize, sink);
+
+			if (sink.BytesWritten() != sizes[i]) throw std::runtime_error("Archive member " + names[i] + " is corrupt");
+
+			std::lock_guard<std::mutex> guard(totalsLock);
+			totals.Files++;
+			totals.BytesWritten += sink.BytesWritten();
+		});
+
+		return totals;
+	}
+}
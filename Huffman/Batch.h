@@ -0,0 +1,107 @@
+/*
+ * Batch.h - Encodes and decodes many files at once on a pool of workers, to separate files or an archive
+ *
+ * Built for EECS2510 - Nonlinear Data Structures
+ *	at The University of Toledo, Spring 2016
+ *
+ * Copyright (c) 2016 Nathan Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+
+class HuffmanEncoder;
+
+// A batch encodes every file in a directory (or a list of files) with a single process, so
+// the cost of starting up is paid once instead of once per file. Files are handed out to a pool
+// of workers, each of which builds its own encoder, and the encoded files are written either
+// next to each other in a directory or one after another in a single archive.
+namespace batch
+{
+	// 'ha' Magic Header to distinguish archives
+	const unsigned short ARCHIVE_HEADER = 0x6861;
+	// The archive format version
+	const unsigned char ARCHIVE_VERSION = 0x01;
+
+	// The extension given to encoded files written to a directory
+	const std::string ENCODED_EXTENSION = ".hz";
+
+	// Builds the encoder a file is coded with from its <size> bytes at <data>
+	//
+	// Decoders are built from the encoded file, so most factories for decoding ignore them
+	typedef std::function<HuffmanEncoder*(const unsigned char* data, size_t size)> Factory;
+
+	// The sizes of everything in a batch
+	struct Totals
+	{
+		// The number of files coded
+		size_t Files = 0;
+		// The number of bytes read from the inputs
+		unsigned long long BytesRead = 0;
+		// The number of bytes written to the outputs
+		unsigned long long BytesWritten = 0;
+	};
+
+	// Returns: The files in <input>, which is either a directory (every regular file directly inside
+	// it, sorted by name) or a text file listing one path per line
+	//
+	// Throws: std::runtime_error if it can't be read
+	std::vector<std::string> ListInputs(const std::string& input);
+
+	// Encodes every file in <files> on <workers> threads (0 for one per core), writing each one to
+	// <directory> under its own name with ENCODED_EXTENSION added. The directory is created if it doesn't exist
+	//
+	// Throws: std::invalid_argument if two files have the same name
+	Totals EncodeToDirectory(const std::vector<std::string>& files, const std::string& directory, const Factory& factory, unsigned workers);
+
+	// Encodes every file in <files> on <workers> threads (0 for one per core) into a single archive at <path>
+	//
+	// Files are written to the archive in the order they are listed in, whichever worker finishes first.
+	// Only a few encoded files are held in memory at once
+	//
+	// File Format:
+	//		2 Bytes - 0x6861 - 'ha' Magic Header to distinguish archives
+	//		1 Byte  - 0x01   - Archive format version number
+	//		Members - Variable, every encoded file, one after another
+	//		Index   - Variable, for every member:
+	//			2 Bytes - The length of its name
+	//			Name    - Variable, the name of the file it was encoded from, without its directory
+	//			8 Bytes - The size of the original file
+	//			8 Bytes - The size of the encoded file
+	//		4 Bytes - The number of members
+	//		8 Bytes - The offset of the index from the start of the archive
+	//
+	//	All integers are big-endian. Members start right after the version and follow each other,
+	//	so the offset of each is the sum of the encoded sizes before it
+	Totals EncodeToArchive(const std::vector<std::string>& files, const std::string& path, const Factory& factory, unsigned workers);
+
+	// Decodes every encoded file in <files> on <workers> threads (0 for one per core), writing each
+	// one to <directory> under its own name with ENCODED_EXTENSION removed. The directory is created if it doesn't exist
+	Totals DecodeToDirectory(const std::vector<std::string>& files, const std::string& directory, const Factory& factory, unsigned workers);
+
+	// Decodes every member of the archive at <path> on <workers> threads (0 for one per core),
+	// writing each one to <directory> under its own name. The directory is created if it doesn't exist
+	//
+	// Throws: std::invalid_argument if the file is not an archive or its index is corrupt
+	Totals ExtractArchive(const std::string& path, const std::string& directory, const Factory& factory, unsigned workers);
+}
@@ -0,0 +1,123 @@
+/*
+ * BitReader.h - Reads a big-endian bitstream through a 64-bit bit buffer
+ *
+ * Built for EECS2510 - Nonlinear Data Structures
+ *	at The University of Toledo, Spring 2016
+ *
+ * Copyright (c) 2016 Nathan Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+#include <cstring>
+
+#ifdef _MSC_VER
+#include <stdlib.h>
+#endif
+
+// Reads bits most-significant first from an in-memory buffer
+//
+// Bits are kept left-aligned in a 64-bit buffer so that the next N bits of the
+// input can be inspected with a single shift. Once the input runs out, the buffer
+// is padded with zeros and Available() reports how many of the bits are real.
+class BitReader
+{
+public:
+	// The number of bits that are guaranteed to be available after a refill
+	// (unless the end of the input was reached)
+	static const unsigned REFILL_BITS = 57;
+
+	// Construct a bit reader over the specified in-memory buffer
+	BitReader(const unsigned char* data, size_t size) : cursor(data), end(data + size) {}
+
+	// Tops up the bit buffer so that at least REFILL_BITS bits are available,
+	// or as many bits as remain in the input
+	void Refill()
+	{
+		// Fast path: read eight bytes at once and keep as many as fit in the buffer
+		//
+		// The bits beyond <count> are the real next bits of the input, so or-ing the
+		// same bytes in again on the next refill does not change them
+		if (end - cursor >= 8)
+		{
+			buffer |= LoadBigEndian(cursor) >> count;
+			cursor += (63 - count) >> 3;
+			count |= 56;
+			return;
+		}
+
+		while (count <= 56)
+		{
+			if (cursor == end) return;
+
+			buffer |= static_cast<unsigned long long>(*cursor++) << (56 - count);
+			count += 8;
+		}
+	}
+
+	// Returns: The eight bytes at <bytes> as a big-endian integer
+	static unsigned long long LoadBigEndian(const unsigned char* bytes)
+	{
+		unsigned long long value;
+		std::memcpy(&value, bytes, sizeof(value));
+
+		// All of our targets are little-endian
+#ifdef _MSC_VER
+		return _byteswap_uint64(value);
+#else
+		return __builtin_bswap64(value);
+#endif
+	}
+
+	// Returns the next <bits> bits of the input without consuming them
+	//
+	// <bits> must be between 1 and 64. Bits past the end of the input read as zero
+	unsigned long long Peek(unsigned bits) const
+	{
+		return buffer >> (64 - bits);
+	}
+
+	// Discards the next <bits> bits of the input. At most Available() bits may be consumed
+	void Consume(unsigned bits)
+	{
+		buffer <<= bits;
+		count -= bits;
+	}
+
+	// Returns the number of real input bits currently held in the bit buffer
+	unsigned Available() const
+	{
+		return count;
+	}
+
+private:
+	// The decoding table keeps the bit buffer in registers in its inner loop
+	friend class HuffmanDecodeTable;
+
+	// The bit buffer, left-aligned
+	unsigned long long buffer = 0;
+	// The number of valid bits in the bit buffer
+	unsigned count = 0;
+
+	// The next byte to load into the bit buffer
+	const unsigned char* cursor = nullptr;
+	// One past the last byte of the input
+	const unsigned char* end = nullptr;
+};
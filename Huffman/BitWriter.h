@@ -0,0 +1,137 @@
+/*
+ * BitWriter.h - Writes a big-endian bitstream through a 64-bit bit accumulator
+ *
+ * Built for EECS2510 - Nonlinear Data Structures
+ *	at The University of Toledo, Spring 2016
+ *
+ * Copyright (c) 2016 Nathan Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+#include <vector>
+
+#include "ByteSink.h"
+
+// Writes bits most-significant first into a large output buffer
+//
+// Bits are appended to the low end of a 64-bit accumulator, and every time it holds
+// 32 bits or more, the oldest 32 are moved to the output buffer as a single word.
+// The output buffer is written to the sink (or appended to a vector) once it fills up.
+class BitWriter
+{
+public:
+	// The size of the buffer encoded bytes are collected in before being written to the sink
+	static const size_t BUFFER_SIZE = 1 << 20;
+
+	// The size of the buffer used when appending to a vector, which is already in memory
+	static const size_t VECTOR_BUFFER_SIZE = 1 << 16;
+
+	// The most bits that can be written with a single call to Put
+	static const unsigned MAX_PUT_BITS = 32;
+
+	// Construct a bit writer that writes to the specified sink
+	explicit BitWriter(ByteSink& sink) : sink(&sink), buffer(BUFFER_SIZE) {}
+
+	// Construct a bit writer that writes to the specified sink, with a buffer no bigger than needed
+	// for about <expected> bytes of output (but at least a word)
+	BitWriter(ByteSink& sink, size_t expected) : sink(&sink), buffer(expected < 4 ? 4 : expected < BUFFER_SIZE ? expected : BUFFER_SIZE) {}
+
+	// Construct a bit writer that appends to the specified vector
+	explicit BitWriter(std::vector<unsigned char>& target) : target(&target), buffer(VECTOR_BUFFER_SIZE) {}
+
+	// Appends the low <bits> bits of <value> to the output
+	//
+	// <bits> must be at most MAX_PUT_BITS, and <value> must not have any bits set above them
+	void Put(unsigned long long value, unsigned bits)
+	{
+		accumulator = (accumulator << bits) | value;
+		count += bits;
+
+		if (count >= 32)
+		{
+			count -= 32;
+			auto word = static_cast<unsigned>(accumulator >> count);
+
+			if (buffer.size() - used < 4) flush();
+
+			buffer[used++] = static_cast<unsigned char>(word >> 24);
+			buffer[used++] = static_cast<unsigned char>(word >> 16);
+			buffer[used++] = static_cast<unsigned char>(word >> 8);
+			buffer[used++] = static_cast<unsigned char>(word);
+		}
+	}
+
+	// Returns: The number of bits written since the last byte boundary
+	unsigned PendingBits() const
+	{
+		return count % 8;
+	}
+
+	// Writes out every complete byte in the accumulator and flushes the buffer to the sink
+	//
+	// Any bits past the last byte boundary are discarded, so the caller should pad the
+	// output to a byte boundary first
+	void Finish()
+	{
+		while (count >= 8)
+		{
+			count -= 8;
+
+			if (used == buffer.size()) flush();
+			buffer[used++] = static_cast<unsigned char>(accumulator >> count);
+		}
+
+		count = 0;
+		flush();
+	}
+
+	// Returns: The number of bytes written to the sink or vector so far
+	size_t BytesWritten() const
+	{
+		return bytesWritten;
+	}
+
+private:
+	// Holds the bits that have not been written to the buffer yet in its low <count> bits
+	unsigned long long accumulator = 0;
+	// The number of bits in the accumulator
+	unsigned count = 0;
+
+	// The sink the output is written to, if any
+	ByteSink* sink = nullptr;
+	// The vector the output is appended to, if there is no sink
+	std::vector<unsigned char>* target = nullptr;
+	// Collects the output until it is written to the sink
+	std::vector<unsigned char> buffer;
+	// The number of bytes in the buffer
+	size_t used = 0;
+	// The number of bytes written to the sink or vector
+	size_t bytesWritten = 0;
+
+	// Writes the contents of the buffer to the sink or vector
+	void flush()
+	{
+		if (sink != nullptr) sink->Write(buffer.data(), used);
+		else target->insert(target->end(), buffer.begin(), buffer.begin() + used);
+		bytesWritten += used;
+		used = 0;
+	}
+};
@@ -0,0 +1,165 @@
+/*
+ * ByteSink.h - Destinations for encoded and decoded bytes
+ *
+ * Built for EECS2510 - Nonlinear Data Structures
+ *	at The University of Toledo, Spring 2016
+ *
+ * Copyright (c) 2016 Nathan Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+#include <algorithm>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Receives the bytes written by the encoder and decoder
+//
+// The codec works on buffers in memory, and only needs somewhere to put its output. Sinks
+// are provided for growable vectors, fixed buffers supplied by the caller, and streams (which
+// is how files are written)
+class ByteSink
+{
+public:
+	virtual ~ByteSink() {}
+
+	// Appends <size> bytes at <data> to the output
+	void Write(const unsigned char* data, size_t size)
+	{
+		write(data, size);
+		bytesWritten += size;
+	}
+
+	// Appends a single byte to the output
+	void Put(unsigned char b)
+	{
+		Write(&b, 1);
+	}
+
+	// Returns: The number of bytes written so far
+	size_t BytesWritten() const
+	{
+		return bytesWritten;
+	}
+
+protected:
+	// Appends <size> bytes at <data> to the destination
+	virtual void write(const unsigned char* data, size_t size) = 0;
+
+private:
+	// The number of bytes written so far
+	size_t bytesWritten = 0;
+};
+
+// Appends to a vector, which grows as needed
+class VectorSink : public ByteSink
+{
+public:
+	explicit VectorSink(std::vector<unsigned char>& target) : target(target) {}
+
+protected:
+	void write(const unsigned char* data, size_t size) override
+	{
+		target.insert(target.end(), data, data + size);
+	}
+
+private:
+	// The vector the output is appended to
+	std::vector<unsigned char>& target;
+};
+
+// Writes to a fixed buffer supplied by the caller
+//
+// Throws: std::length_error if the output doesn't fit in the buffer
+class BufferSink : public ByteSink
+{
+public:
+	BufferSink(unsigned char* buffer, size_t capacity) : buffer(buffer), capacity(capacity) {}
+
+protected:
+	void write(const unsigned char* data, size_t size) override
+	{
+		if (capacity - used < size) throw std::length_error("The output doesn't fit in a buffer of " + std::to_string(capacity) + " bytes");
+
+		std::memcpy(buffer + used, data, size);
+		used += size;
+	}
+
+private:
+	// The start of the buffer
+	unsigned char* buffer;
+	// The size of the buffer
+	size_t capacity;
+	// The number of bytes written to the buffer
+	size_t used = 0;
+};
+
+// Passes on only the bytes at offsets <offset> to <offset> + <length> of everything written to it
+// to another sink, and drops the rest
+class RangeSink : public ByteSink
+{
+public:
+	RangeSink(ByteSink& target, unsigned long long offset, unsigned long long length) : target(target), offset(offset), length(length) {}
+
+protected:
+	void write(const unsigned char* data, size_t size) override
+	{
+		auto start = BytesWritten();
+
+		// Skip the part of the data before the range
+		if (start + size <= offset) return;
+		auto skip = start < offset ? static_cast<size_t>(offset - start) : 0;
+
+		// And the part after it
+		auto passed = start + skip - offset;
+		if (passed >= length) return;
+		auto count = static_cast<size_t>(std::min<unsigned long long>(size - skip, length - passed));
+
+		target.Write(data + skip, count);
+	}
+
+private:
+	// The sink the bytes in the range are written to
+	ByteSink& target;
+	// The offset of the first byte to pass on
+	unsigned long long offset;
+	// The number of bytes to pass on
+	unsigned long long length;
+};
+
+// Writes to a stream
+class StreamSink : public ByteSink
+{
+public:
+	explicit StreamSink(std::ostream& stream) : stream(stream) {}
+
+protected:
+	void write(const unsigned char* data, size_t size) override
+	{
+		if (!stream.write(reinterpret_cast<const char*>(data), size)) throw std::runtime_error("Failed to write output");
+	}
+
+private:
+	// The stream the output is written to
+	std::ostream& stream;
+};
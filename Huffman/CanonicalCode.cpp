@@ -0,0 +1,300 @@
+/*
+ * CanonicalCode.cpp - Canonical Huffman code assignment and code length tables
+ *
+ * Built for EECS2510 - Nonlinear Data Structures
+ *	at The University of Toledo, Spring 2016
+ *
+ * Copyright (c) 2016 Nathan Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "stdafx.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "CanonicalCode.h"
+
+namespace canonical
+{
+	// Assigns the canonical code for every byte with a non-zero length
+	//
+	// The first code of each length is one past the last code of the previous length,
+	// shifted left by one. Within a length, codes are handed out in byte order
+	void AssignCodes(const unsigned char lengths[256], unsigned long long codes[256])
+	{
+		unsigned count[MAX_CODE_LENGTH + 1] = { 0 };
+		for (auto b = 0; b < 256; b++)
+		{
+			if (lengths[b] > MAX_CODE_LENGTH) throw std::invalid_argument("Code length " + std::to_string(lengths[b]) + " is too long");
+			count[lengths[b]]++;
+		}
+
+		// Find the first code of each length
+		unsigned long long next[MAX_CODE_LENGTH + 1] = { 0 };
+		unsigned long long code = 0;
+		count[0] = 0;
+		for (unsigned len = 1; len <= MAX_CODE_LENGTH; len++)
+		{
+			code = (code + count[len - 1]) << 1;
+			next[len] = code;
+		}
+
+		for (auto b = 0; b < 256; b++)
+		{
+			codes[b] = lengths[b] == 0 ? 0 : next[lengths[b]]++;
+		}
+	}
+
+	// Returns: true iff codes with the specified lengths can be assigned without any code
+	// being a prefix of another
+	//
+	// This checks the Kraft inequality one length at a time: <left> is the number of codes
+	// of the current length that have not been used by shorter codes
+	bool IsPrefixCode(const unsigned char lengths[256])
+	{
+		unsigned count[256] = { 0 };
+		for (auto b = 0; b < 256; b++) count[lengths[b]]++;
+
+		unsigned long long left = 1;
+		for (auto len = 1; len < 256; len++)
+		{
+			left <<= 1;
+			if (left < count[len]) return false;
+			left -= count[len];
+
+			// There are only 256 bytes, so once there is room for more than that, nothing can run out
+			if (left > 256) return true;
+		}
+
+		return true;
+	}
+
+	// Computes optimal code lengths for the specified weights where no code is longer than <maxLength> bits
+	//
+	// This is the package-merge algorithm. Think of every byte as a coin worth 2^-depth for each depth
+	// from 1 to <maxLength>, whose cost is the byte's weight. A code is the cheapest set of coins worth
+	// n - 1, and the length of a byte's code is the number of its coins in the set.
+	//
+	// The lists are built from the deepest level up: each level is the bytes sorted by weight merged with
+	// the cheapest pairs ("packages") of the level below. The first 2n - 2 items of the top level are the
+	// solution. Each package taken from a level stands for two items taken from the level below it, and
+	// since the bytes in a list are in weight order, the bytes taken from a level are always the lightest
+	void LimitLengths(const unsigned long long weights[256], unsigned maxLength, unsigned char lengths[256])
+	{
+		std::fill(lengths, lengths + 256, 0);
+
+		// The bytes that need a code, lightest first
+		std::vector<unsigned char> symbols;
+		for (auto b = 0; b < 256; b++)
+		{
+			if (weights[b] > 0) symbols.push_back(static_cast<unsigned char>(b));
+		}
+
+		std::stable_sort(symbols.begin(), symbols.end(), [&](unsigned char a, unsigned char b)
+		{
+			return weights[a] < weights[b];
+		});
+
+		auto n = symbols.size();
+		if (n < 2) throw std::invalid_argument("At least two bytes must have a weight to limit code lengths");
+		if (maxLength == 0 || maxLength > MAX_CODE_LENGTH) throw std::invalid_argument("Code lengths can't be limited to " + std::to_string(maxLength) + " bits");
+		if (maxLength < 8 && n > (static_cast<size_t>(1) << maxLength))
+		{
+			throw std::invalid_argument(std::to_string(n) + " bytes don't fit in codes of " + std::to_string(maxLength) + " bits");
+		}
+
+		// For each level, whether each item in its list is a package (true) or a byte (false)
+		std::vector<std::vector<bool>> isPackage(maxLength);
+		std::vector<unsigned long long> level;
+		std::vector<unsigned long long> next;
+
+		// The deepest level only has the bytes
+		for (auto s : symbols) level.push_back(weights[s]);
+		isPackage[0].assign(n, false);
+
+		for (unsigned depth = 1; depth < maxLength; depth++)
+		{
+			// Merge the bytes with the packages of the level below, preferring bytes on ties
+			next.clear();
+			auto& flags = isPackage[depth];
+
+			size_t leaf = 0;
+			size_t pair = 0;
+			while (leaf < n || pair + 1 < level.size())
+			{
+				auto takeLeaf = pair + 1 >= level.size() || (leaf < n && weights[symbols[leaf]] <= level[pair] + level[pair + 1]);
+
+				if (takeLeaf)
+				{
+					next.push_back(weights[symbols[leaf++]]);
+					flags.push_back(false);
+				}
+				else
+				{
+					next.push_back(level[pair] + level[pair + 1]);
+					flags.push_back(true);
+					pair += 2;
+				}
+			}
+
+			level.swap(next);
+		}
+
+		// Walk back down, taking the items the packages at each level stand for
+		auto take = 2 * n - 2;
+		for (auto depth = static_cast<int>(maxLength) - 1; depth >= 0; depth--)
+		{
+			size_t leaves = 0;
+			size_t packages = 0;
+			for (size_t i = 0; i < take; i++)
+			{
+				if (isPackage[depth][i]) packages++;
+				else leaves++;
+			}
+
+			// The lightest bytes get one more bit
+			for (size_t i = 0; i < leaves; i++) lengths[symbols[i]]++;
+
+			take = 2 * packages;
+		}
+	}
+
+	// Returns: The number of bits the specified weights encode to with codes of the specified lengths
+	unsigned long long EncodedBits(const unsigned long long weights[256], const unsigned char lengths[256])
+	{
+		unsigned long long bits = 0;
+		for (auto b = 0; b < 256; b++) bits += weights[b] * lengths[b];
+
+		return bits;
+	}
+
+	// Returns: The number of bytes AppendLengths would append for the specified lengths
+	size_t LengthsSize(const unsigned char lengths[256])
+	{
+		auto used = 0;
+		auto longest = 0;
+		for (auto b = 0; b < 256; b++)
+		{
+			if (lengths[b] > 0) used++;
+			if (lengths[b] > longest) longest = lengths[b];
+		}
+
+		size_t best = 1 + 256;
+		if (longest <= 15) best = 1 + 128;
+		if (used < 256 && 2 + 2 * static_cast<size_t>(used) < best) best = 2 + 2 * static_cast<size_t>(used);
+
+		return best;
+	}
+
+	// Appends the code lengths to <out>, picking whichever table format is smallest
+	void AppendLengths(const unsigned char lengths[256], std::vector<unsigned char>& out)
+	{
+		auto used = 0;
+		auto longest = 0;
+		for (auto b = 0; b < 256; b++)
+		{
+			if (lengths[b] > 0) used++;
+			if (lengths[b] > longest) longest = lengths[b];
+		}
+
+		auto size = LengthsSize(lengths);
+
+		if (used < 256 && size == 2 + 2 * static_cast<size_t>(used))
+		{
+			out.push_back(LENGTHS_SPARSE);
+			out.push_back(static_cast<unsigned char>(used));
+			for (auto b = 0; b < 256; b++)
+			{
+				if (lengths[b] == 0) continue;
+
+				out.push_back(static_cast<unsigned char>(b));
+				out.push_back(lengths[b]);
+			}
+		}
+		else if (longest <= 15)
+		{
+			out.push_back(LENGTHS_PACKED);
+			for (auto b = 0; b < 256; b += 2)
+			{
+				out.push_back(static_cast<unsigned char>((lengths[b] << 4) | lengths[b + 1]));
+			}
+		}
+		else
+		{
+			out.push_back(LENGTHS_FULL);
+			out.insert(out.end(), lengths, lengths + 256);
+		}
+	}
+
+	// Reads code lengths written by AppendLengths from the <size> bytes at <data>
+	size_t ParseLengths(const unsigned char* data, size_t size, unsigned char lengths[256])
+	{
+		std::fill(lengths, lengths + 256, 0);
+
+		size_t position = 0;
+		auto nextByte = [&]()
+		{
+			if (position == size) throw std::invalid_argument("Unexpected end of block in code length table");
+			return data[position++];
+		};
+
+		auto format = nextByte();
+		switch (format)
+		{
+		case LENGTHS_PACKED:
+			for (auto b = 0; b < 256; b += 2)
+			{
+				auto packed = nextByte();
+				lengths[b] = packed >> 4;
+				lengths[b + 1] = packed & 0x0F;
+			}
+			break;
+
+		case LENGTHS_FULL:
+			for (auto b = 0; b < 256; b++) lengths[b] = nextByte();
+			break;
+
+		case LENGTHS_SPARSE:
+		{
+			auto used = nextByte();
+			for (auto i = 0; i < used; i++)
+			{
+				auto b = nextByte();
+				lengths[b] = nextByte();
+			}
+			break;
+		}
+
+		default:
+			throw std::invalid_argument("Unrecognized code length table format: " + std::to_string(format));
+		}
+
+		for (auto b = 0; b < 256; b++)
+		{
+			if (lengths[b] > MAX_CODE_LENGTH) throw std::invalid_argument("Code length for byte " + std::to_string(b) + " is too long");
+		}
+
+		if (!IsPrefixCode(lengths)) throw std::invalid_argument("Code lengths do not describe a prefix code");
+
+		return position;
+	}
+}
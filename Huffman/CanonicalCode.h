@@ -0,0 +1,80 @@
+/*
+ * CanonicalCode.h - Canonical Huffman code assignment and code length tables
+ *
+ * Built for EECS2510 - Nonlinear Data Structures
+ *	at The University of Toledo, Spring 2016
+ *
+ * Copyright (c) 2016 Nathan Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+#include <vector>
+
+// A canonical Huffman code is completely described by the length of the code for
+// each byte. Codes are handed out in order of length, and bytes with codes of the
+// same length get consecutive codes in byte order. Both the encoder and decoder
+// can rebuild the codes from the lengths, so the lengths are all that need to be
+// stored in a file.
+namespace canonical
+{
+	// The longest code that can be assigned, since codes are stored in a 64-bit integer
+	const unsigned MAX_CODE_LENGTH = 64;
+
+	// Formats for code length tables
+	//
+	// Packed: 128 bytes, two 4-bit lengths per byte, with the length for the even byte in the high nibble
+	const unsigned char LENGTHS_PACKED = 0x00;
+	// Full: 256 bytes, one length per byte
+	const unsigned char LENGTHS_FULL = 0x01;
+	// Sparse: 1 byte count of coded bytes, followed by a (byte, length) pair for each
+	const unsigned char LENGTHS_SPARSE = 0x02;
+
+	// Assigns the canonical code for every byte with a non-zero length
+	//
+	// Each code is right-aligned in codes[byte]. Lengths must be at most MAX_CODE_LENGTH
+	// and must describe a prefix code (see IsPrefixCode)
+	void AssignCodes(const unsigned char lengths[256], unsigned long long codes[256]);
+
+	// Returns: true iff codes with the specified lengths can be assigned without any code
+	// being a prefix of another
+	bool IsPrefixCode(const unsigned char lengths[256]);
+
+	// Computes optimal code lengths for the specified weights where no code is longer than <maxLength> bits
+	//
+	// Bytes with a weight of zero get no code. At least two bytes must have a non-zero weight, and
+	// there must be room for all of them in <maxLength> bits
+	void LimitLengths(const unsigned long long weights[256], unsigned maxLength, unsigned char lengths[256]);
+
+	// Returns: The number of bits the specified weights encode to with codes of the specified lengths
+	unsigned long long EncodedBits(const unsigned long long weights[256], const unsigned char lengths[256]);
+
+	// Returns: The number of bytes AppendLengths would append for the specified lengths
+	size_t LengthsSize(const unsigned char lengths[256]);
+
+	// Appends the code lengths to <out>, picking whichever table format is smallest
+	void AppendLengths(const unsigned char lengths[256], std::vector<unsigned char>& out);
+
+	// Reads code lengths written by AppendLengths from the <size> bytes at <data>
+	//
+	// Returns: The number of bytes the table took up
+	// Throws: std::invalid_argument if the table is malformed, runs past <size> or does not describe a prefix code
+	size_t ParseLengths(const unsigned char* data, size_t size, unsigned char lengths[256]);
+}
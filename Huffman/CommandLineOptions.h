@@ -26,6 +26,8 @@
  * SOFTWARE.
  */
 #pragma once
+#include <climits>
+#include <string>
 
 // A simple structure for managing command-line options and flags
 struct CommandLineOptions
@@ -38,8 +40,46 @@ struct CommandLineOptions
 	bool encode = false;
 	// The decode mode was requested
 	bool decode = false;
+	// The training mode was requested
+	bool train = false;
+	// Report the size the input would encode to without encoding it
+	bool estimate = false;
+	// Encode or decode every file in the input directory or list
+	bool batch = false;
+	// Encode a batch into a single archive, or extract one
+	bool archive = false;
 	// The verbose flag was specified
 	bool verbose = false;
+	// Decode with the reference tree walker instead of the decoding table
+	bool referenceDecoder = false;
+	// The file format version to encode with, or 0 for the encoder's default
+	unsigned formatVersion = 0;
+	// The longest code the encoder may use, or 0 for no limit
+	unsigned maxCodeLength = 0;
+	// The number of input bytes in each independently encoded block, or 0 to encode a single block
+	size_t blockSize = 0;
+	// Split each block into interleaved streams
+	bool interleaved = false;
+	// The most context tables to code with, or 0 for a single table
+	unsigned contextTables = 0;
+	// Give every block its own code, or store it raw or run-length coded
+	bool adaptive = false;
+	// Code blocks with tANS instead of Huffman codes
+	bool ans = false;
+	// Run-length pre-transform the input before it is coded
+	bool runs = false;
+	// The path to the dictionary to encode or decode with, if any
+	std::string dictionary = "";
+	// The number of threads to count weights, encode and decode blocks with, or 0 for one per core
+	unsigned threads = 0;
+	// Read, code and write blocks at the same time, as a stream of frames
+	bool pipelined = false;
+	// Only decode part of the original input
+	bool range = false;
+	// The offset of the first byte to decode, if range is set
+	unsigned long long rangeOffset = 0;
+	// The number of bytes to decode, if range is set, or ULLONG_MAX to decode to the end
+	unsigned long long rangeLength = ULLONG_MAX;
 
 	// The path to the input file
 	std::string input = "";
@@ -60,9 +100,34 @@ struct CommandLineOptions
 		result += "Decode: ";
 		result += decode ? "true\n" : "false\n";
 
+		result += "Train: ";
+		result += train ? "true\n" : "false\n";
+
+		result += "Estimate: ";
+		result += estimate ? "true\n" : "false\n";
+
+		result += "Batch: ";
+		result += batch ? (archive ? "archive\n" : "directory\n") : "false\n";
+
 		result += "Verbose: ";
 		result += verbose ? "true\n" : "false\n";
 
+		result += "Reference Decoder: ";
+		result += referenceDecoder ? "true\n" : "false\n";
+
+		result += "Format Version: " + (formatVersion == 0 ? std::string("default") : std::to_string(formatVersion)) + "\n";
+		result += "Block Size: " + std::to_string(blockSize) + "\n";
+		result += "Interleaved Streams: " + std::string(interleaved ? "true" : "false") + "\n";
+		result += "Context Tables: " + (contextTables == 0 ? std::string("off") : std::to_string(contextTables)) + "\n";
+		result += "Adaptive Blocks: " + std::string(adaptive ? "true" : "false") + "\n";
+		result += "tANS: " + std::string(ans ? "true" : "false") + "\n";
+		result += "Run-Length Pre-Transform: " + std::string(runs ? "true" : "false") + "\n";
+		result += "Dictionary: " + (dictionary == "" ? std::string("none") : dictionary) + "\n";
+		result += "Threads: " + (threads == 0 ? std::string("one per core") : std::to_string(threads)) + "\n";
+		result += "Pipelined: " + std::string(pipelined ? "true" : "false") + "\n";
+		result += "Range: " + (!range ? std::string("everything") : std::to_string(rangeOffset) + ":" + (rangeLength == ULLONG_MAX ? std::string("end") : std::to_string(rangeLength))) + "\n";
+		result += "Max Code Length: " + (maxCodeLength == 0 ? std::string("unlimited") : std::to_string(maxCodeLength)) + "\n";
+
 		result += "Input File: " + input + "\n";
 		result += "Output File: " + output += "\n";
 
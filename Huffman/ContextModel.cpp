@@ -0,0 +1,235 @@
+/*
+ * ContextModel.cpp - Previous-byte statistics and clustering for context-modeled codes
+ *
+ * Built for EECS2510 - Nonlinear Data Structures
+ *	at The University of Toledo, Spring 2016
+ *
+ * Copyright (c) 2016 Nathan Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "stdafx.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ContextModel.h"
+#include "Verbose.h"
+
+namespace context
+{
+	// Construct a counter for an input split into blocks of <blockSize> bytes
+	PairCounter::PairCounter(unsigned long long blockSize) : counts(256 * 256), blockSize(blockSize), left(blockSize)
+	{
+		if (blockSize == 0) throw std::invalid_argument("Contexts need a block size");
+	}
+
+	// Counts the next <size> bytes of the input
+	void PairCounter::Add(const unsigned char* data, size_t size)
+	{
+		auto table = counts.data();
+
+		while (size > 0)
+		{
+			if (left == 0)
+			{
+				previous = INITIAL_CONTEXT;
+				left = blockSize;
+			}
+
+			auto run = static_cast<size_t>(std::min<unsigned long long>(size, left));
+			auto p = previous;
+
+			for (size_t i = 0; i < run; i++)
+			{
+				table[256 * static_cast<size_t>(p) + data[i]]++;
+				p = data[i];
+			}
+
+			previous = p;
+			data += run;
+			size -= run;
+			left -= run;
+		}
+	}
+
+	// Returns: The estimated number of bits a code built from the 256 counts at <counts> takes,
+	// including its code length table
+	static double estimateBits(const unsigned long long* counts)
+	{
+		unsigned long long total = 0;
+		auto used = 0;
+		for (auto b = 0; b < 256; b++)
+		{
+			total += counts[b];
+			if (counts[b] > 0) used++;
+		}
+
+		if (total == 0) return 0;
+
+		// The sparse or packed length table, whichever is smaller (see canonical::LengthsSize)
+		double bits = 8.0 * std::min(1 + 128, 2 + 2 * used);
+
+		auto logTotal = std::log2(static_cast<double>(total));
+		for (auto b = 0; b < 256; b++)
+		{
+			if (counts[b] > 0) bits += counts[b] * (logTotal - std::log2(static_cast<double>(counts[b])));
+		}
+
+		return bits;
+	}
+
+	// Groups the contexts into at most <maxTables> tables of similar statistics
+	unsigned Cluster(const PairCounter& pairs, unsigned maxTables, unsigned char map[256], std::vector<unsigned long long>& weights)
+	{
+		if (maxTables == 0 || maxTables > MAX_TABLES) throw std::invalid_argument("Can't use " + std::to_string(maxTables) + " context tables");
+
+		// Start with a cluster for every context that occurs
+		std::vector<std::vector<unsigned long long>> clusters;
+		std::vector<double> cost;
+		int owner[256];
+
+		for (auto c = 0; c < 256; c++)
+		{
+			auto counts = pairs.Counts(static_cast<unsigned char>(c));
+
+			owner[c] = -1;
+			if (std::all_of(counts, counts + 256, [](unsigned long long n) { return n == 0; })) continue;
+
+			owner[c] = static_cast<int>(clusters.size());
+			clusters.emplace_back(counts, counts + 256);
+			cost.push_back(estimateBits(counts));
+		}
+
+		auto n = clusters.size();
+		std::vector<bool> active(n, true);
+		std::vector<double> delta(n * n, 0);
+		std::vector<unsigned long long> merged(256);
+
+		// Returns: The estimated change in size from merging clusters <a> and <b>
+		auto mergeDelta = [&](size_t a, size_t b)
+		{
+			for (auto s = 0; s < 256; s++) merged[s] = clusters[a][s] + clusters[b][s];
+			return estimateBits(merged.data()) - cost[a] - cost[b];
+		};
+
+		for (size_t a = 0; a < n; a++)
+		{
+			for (size_t b = a + 1; b < n; b++) delta[a * n + b] = mergeDelta(a, b);
+		}
+
+		auto remaining = n;
+		while (remaining > 1)
+		{
+			// Find the cheapest merge
+			size_t bestA = 0;
+			size_t bestB = 0;
+			auto best = HUGE_VAL;
+
+			for (size_t a = 0; a < n; a++)
+			{
+				if (!active[a]) continue;
+
+				for (size_t b = a + 1; b < n; b++)
+				{
+					if (active[b] && delta[a * n + b] < best)
+					{
+						best = delta[a * n + b];
+						bestA = a;
+						bestB = b;
+					}
+				}
+			}
+
+			// Keep going while merging saves space, or there are still too many tables
+			if (best >= 0 && remaining <= maxTables) break;
+
+			for (auto s = 0; s < 256; s++) clusters[bestA][s] += clusters[bestB][s];
+			cost[bestA] = estimateBits(clusters[bestA].data());
+			active[bestB] = false;
+			remaining--;
+
+			for (auto c = 0; c < 256; c++)
+			{
+				if (owner[c] == static_cast<int>(bestB)) owner[c] = static_cast<int>(bestA);
+			}
+
+			for (size_t other = 0; other < n; other++)
+			{
+				if (!active[other] || other == bestA) continue;
+
+				auto d = mergeDelta(std::min(bestA, other), std::max(bestA, other));
+				delta[std::min(bestA, other) * n + std::max(bestA, other)] = d;
+			}
+		}
+
+		// The context map takes 256 bytes once there is more than one table, so if the tables don't
+		// save at least that much, code everything with a single table instead
+		if (remaining > 1)
+		{
+			auto clustered = 8.0 * 256;
+			std::vector<unsigned long long> all(256, 0);
+
+			for (size_t c = 0; c < n; c++)
+			{
+				if (!active[c]) continue;
+
+				clustered += cost[c];
+				for (auto s = 0; s < 256; s++) all[s] += clusters[c][s];
+			}
+
+			if (estimateBits(all.data()) <= clustered)
+			{
+				for (size_t c = 1; c < n; c++) active[c] = false;
+				clusters[0] = all;
+				active[0] = true;
+				for (auto c = 0; c < 256; c++) owner[c] = owner[c] < 0 ? -1 : 0;
+			}
+		}
+
+		// Number the surviving clusters in order. Contexts that never occur use the first table
+		std::vector<int> index(n, -1);
+		unsigned tables = 0;
+		weights.clear();
+
+		for (size_t c = 0; c < n; c++)
+		{
+			if (!active[c]) continue;
+
+			index[c] = static_cast<int>(tables++);
+			weights.insert(weights.end(), clusters[c].begin(), clusters[c].end());
+		}
+
+		for (auto c = 0; c < 256; c++) map[c] = owner[c] < 0 ? 0 : static_cast<unsigned char>(index[owner[c]]);
+
+		// An empty input still needs a table
+		if (tables == 0)
+		{
+			weights.assign(256, 0);
+			tables = 1;
+		}
+
+		verbose::write("Clustered " + std::to_string(n) + " contexts into " + std::to_string(tables) + " code tables");
+
+		return tables;
+	}
+}
@@ -0,0 +1,87 @@
+/*
+ * ContextModel.h - Previous-byte statistics and clustering for context-modeled codes
+ *
+ * Built for EECS2510 - Nonlinear Data Structures
+ *	at The University of Toledo, Spring 2016
+ *
+ * Copyright (c) 2016 Nathan Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+#include <vector>
+
+// Order-1 context modeling: instead of one code for the whole file, each byte is coded with a
+// code picked by the byte before it. Text and logs are much more predictable one byte at a
+// time than over the whole file (a 'q' is almost always followed by a 'u').
+//
+// A code table for each of the 256 previous bytes would cost more to store than it saves on
+// small inputs, and most contexts look alike anyway, so similar contexts are clustered and
+// share a table.
+namespace context
+{
+	// The most code tables a file may use, since the context map stores a table index per byte
+	const unsigned MAX_TABLES = 256;
+
+	// The context the first byte of every block is coded in, as if it followed this byte
+	const unsigned char INITIAL_CONTEXT = 0;
+
+	// Counts how many times each byte follows each other byte
+	//
+	// The context starts over at INITIAL_CONTEXT every <blockSize> bytes, so every block can be
+	// decoded on its own
+	class PairCounter
+	{
+	public:
+		// Construct a counter for an input split into blocks of <blockSize> bytes
+		explicit PairCounter(unsigned long long blockSize);
+
+		// Counts the next <size> bytes of the input
+		void Add(const unsigned char* data, size_t size);
+
+		// Returns: The 256 counts of the bytes that followed <previous>
+		const unsigned long long* Counts(unsigned char previous) const
+		{
+			return counts.data() + 256 * static_cast<size_t>(previous);
+		}
+
+	private:
+		// The counts, 256 per previous byte
+		std::vector<unsigned long long> counts;
+		// The byte before the next one counted
+		unsigned char previous = INITIAL_CONTEXT;
+		// The number of bytes in each block
+		unsigned long long blockSize;
+		// The number of bytes left in the current block
+		unsigned long long left;
+	};
+
+	// Groups the contexts into at most <maxTables> tables of similar statistics
+	//
+	// Starting with a table per context, the two tables whose merged code is estimated to save the
+	// most (or cost the least) are merged until no merge saves anything and there are at most
+	// <maxTables> tables. The estimate is the entropy of the counts plus the size of a code length table.
+	//
+	// map[previous] receives the table each context is coded with, and <weights> receives 256
+	// weights for each table, one table after the other
+	//
+	// Returns: The number of tables, at least 1
+	unsigned Cluster(const PairCounter& pairs, unsigned maxTables, unsigned char map[256], std::vector<unsigned long long>& weights);
+}
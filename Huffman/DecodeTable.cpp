@@ -0,0 +1,525 @@
+/*
+ * DecodeTable.cpp - Implementation for multi-bit Huffman decoding tables
+ *
+ * Built for EECS2510 - Nonlinear Data Structures
+ *	at The University of Toledo, Spring 2016
+ *
+ * Copyright (c) 2016 Nathan Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "stdafx.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "DecodeTable.h"
+#include "HuffmanEncoder.h"
+
+// Rebuilds the table from the specified codes
+//
+// Symbols are inserted longest code first. That way, the first code to land on a
+// root entry that needs a sub-table is the longest code with that prefix, and the
+// sub-table can be sized for it right away.
+void HuffmanDecodeTable::Build(const unsigned long long codes[256], const unsigned char lengths[256], unsigned rootBits)
+{
+	if (rootBits != 0 && (rootBits < MIN_ROOT_BITS || rootBits > MAX_ROOT_BITS))
+	{
+		throw std::invalid_argument("Root tables can't be indexed by " + std::to_string(rootBits) + " bits");
+	}
+
+	unsigned short order[256];
+	unsigned longest = 0;
+	auto used = 0;
+	for (auto s = 0; s < 256; s++)
+	{
+		if (lengths[s] == 0) continue;
+		if (lengths[s] > MAX_CODE_LENGTH)
+		{
+			throw std::invalid_argument("Code for byte " + std::to_string(s) + " is too long for a decoding table");
+		}
+
+		order[used++] = static_cast<unsigned short>(s);
+		longest = std::max<unsigned>(longest, lengths[s]);
+	}
+
+	setRefillThreshold(longest);
+	this->rootBits = rootBits != 0 ? rootBits : PickRootBits(longest);
+
+	entries.assign(static_cast<size_t>(1) << this->rootBits, Entry{ 0, 0, ENTRY_INVALID });
+	subTables.clear();
+
+	std::stable_sort(order, order + used, [&](unsigned short a, unsigned short b)
+	{
+		return lengths[a] > lengths[b];
+	});
+
+	for (auto i = 0; i < used; i++)
+	{
+		auto symbol = order[i];
+		auto code = codes[symbol];
+		unsigned length = lengths[symbol];
+
+		// Walk down the levels of the table until the rest of the code fits in one
+		size_t offset = 0;
+		unsigned tableBits = this->rootBits;
+		unsigned consumed = 0;
+
+		while (length - consumed > tableBits)
+		{
+			// The bits of the code that index this level
+			auto index = static_cast<size_t>((code >> (length - consumed - tableBits)) & ((1ull << tableBits) - 1));
+
+			if (entries[offset + index].kind != ENTRY_LINK)
+			{
+				// This is the longest code with this prefix, size the sub-table for it
+				auto subBits = length - consumed - tableBits;
+				if (subBits > this->rootBits) subBits = this->rootBits;
+
+				auto link = addSubTable(subBits);
+				entries[offset + index] = link;
+			}
+
+			auto link = entries[offset + index];
+			consumed += tableBits;
+			offset = subTables[link.value];
+			tableBits = link.bits;
+		}
+
+		// The remaining bits of the code select a run of entries. Every index that
+		// starts with them decodes to this symbol
+		auto remaining = length - consumed;
+		auto first = static_cast<size_t>(code & ((1ull << remaining) - 1)) << (tableBits - remaining);
+		auto count = static_cast<size_t>(1) << (tableBits - remaining);
+
+		for (size_t e = first; e < first + count; e++)
+		{
+			entries[offset + e] = Entry{ symbol, static_cast<unsigned char>(remaining), ENTRY_SYMBOL };
+		}
+	}
+}
+
+// Rebuilds the table from the specified tree
+//
+// Unlike building from integer codes, this works for trees of any depth. Trees built
+// with every byte as a leaf routinely have codes far longer than 64 bits for bytes
+// that never occur in the file.
+void HuffmanDecodeTable::Build(const HuffmanTree& tree)
+{
+	rootBits = ROOT_BITS;
+	entries.assign(static_cast<size_t>(1) << ROOT_BITS, Entry{ 0, 0, ENTRY_INVALID });
+	subTables.clear();
+
+	if (tree.Empty() || tree[tree.Root].IsLeaf()) throw std::invalid_argument("Decoding tree must have at least two leaves");
+
+	setRefillThreshold(heightOf(tree, tree.Root));
+	fill(tree, tree.Root, 0, ROOT_BITS, 0, 0);
+}
+
+// Adds a sub-table with the specified number of index bits to the end of the table
+//
+// Returns: A link entry pointing at the new sub-table
+HuffmanDecodeTable::Entry HuffmanDecodeTable::addSubTable(unsigned bits)
+{
+	if (subTables.size() > 0xFFFF) throw std::runtime_error("Decoding table has too many sub-tables");
+
+	auto index = static_cast<unsigned short>(subTables.size());
+
+	subTables.push_back(entries.size());
+	entries.resize(entries.size() + (static_cast<size_t>(1) << bits), Entry{ 0, 0, ENTRY_INVALID });
+
+	return Entry{ index, static_cast<unsigned char>(bits), ENTRY_LINK };
+}
+
+// Fills the entries for the subtree at <node>, which is reached by <prefix> (<depth> bits)
+// in the table at <offset> that is indexed by <tableBits> bits
+void HuffmanDecodeTable::fill(const HuffmanTree& tree, unsigned short node, size_t offset, unsigned tableBits, unsigned depth, size_t prefix)
+{
+	// Missing children leave their entries invalid
+	if (node == HuffmanTree::NO_NODE) return;
+
+	auto& current = tree[node];
+	if (current.IsLeaf())
+	{
+		// Every index that starts with the prefix decodes to this leaf
+		auto first = prefix << (tableBits - depth);
+		auto count = static_cast<size_t>(1) << (tableBits - depth);
+
+		for (size_t e = first; e < first + count; e++)
+		{
+			entries[offset + e] = Entry{ current.Payload, static_cast<unsigned char>(depth), ENTRY_SYMBOL };
+		}
+
+		return;
+	}
+
+	if (depth == tableBits)
+	{
+		// This level is used up. Give the subtree its own table, sized for its height
+		auto subBits = heightOf(tree, node);
+		if (subBits > ROOT_BITS) subBits = ROOT_BITS;
+
+		auto link = addSubTable(subBits);
+		entries[offset + prefix] = link;
+
+		fill(tree, node, subTables[link.value], subBits, 0, 0);
+		return;
+	}
+
+	fill(tree, current.Left, offset, tableBits, depth + 1, prefix << 1);
+	fill(tree, current.Right, offset, tableBits, depth + 1, (prefix << 1) | 1);
+}
+
+// Returns: The length of the longest path from <node> of <tree> to a leaf
+unsigned HuffmanDecodeTable::heightOf(const HuffmanTree& tree, unsigned short node)
+{
+	if (node == HuffmanTree::NO_NODE || tree[node].IsLeaf()) return 0;
+
+	return 1 + std::max(heightOf(tree, tree[node].Left), heightOf(tree, tree[node].Right));
+}
+
+// Returns: The root table width Build picks for codes no longer than <longestCode> bits
+unsigned HuffmanDecodeTable::PickRootBits(unsigned longestCode)
+{
+	// Copied so that std::min and std::max don't need definitions of the constants outside the class
+	unsigned narrowest = MIN_ROOT_BITS;
+	unsigned widest = ROOT_BITS;
+	return std::min(std::max(longestCode, narrowest), widest);
+}
+
+// Sets the refill threshold for a table whose longest code is <length> bits
+void HuffmanDecodeTable::setRefillThreshold(unsigned length)
+{
+	// Codes longer than a refill are handled by refilling part way through them in decodeSlow
+	//
+	// std::min takes its arguments by reference, so the constant is copied first to keep it from
+	// needing a definition outside the class
+	unsigned refillBits = BitReader::REFILL_BITS;
+	refillThreshold = std::min(length, refillBits);
+}
+
+// Decodes symbols from the reader into <out> until <capacity> symbols were decoded or
+// the input ran out
+//
+// Build only makes root tables between MIN_ROOT_BITS and MAX_ROOT_BITS wide, so there is a kernel for each
+size_t HuffmanDecodeTable::Decode(BitReader& reader, unsigned char* out, size_t capacity) const
+{
+	static_assert(MIN_ROOT_BITS == 9 && MAX_ROOT_BITS == 12, "Every root table width needs a kernel");
+
+	switch (rootBits)
+	{
+	case 9:  return decodeKernel<9>(reader, out, capacity);
+	case 10: return decodeKernel<10>(reader, out, capacity);
+	case 11: return decodeKernel<11>(reader, out, capacity);
+	default: return decodeKernel<12>(reader, out, capacity);
+	}
+}
+
+// Decodes symbols that were dealt round-robin into STREAM_COUNT bitstreams into <out> until
+// <capacity> symbols were decoded or a stream ran out
+size_t HuffmanDecodeTable::DecodeInterleaved(BitReader readers[], unsigned char* out, size_t capacity) const
+{
+	switch (rootBits)
+	{
+	case 9:  return decodeInterleavedKernel<9>(readers, out, capacity);
+	case 10: return decodeInterleavedKernel<10>(readers, out, capacity);
+	case 11: return decodeInterleavedKernel<11>(readers, out, capacity);
+	default: return decodeInterleavedKernel<12>(readers, out, capacity);
+	}
+}
+
+// Decodes symbols from a single bitstream with a root table of <TableBits> bits
+//
+// The inner loop works on local copies of the reader's bit buffer so that it can live in registers.
+// After a refill the buffer holds at least 56 bits, which is enough for ROUNDS codes that resolve
+// from the root table, so the stream is refilled and bounds-checked once per ROUNDS symbols instead
+// of once per symbol. Anything the loop can't handle (long codes, the end of the input) is decoded
+// one symbol at a time with DecodeSymbol
+template <unsigned TableBits>
+size_t HuffmanDecodeTable::decodeKernel(BitReader& reader, unsigned char* out, size_t capacity) const
+{
+	const unsigned ROUNDS = 56 / TableBits;
+	const unsigned SHIFT = 64 - TableBits;
+
+	auto root = entries.data();
+	size_t produced = 0;
+
+	while (produced < capacity)
+	{
+		auto buffer = reader.buffer;
+		auto count = reader.count;
+		auto cursor = reader.cursor;
+		auto end = reader.end;
+
+		// The refill loads eight bytes unconditionally, so they have to be in memory
+		auto stalled = false;
+		while (!stalled && capacity - produced >= ROUNDS && end - cursor >= 8)
+		{
+			buffer |= BitReader::LoadBigEndian(cursor) >> count;
+			cursor += (63 - count) >> 3;
+			count |= 56;
+
+			for (unsigned r = 0; r < ROUNDS; r++)
+			{
+				auto entry = root[buffer >> SHIFT];
+				if (entry.kind != ENTRY_SYMBOL)
+				{
+					stalled = true;
+					break;
+				}
+
+				out[produced++] = static_cast<unsigned char>(entry.value);
+				buffer <<= entry.bits;
+				count -= entry.bits;
+			}
+		}
+
+		reader.buffer = buffer;
+		reader.count = count;
+		reader.cursor = cursor;
+
+		if (produced == capacity) break;
+
+		unsigned char symbol;
+		if (!DecodeSymbol(reader, symbol)) break;
+
+		out[produced++] = symbol;
+	}
+
+	return produced;
+}
+
+// Decodes symbols dealt round-robin into STREAM_COUNT bitstreams with a root table of <TableBits> bits
+//
+// This is the single stream loop run on four streams at once, so the lookups for all of them can be
+// in flight together. The streams are unrolled by hand into their own locals: kept in arrays, they only
+// stay in registers if the optimizer unrolls every loop over them, and the stores to <out> could alias
+// the readers, which forces their fields to be reloaded after every symbol. The loop only decodes whole
+// rounds of one symbol from each stream, and anything it can't handle is decoded one symbol at a time
+// with DecodeSymbol from the right stream until the streams line up again
+template <unsigned TableBits>
+size_t HuffmanDecodeTable::decodeInterleavedKernel(BitReader readers[], unsigned char* out, size_t capacity) const
+{
+	static_assert(STREAM_COUNT == 4, "The interleaved kernel is unrolled for four streams");
+
+	const unsigned ROUNDS = 56 / TableBits;
+	const unsigned SHIFT = 64 - TableBits;
+
+	auto root = entries.data();
+	size_t produced = 0;
+
+	while (produced < capacity)
+	{
+		if (produced % STREAM_COUNT == 0)
+		{
+			auto buffer0 = readers[0].buffer;
+			auto buffer1 = readers[1].buffer;
+			auto buffer2 = readers[2].buffer;
+			auto buffer3 = readers[3].buffer;
+			auto count0 = readers[0].count;
+			auto count1 = readers[1].count;
+			auto count2 = readers[2].count;
+			auto count3 = readers[3].count;
+			auto cursor0 = readers[0].cursor;
+			auto cursor1 = readers[1].cursor;
+			auto cursor2 = readers[2].cursor;
+			auto cursor3 = readers[3].cursor;
+			auto end0 = readers[0].end;
+			auto end1 = readers[1].end;
+			auto end2 = readers[2].end;
+			auto end3 = readers[3].end;
+
+			// Every stream needs eight bytes in memory for the unconditional refill
+			auto stalled = false;
+			while (!stalled && capacity - produced >= STREAM_COUNT * ROUNDS &&
+				end0 - cursor0 >= 8 && end1 - cursor1 >= 8 && end2 - cursor2 >= 8 && end3 - cursor3 >= 8)
+			{
+				buffer0 |= BitReader::LoadBigEndian(cursor0) >> count0;
+				buffer1 |= BitReader::LoadBigEndian(cursor1) >> count1;
+				buffer2 |= BitReader::LoadBigEndian(cursor2) >> count2;
+				buffer3 |= BitReader::LoadBigEndian(cursor3) >> count3;
+				cursor0 += (63 - count0) >> 3;
+				cursor1 += (63 - count1) >> 3;
+				cursor2 += (63 - count2) >> 3;
+				cursor3 += (63 - count3) >> 3;
+				count0 |= 56;
+				count1 |= 56;
+				count2 |= 56;
+				count3 |= 56;
+
+				for (unsigned r = 0; r < ROUNDS; r++)
+				{
+					auto entry0 = root[buffer0 >> SHIFT];
+					auto entry1 = root[buffer1 >> SHIFT];
+					auto entry2 = root[buffer2 >> SHIFT];
+					auto entry3 = root[buffer3 >> SHIFT];
+
+					// One branch for all four streams
+					auto symbols = (entry0.kind == ENTRY_SYMBOL) & (entry1.kind == ENTRY_SYMBOL) & (entry2.kind == ENTRY_SYMBOL) & (entry3.kind == ENTRY_SYMBOL);
+					if (!symbols)
+					{
+						stalled = true;
+						break;
+					}
+
+					out[produced] = static_cast<unsigned char>(entry0.value);
+					out[produced + 1] = static_cast<unsigned char>(entry1.value);
+					out[produced + 2] = static_cast<unsigned char>(entry2.value);
+					out[produced + 3] = static_cast<unsigned char>(entry3.value);
+					produced += STREAM_COUNT;
+
+					buffer0 <<= entry0.bits;
+					buffer1 <<= entry1.bits;
+					buffer2 <<= entry2.bits;
+					buffer3 <<= entry3.bits;
+					count0 -= entry0.bits;
+					count1 -= entry1.bits;
+					count2 -= entry2.bits;
+					count3 -= entry3.bits;
+				}
+			}
+
+			readers[0].buffer = buffer0;
+			readers[1].buffer = buffer1;
+			readers[2].buffer = buffer2;
+			readers[3].buffer = buffer3;
+			readers[0].count = count0;
+			readers[1].count = count1;
+			readers[2].count = count2;
+			readers[3].count = count3;
+			readers[0].cursor = cursor0;
+			readers[1].cursor = cursor1;
+			readers[2].cursor = cursor2;
+			readers[3].cursor = cursor3;
+
+			if (produced == capacity) break;
+		}
+
+		unsigned char symbol;
+		if (!DecodeSymbol(readers[produced % STREAM_COUNT], symbol)) break;
+
+		out[produced++] = symbol;
+	}
+
+	return produced;
+}
+
+// Decodes symbols where each symbol picks the table the next one is decoded with, into <out>
+// until <capacity> symbols were decoded or the input ran out
+//
+// This is a single stream loop like Decode's, except the root table is picked again for every
+// symbol. Each symbol waits for the one before it, so the root tables and the shifts for their
+// widths are gathered up front to keep that chain of loads as short as possible. The tables can
+// have different widths, so this loop isn't specialized for any of them
+size_t HuffmanDecodeTable::DecodeContext(const HuffmanDecodeTable* const tables[256], unsigned char previous, BitReader& reader, unsigned char* out, size_t capacity)
+{
+	const Entry* roots[256];
+	unsigned shifts[256];
+	unsigned widest = 0;
+	for (auto b = 0; b < 256; b++)
+	{
+		roots[b] = tables[b]->entries.data();
+		shifts[b] = 64 - tables[b]->rootBits;
+		widest = std::max(widest, tables[b]->rootBits);
+	}
+
+	size_t produced = 0;
+
+	while (produced < capacity)
+	{
+		auto buffer = reader.buffer;
+		auto count = reader.count;
+		auto cursor = reader.cursor;
+		auto end = reader.end;
+
+		while (produced < capacity && end - cursor >= 8)
+		{
+			if (count < widest)
+			{
+				buffer |= BitReader::LoadBigEndian(cursor) >> count;
+				cursor += (63 - count) >> 3;
+				count |= 56;
+			}
+
+			auto entry = roots[previous][buffer >> shifts[previous]];
+			if (entry.kind != ENTRY_SYMBOL) break;
+
+			previous = static_cast<unsigned char>(entry.value);
+			out[produced++] = previous;
+			buffer <<= entry.bits;
+			count -= entry.bits;
+		}
+
+		reader.buffer = buffer;
+		reader.count = count;
+		reader.cursor = cursor;
+
+		if (produced == capacity) break;
+
+		if (!tables[previous]->DecodeSymbol(reader, previous)) break;
+
+		out[produced++] = previous;
+	}
+
+	return produced;
+}
+
+// Decodes a symbol whose code did not resolve from the root table, or that
+// runs into the end of the input
+bool HuffmanDecodeTable::decodeSlow(BitReader& reader, unsigned char& symbol) const
+{
+	if (reader.Available() == 0) return false;
+
+	size_t offset = 0;
+	unsigned tableBits = rootBits;
+
+	while (true)
+	{
+		auto& entry = entries[offset + static_cast<size_t>(reader.Peek(tableBits))];
+
+		switch (entry.kind)
+		{
+		case ENTRY_SYMBOL:
+			// The code runs past the end of the input, so these are padding bits
+			if (entry.bits > reader.Available()) return false;
+
+			symbol = static_cast<unsigned char>(entry.value);
+			reader.Consume(entry.bits);
+			return true;
+
+		case ENTRY_LINK:
+			if (tableBits > reader.Available()) return false;
+
+			reader.Consume(tableBits);
+			offset = subTables[entry.value];
+			tableBits = entry.bits;
+
+			// Very long codes may not fit in the bit buffer all at once
+			if (reader.Available() < BitReader::REFILL_BITS) reader.Refill();
+			break;
+
+		default:
+			// Running into unused code space is expected when the lookup was padded with zeros
+			if (tableBits > reader.Available()) return false;
+
+			throw std::runtime_error("Input file is corrupt (no code matches the next " + std::to_string(tableBits) + " bits)");
+		}
+	}
+}
@@ -0,0 +1,192 @@
+/*
+ * DecodeTable.h - Lookup tables for decoding several bits of a Huffman code at once
+ *
+ * Built for EECS2510 - Nonlinear Data Structures
+ *	at The University of Toledo, Spring 2016
+ *
+ * Copyright (c) 2016 Nathan Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+#include <vector>
+
+#include "BitReader.h"
+
+struct HuffmanTree;
+
+// A multi-level lookup table for decoding Huffman codes
+//
+// The root table is indexed by the next RootBits() bits of the input. Codes that
+// are at most that long resolve to a symbol with a single lookup. Longer codes
+// share a root entry with every other code that has the same prefix, and that entry
+// links to a sub-table indexed by the bits that follow the prefix.
+//
+// The width of the root table is picked from the longest code when the table is
+// built, and the bulk decoding loops are compiled once for every width they can
+// run with, so their shifts and masks are constants.
+//
+// The table can be built from the code and length of every symbol, so it does not
+// care whether the codes came from walking a tree or from canonical assignment. It
+// can also be built straight from a tree, which handles codes of any length.
+class HuffmanDecodeTable
+{
+public:
+	// The number of bits resolved by the root table for long codes and for tables built from a tree
+	static const unsigned ROOT_BITS = 11;
+	// The fewest bits the root table is indexed by. Narrower tables don't save any lookups
+	static const unsigned MIN_ROOT_BITS = 9;
+	// The most bits the root table can be indexed by
+	static const unsigned MAX_ROOT_BITS = 12;
+	// The longest code that can be passed to Build(codes, lengths)
+	static const unsigned MAX_CODE_LENGTH = 64;
+	// The number of bitstreams decoded together by DecodeInterleaved
+	static const unsigned STREAM_COUNT = 4;
+
+	// The kinds of entries that can appear in a table
+	enum EntryKind : unsigned char
+	{
+		// No code starts with the bits that index this entry
+		ENTRY_INVALID = 0,
+		// The bits that index this entry start with the code for a symbol
+		ENTRY_SYMBOL = 1,
+		// The bits that index this entry are the prefix of longer codes
+		ENTRY_LINK = 2
+	};
+
+	// A single entry in the table
+	struct Entry
+	{
+		// For symbol entries, the decoded byte. For link entries, the index of the sub-table
+		unsigned short value;
+		// For symbol entries, the number of bits of the code resolved at this level
+		// For link entries, the number of bits that index the sub-table
+		unsigned char bits;
+		// The kind of entry
+		EntryKind kind;
+	};
+
+	// Rebuilds the table from the specified codes
+	//
+	// Each code is stored right-aligned in codes[symbol] and is lengths[symbol] bits long.
+	// Symbols with a length of zero do not appear in the encoded data.
+	//
+	// The root table is indexed by <rootBits> bits, which must be between MIN_ROOT_BITS and
+	// MAX_ROOT_BITS, or 0 to pick the width from the longest code (see PickRootBits)
+	void Build(const unsigned long long codes[256], const unsigned char lengths[256], unsigned rootBits = 0);
+
+	// Rebuilds the table from the specified tree
+	void Build(const HuffmanTree& tree);
+
+	// Decodes the next symbol from the reader
+	//
+	// Returns: false if the input ran out before a complete code was read
+	// Throws: std::runtime_error if the input does not contain a valid code
+	bool DecodeSymbol(BitReader& reader, unsigned char& symbol) const
+	{
+		if (reader.Available() < refillThreshold) reader.Refill();
+
+		auto& entry = entries[static_cast<size_t>(reader.Peek(rootBits))];
+		if (entry.kind == ENTRY_SYMBOL && entry.bits <= reader.Available())
+		{
+			symbol = static_cast<unsigned char>(entry.value);
+			reader.Consume(entry.bits);
+			return true;
+		}
+
+		return decodeSlow(reader, symbol);
+	}
+
+	// Decodes symbols from the reader into <out> until <capacity> symbols were decoded or
+	// the input ran out
+	//
+	// Returns: The number of symbols decoded
+	// Throws: std::runtime_error if the input does not contain a valid code
+	size_t Decode(BitReader& reader, unsigned char* out, size_t capacity) const;
+
+	// Decodes symbols that were dealt round-robin into STREAM_COUNT bitstreams, one reader per
+	// stream, into <out> until <capacity> symbols were decoded or a stream ran out
+	//
+	// Symbol i comes from readers[i % STREAM_COUNT]. The streams don't depend on each other, so
+	// the lookups for all of them can be in flight at once
+	//
+	// Returns: The number of symbols decoded
+	// Throws: std::runtime_error if the input does not contain a valid code
+	size_t DecodeInterleaved(BitReader readers[], unsigned char* out, size_t capacity) const;
+
+	// Decodes symbols where each symbol picks the table the next one is decoded with, into <out>
+	// until <capacity> symbols were decoded or the input ran out
+	//
+	// tables[b] decodes the symbol after b, and <previous> is the symbol before the first one
+	//
+	// Returns: The number of symbols decoded
+	// Throws: std::runtime_error if the input does not contain a valid code
+	static size_t DecodeContext(const HuffmanDecodeTable* const tables[256], unsigned char previous, BitReader& reader, unsigned char* out, size_t capacity);
+
+	// Returns: The number of bits the root table is indexed by
+	unsigned RootBits() const
+	{
+		return rootBits;
+	}
+
+	// Returns: The root table width Build picks for codes no longer than <longestCode> bits
+	//
+	// Codes that fit in ROOT_BITS get a root table exactly as wide as the longest of them (but at
+	// least MIN_ROOT_BITS), so every code resolves with one lookup from the smallest table that can do
+	// it. Longer codes get ROOT_BITS and the rare long ones go through sub-tables: a MAX_ROOT_BITS
+	// table takes more time in cache misses than it saves in sub-table lookups (see the kernel
+	// benchmarks), so it is only used when asked for
+	static unsigned PickRootBits(unsigned longestCode);
+
+private:
+	// The root table followed by all sub-tables
+	std::vector<Entry> entries;
+	// The offset into <entries> of each sub-table
+	std::vector<size_t> subTables;
+	// The number of bits the root table is indexed by
+	unsigned rootBits = ROOT_BITS;
+	// Refill the reader whenever it holds fewer bits than this, so short codes never need a refill
+	unsigned refillThreshold = 0;
+
+	// Adds a sub-table with the specified number of index bits to the end of the table
+	//
+	// Returns: A link entry pointing at the new sub-table
+	Entry addSubTable(unsigned bits);
+	// Fills the entries for the subtree at <node>, which is reached by <prefix> (<depth> bits)
+	// in the table at <offset> that is indexed by <tableBits> bits
+	void fill(const HuffmanTree& tree, unsigned short node, size_t offset, unsigned tableBits, unsigned depth, size_t prefix);
+	// Sets the refill threshold for a table whose longest code is <length> bits
+	void setRefillThreshold(unsigned length);
+	// Returns: The length of the longest path from <node> of <tree> to a leaf
+	static unsigned heightOf(const HuffmanTree& tree, unsigned short node);
+
+	// Decodes a symbol whose code did not resolve from the root table, or that
+	// runs into the end of the input
+	bool decodeSlow(BitReader& reader, unsigned char& symbol) const;
+
+	// Decodes symbols from a single bitstream with a root table of <TableBits> bits, so every shift
+	// in the inner loop is a constant
+	template <unsigned TableBits>
+	size_t decodeKernel(BitReader& reader, unsigned char* out, size_t capacity) const;
+	// Decodes symbols dealt round-robin into STREAM_COUNT bitstreams with a root table of <TableBits> bits,
+	// with every stream's bit buffer in its own local
+	template <unsigned TableBits>
+	size_t decodeInterleavedKernel(BitReader readers[], unsigned char* out, size_t capacity) const;
+};
@@ -0,0 +1,202 @@
+/*
+ * Dictionary.cpp - Shared code tables trained from a corpus, for files too small to carry their own
+ *
+ * Built for EECS2510 - Nonlinear Data Structures
+ *	at The University of Toledo, Spring 2016
+ *
+ * Copyright (c) 2016 Nathan Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "stdafx.h"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+#include "CanonicalCode.h"
+#include "Dictionary.h"
+#include "Histogram.h"
+#include "MappedFile.h"
+
+namespace dictionary
+{
+	// The size of the chunks files that can't be mapped are read in
+	static const size_t READ_BUFFER_SIZE = 1 << 20;
+
+	// Returns: The ID of a dictionary with the specified code lengths
+	//
+	// This is the 32-bit FNV-1a hash of the lengths
+	unsigned ComputeId(const unsigned char lengths[256])
+	{
+		unsigned hash = 2166136261u;
+		for (auto b = 0; b < 256; b++)
+		{
+			hash ^= lengths[b];
+			hash *= 16777619u;
+		}
+
+		return hash;
+	}
+
+	// Returns: The ID formatted as 8 hex digits, for messages
+	std::string FormatId(unsigned id)
+	{
+		const char* DIGITS = "0123456789abcdef";
+
+		std::string result = "0x";
+		for (auto shift = 28; shift >= 0; shift -= 4) result += DIGITS[(id >> shift) & 0x0F];
+
+		return result;
+	}
+
+#ifdef _WIN32
+
+	// Returns: The paths of the regular files directly inside <directory>, sorted by name
+	std::vector<std::string> ListFiles(const std::string& directory)
+	{
+		WIN32_FIND_DATAA entry;
+		auto handle = FindFirstFileA((directory + "\\*").c_str(), &entry);
+		if (handle == INVALID_HANDLE_VALUE) throw std::runtime_error("Unable to read directory " + directory);
+
+		std::vector<std::string> result;
+		do
+		{
+			if ((entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) result.push_back(directory + "\\" + entry.cFileName);
+		} while (FindNextFileA(handle, &entry));
+
+		FindClose(handle);
+
+		std::sort(result.begin(), result.end());
+		return result;
+	}
+
+#else
+
+	// Returns: The paths of the regular files directly inside <directory>, sorted by name
+	std::vector<std::string> ListFiles(const std::string& directory)
+	{
+		auto handle = opendir(directory.c_str());
+		if (handle == nullptr) throw std::runtime_error("Unable to read directory " + directory);
+
+		std::vector<std::string> result;
+		while (auto entry = readdir(handle))
+		{
+			auto path = directory + "/" + entry->d_name;
+
+			struct stat info;
+			if (stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode)) result.push_back(path);
+		}
+
+		closedir(handle);
+
+		std::sort(result.begin(), result.end());
+		return result;
+	}
+
+#endif
+
+	// Adds the number of times each byte occurrs in every file directly inside <directory> to <weights>
+	//
+	// Files are mapped where possible, and read in chunks otherwise
+	size_t CountCorpus(const std::string& directory, unsigned long long weights[256], unsigned threads)
+	{
+		auto files = ListFiles(directory);
+
+		for (auto& path : files)
+		{
+			MappedFile source(path);
+
+			if (source.IsMapped())
+			{
+				histogram::Count(source.Data(), source.Size(), weights, threads);
+				continue;
+			}
+
+			std::ifstream reader;
+			reader.open(path, std::ios::binary);
+			if (!reader.is_open()) throw std::runtime_error("Unable to open " + path + " for read");
+
+			std::vector<char> buffer(READ_BUFFER_SIZE);
+			while (reader.read(buffer.data(), buffer.size()), reader.gcount() > 0)
+			{
+				histogram::Count(reinterpret_cast<const unsigned char*>(buffer.data()), static_cast<size_t>(reader.gcount()), weights);
+			}
+		}
+
+		return files.size();
+	}
+
+	// Writes the dictionary to the file at <path>
+	void Save(const std::string& path, const Dictionary& dictionary)
+	{
+		std::vector<unsigned char> contents;
+		contents.push_back(static_cast<unsigned char>(HEADER >> 8));
+		contents.push_back(static_cast<unsigned char>(HEADER & 0xFF));
+		contents.push_back(VERSION);
+		for (auto shift = 24; shift >= 0; shift -= 8) contents.push_back(static_cast<unsigned char>(dictionary.Id >> shift));
+		canonical::AppendLengths(dictionary.Lengths, contents);
+
+		std::ofstream writer;
+		writer.open(path, std::ios::binary);
+		if (!writer.is_open() || !writer.good()) throw std::runtime_error("Cannot open file for write");
+
+		writer.write(reinterpret_cast<const char*>(contents.data()), contents.size());
+		if (!writer.flush()) throw std::runtime_error("Failed to write " + path);
+	}
+
+	// Reads the dictionary file at <path>
+	Dictionary Load(const std::string& path)
+	{
+		std::ifstream reader;
+		reader.open(path, std::ios::binary);
+		if (!reader.is_open() || !reader.good()) throw std::runtime_error("Cannot open dictionary " + path + " for read");
+
+		std::vector<unsigned char> contents((std::istreambuf_iterator<char>(reader)), std::istreambuf_iterator<char>());
+
+		const size_t HEADER_SIZE = 7;
+		if (contents.size() < HEADER_SIZE || ((contents[0] << 8) | contents[1]) != HEADER) throw std::invalid_argument(path + " is not a dictionary");
+		if (contents[2] != VERSION) throw std::invalid_argument("Don't know how to read dictionary version " + std::to_string(contents[2]));
+
+		Dictionary result;
+		result.Id = (static_cast<unsigned>(contents[3]) << 24) | (contents[4] << 16) | (contents[5] << 8) | contents[6];
+
+		canonical::ParseLengths(contents.data() + HEADER_SIZE, contents.size() - HEADER_SIZE, result.Lengths);
+
+		// Every byte needs a code, since the files encoded with the dictionary can contain anything
+		for (auto b = 0; b < 256; b++)
+		{
+			if (result.Lengths[b] == 0) throw std::invalid_argument("Dictionary has no code for byte " + std::to_string(b));
+		}
+
+		if (ComputeId(result.Lengths) != result.Id) throw std::invalid_argument("Dictionary " + path + " is corrupt (its code lengths don't match its ID)");
+
+		return result;
+	}
+}
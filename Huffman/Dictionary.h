@@ -0,0 +1,83 @@
+/*
+ * Dictionary.h - Shared code tables trained from a corpus, for files too small to carry their own
+ *
+ * Built for EECS2510 - Nonlinear Data Structures
+ *	at The University of Toledo, Spring 2016
+ *
+ * Copyright (c) 2016 Nathan Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+
+// A dictionary is a code table trained once from a corpus of typical inputs and shared by the
+// encoder and decoder, so a small file doesn't need a histogram pass or a code table of its own.
+// Files encoded with a dictionary refer to it by its ID, which is a hash of its code lengths, so
+// decoding with the wrong dictionary is caught instead of producing garbage.
+namespace dictionary
+{
+	// 'hd' Magic Header to distinguish dictionary files
+	const unsigned short HEADER = 0x6864;
+	// The dictionary file format version
+	const unsigned char VERSION = 0x01;
+
+	// A trained code table
+	struct Dictionary
+	{
+		// Identifies the dictionary in the files encoded with it
+		unsigned Id;
+		// The length of the canonical code for each byte. Every byte has a code
+		unsigned char Lengths[256];
+	};
+
+	// Returns: The ID of a dictionary with the specified code lengths
+	unsigned ComputeId(const unsigned char lengths[256]);
+
+	// Returns: The ID formatted as 8 hex digits, for messages
+	std::string FormatId(unsigned id);
+
+	// Returns: The paths of the regular files directly inside <directory>, sorted by name
+	//
+	// Throws: std::runtime_error if the directory can't be read
+	std::vector<std::string> ListFiles(const std::string& directory);
+
+	// Adds the number of times each byte occurrs in every file directly inside <directory> to
+	// <weights>, counting each file on up to <threads> threads (0 for one per core)
+	//
+	// Returns: The number of files that were counted
+	size_t CountCorpus(const std::string& directory, unsigned long long weights[256], unsigned threads);
+
+	// Writes the dictionary to the file at <path>
+	//
+	// File Format:
+	//		2 Bytes - 0x6864 - 'hd' Magic Header to distinguish dictionary files
+	//		1 Byte  - 0x01   - Dictionary format version number
+	//		4 Bytes - The ID of the dictionary, big-endian
+	//		Code Lengths - Variable, in the same format as version 3 files (see canonical::AppendLengths)
+	void Save(const std::string& path, const Dictionary& dictionary);
+
+	// Reads the dictionary file at <path>
+	//
+	// Throws: std::invalid_argument if the file is not a dictionary, the code lengths leave out a
+	// byte, or they don't match the ID
+	Dictionary Load(const std::string& path);
+}
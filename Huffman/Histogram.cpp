@@ -0,0 +1,161 @@
+/*
+ * Histogram.cpp - Implementation for byte histogram kernels
+ *
+ * Built for EECS2510 - Nonlinear Data Structures
+ *	at The University of Toledo, Spring 2016
+ *
+ * Copyright (c) 2016 Nathan Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "stdafx.h"
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "Histogram.h"
+#include "Parallel.h"
+
+namespace histogram
+{
+	// The number of counter banks consecutive bytes are spread over
+	static const size_t BANKS = 4;
+
+	// The most bytes counted into 32-bit banks before they are added to the weights. Each
+	// bank sees at most a quarter of them, so they can't overflow
+	static const size_t BANK_LIMIT = static_cast<size_t>(1) << 31;
+
+	// Returns: The eight bytes at <bytes> as a little-endian integer, which is the order
+	// they are counted in
+	static inline unsigned long long load(const unsigned char* bytes)
+	{
+		unsigned long long value;
+		std::memcpy(&value, bytes, sizeof(value));
+
+		return value;
+	}
+
+	// Adds the number of times each byte occurrs in <size> bytes at <data> to <weights>
+	void Count(const unsigned char* data, size_t size, unsigned long long weights[256])
+	{
+		while (size > 0)
+		{
+			auto chunk = size < BANK_LIMIT ? size : BANK_LIMIT;
+			unsigned counts[BANKS][256] = {};
+
+			auto p = data;
+			auto end = data + chunk;
+
+			// Two words per iteration. Byte i of each word goes to bank i % 4
+			while (end - p >= 16)
+			{
+				auto a = load(p);
+				auto b = load(p + 8);
+				p += 16;
+
+				counts[0][a & 0xFF]++;
+				counts[1][(a >> 8) & 0xFF]++;
+				counts[2][(a >> 16) & 0xFF]++;
+				counts[3][(a >> 24) & 0xFF]++;
+				counts[0][(a >> 32) & 0xFF]++;
+				counts[1][(a >> 40) & 0xFF]++;
+				counts[2][(a >> 48) & 0xFF]++;
+				counts[3][a >> 56]++;
+
+				counts[0][b & 0xFF]++;
+				counts[1][(b >> 8) & 0xFF]++;
+				counts[2][(b >> 16) & 0xFF]++;
+				counts[3][(b >> 24) & 0xFF]++;
+				counts[0][(b >> 32) & 0xFF]++;
+				counts[1][(b >> 40) & 0xFF]++;
+				counts[2][(b >> 48) & 0xFF]++;
+				counts[3][b >> 56]++;
+			}
+
+			while (p < end) counts[0][*p++]++;
+
+			for (auto b = 0; b < 256; b++)
+			{
+				weights[b] += static_cast<unsigned long long>(counts[0][b]) + counts[1][b] + counts[2][b] + counts[3][b];
+			}
+
+			data += chunk;
+			size -= chunk;
+		}
+	}
+
+	// Splits the input into ranges that are counted on up to <threads> threads and merged at the end
+	void Count(const unsigned char* data, size_t size, unsigned long long weights[256], unsigned threads)
+	{
+		threads = parallel::ThreadCount(threads);
+
+		// Don't bother starting threads for ranges that would be counted faster than a thread starts
+		size_t ranges = size / MIN_THREAD_BYTES;
+		if (ranges > threads) ranges = threads;
+
+		if (ranges <= 1)
+		{
+			Count(data, size, weights);
+			return;
+		}
+
+		auto rangeSize = (size + ranges - 1) / ranges;
+		std::vector<unsigned long long> partial(ranges * 256, 0);
+
+		parallel::For(ranges, threads, [&](size_t r)
+		{
+			auto start = r * rangeSize;
+			auto length = start + rangeSize < size ? rangeSize : size - start;
+
+			Count(data + start, length, partial.data() + r * 256);
+		});
+
+		for (size_t r = 0; r < ranges; r++)
+		{
+			for (auto b = 0; b < 256; b++) weights[b] += partial[r * 256 + b];
+		}
+	}
+
+	// Adds the byte counts to <weights> with a single counter per byte
+	void CountSimple(const unsigned char* data, size_t size, unsigned long long weights[256])
+	{
+		for (size_t i = 0; i < size; i++) weights[data[i]]++;
+	}
+
+	// Returns: The order-0 entropy of the bytes counted in <weights>, in bits for all of them
+	//
+	// A byte that makes up p of the input carries -log2(p) bits
+	double EntropyBits(const unsigned long long weights[256])
+	{
+		unsigned long long total = 0;
+		for (auto b = 0; b < 256; b++) total += weights[b];
+
+		if (total == 0) return 0;
+
+		double bits = 0;
+		auto logTotal = std::log2(static_cast<double>(total));
+		for (auto b = 0; b < 256; b++)
+		{
+			if (weights[b] > 0) bits += weights[b] * (logTotal - std::log2(static_cast<double>(weights[b])));
+		}
+
+		return bits;
+	}
+}
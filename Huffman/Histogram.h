@@ -0,0 +1,60 @@
+/*
+ * Histogram.h - Byte histograms for building weight tables
+ *
+ * Built for EECS2510 - Nonlinear Data Structures
+ *	at The University of Toledo, Spring 2016
+ *
+ * Copyright (c) 2016 Nathan Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+// Counts how many times each byte occurrs in a buffer
+//
+// The counts are added to an existing weight table, so a table can be built up over
+// several buffers (for example, chunks of a stream)
+namespace histogram
+{
+	// The smallest range of the input worth handing to its own thread
+	const size_t MIN_THREAD_BYTES = 1 << 20;
+
+	// Adds the number of times each byte occurrs in <size> bytes at <data> to <weights>
+	//
+	// A single counter per byte is the obvious way to do this, but runs of the same byte then
+	// increment the same counter over and over, and every increment has to wait for the one
+	// before it to be stored. This spreads consecutive bytes over several banks of counters
+	// so the increments are independent, and reads the input eight bytes at a time
+	void Count(const unsigned char* data, size_t size, unsigned long long weights[256]);
+
+	// Same as Count, but splits the input into ranges that are counted on up to <threads>
+	// threads (0 for one per core) and merged at the end
+	void Count(const unsigned char* data, size_t size, unsigned long long weights[256], unsigned threads);
+
+	// Adds the byte counts to <weights> with a single counter per byte
+	//
+	// This is the reference the faster kernels are checked and benchmarked against
+	void CountSimple(const unsigned char* data, size_t size, unsigned long long weights[256]);
+
+	// Returns: The order-0 entropy of the bytes counted in <weights>, in bits for all of them
+	//
+	// This is the least any code that gives each byte its own bit pattern can encode them to
+	double EntropyBits(const unsigned long long weights[256]);
+}
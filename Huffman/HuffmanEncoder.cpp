@@ -26,9 +26,22 @@
  */
 
 #include "stdafx.h"
+#include <algorithm>
+#include <climits>
 #include <fstream>
-
+#include <vector>
+
+#include "Ans.h"
+#include "BitWriter.h"
+#include "CanonicalCode.h"
+#include "ContextModel.h"
+#include "Dictionary.h"
+#include "Histogram.h"
 #include "HuffmanEncoder.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+#include "Pipeline.h"
+#include "RunLength.h"
 #include "Verbose.h"
 
 // Construct an Empty Huffman Encoder
@@ -37,64 +50,172 @@ HuffmanEncoder::HuffmanEncoder() : IsDirty(true) {}
 // Construct a Huffman Encoder from the specified weight table
 HuffmanEncoder::HuffmanEncoder(unsigned long long weights[256])
 {
-	// Set aside room for 256 leaf nodes
-	HuffmanTreeNode* nodes[256] = { nullptr };
+	// Remember the weights. The codes are built from them once we know which file format
+	// version they are for, since version 3 codes don't need the full encoding tree
+	std::copy(weights, weights + 256, Weights);
+	HasWeights = true;
+}
 
-	// Initialize the nodes with weights
-	for (auto b = 0; b < 256; b++)
+HuffmanEncoder::~HuffmanEncoder()
+{
+}
+
+// Construct a huffman encoder, populating the weights table from the bytes at the
+// specified file path.
+//
+// The file is mapped into memory and the number of times each byte occurrs is recorded
+// on up to <threads> threads (0 for one per core). A Huffman Encoder is then constructed
+// from the weight table, and uses the same number of threads for blocks
+//
+// The encoder keeps the mapping, so encoding the same file afterwards reads the same pages
+// again instead of reopening the file. Files that can't be mapped are read in large chunks
+HuffmanEncoder* HuffmanEncoder::InitializeFromFile(std::string path, unsigned threads)
+{
+	auto source = std::make_shared<MappedFile>(path);
+
+	unsigned long long weight[256] = {0};
+
+	if (source->IsMapped())
 	{
-		// A potential optimization could be made here that does not include unused bytes
-		// However, this means that small files might not encode/decode successfully since
-		// a sufficiently long enough bitstring would not exist
-		nodes[b] = new HuffmanTreeNode(b, weights[b]);
+		histogram::Count(source->Data(), source->Size(), weight, threads);
 	}
+	else
+	{
+		std::ifstream reader;
+		reader.open(path, std::ios::binary);
+
+		if (!reader.is_open()) throw std::runtime_error("Unable to open file for read");
 
-	// Build the tree from the weights
-	BuildTreeFromNodes(nodes);
+		// Read through the file to get the weight for all bytes
+		std::vector<char> buffer(INPUT_BUFFER_SIZE);
+		while (reader.read(buffer.data(), buffer.size()), reader.gcount() > 0)
+		{
+			histogram::Count(reinterpret_cast<const unsigned char*>(buffer.data()), static_cast<size_t>(reader.gcount()), weight);
+		}
+		reader.close();
+	}
 
-	// Now, build the bitstring table
-	// This assignment requires us to use std::strings and not bitsets
-	verbose::write("Building Encoding Table...");
-	BuildEncodingTable("", TreeRoot);
+	// And build an encoder from the weights
+	auto encoder = new HuffmanEncoder(weight);
+	encoder->SetThreads(threads);
+	if (source->IsMapped()) encoder->Source = source;
 
-	verbose::write("Padding Hint: " + PaddingHint);
+	return encoder;
 }
 
-HuffmanEncoder::~HuffmanEncoder()
+// Construct a huffman encoder, populating the weights table from the <size> bytes at <data>
+//
+// The bytes are counted on up to <threads> threads (0 for one per core), and the encoder
+// uses the same number of threads for blocks
+HuffmanEncoder* HuffmanEncoder::InitializeFromBuffer(const unsigned char* data, size_t size, unsigned threads)
 {
-	if (TreeRoot != nullptr) delete TreeRoot;
+	unsigned long long weight[256] = {0};
+	histogram::Count(data, size, weight, threads);
+
+	auto encoder = new HuffmanEncoder(weight);
+	encoder->SetThreads(threads);
+
+	return encoder;
 }
 
-// Construct a huffman encoder, populating the weights table from the bytes at the
-// specified file path.
+// Construct a huffman encoder that encodes with the codes of the specified dictionary
 //
-// The file is read byte by byte, and the number of times each byte occurrs is recorded
-// A Huffman Encoder is then constructed from the weight table
-HuffmanEncoder* HuffmanEncoder::InitializeFromFile(std::string path)
+// There are no weights to count, so this is all it takes to encode a small file
+HuffmanEncoder* HuffmanEncoder::InitializeFromDictionary(const dictionary::Dictionary& dictionary, unsigned threads)
 {
-	std::ifstream reader;
-	reader.open(path, std::ios::binary);
+	auto encoder = new HuffmanEncoder();
+	encoder->SetDictionary(dictionary);
+	encoder->SetThreads(threads);
+
+	return encoder;
+}
 
-	if (!reader.is_open()) throw std::runtime_error("Unable to open file for read");
+// Builds a dictionary from the weights this encoder was constructed with, limited to the max code length
+//
+// Bytes that don't occur in the weights are given a weight of one, so that every byte has a code
+dictionary::Dictionary HuffmanEncoder::BuildDictionary() const
+{
+	if (!HasWeights) throw std::runtime_error("A dictionary can only be built from an encoder with weights");
 
-	unsigned long long weight[256] = {0};
+	unsigned long long weights[256];
+	for (auto b = 0; b < 256; b++) weights[b] = std::max<unsigned long long>(Weights[b], 1);
 
-	// Read through the file to get the weight for all bytes
-	while(!reader.eof())
-	{
-		char byte;
-		reader.get(byte);
+	dictionary::Dictionary result;
+	BuildLengths(weights, result.Lengths);
 
-		// Reinterpret the byte read as unsigned and increment the weight table element at its offset by one
-		weight[reinterpret_cast<unsigned char&>(byte)]++;
+	for (auto b = 0; b < 256; b++)
+	{
+		if (result.Lengths[b] > canonical::MAX_CODE_LENGTH)
+		{
+			throw std::runtime_error("The code for byte " + std::to_string(b) + " is too long for a canonical code, limit the code length");
+		}
 	}
-	reader.close();
 
-	// And build an encoder from the weights
-	return new HuffmanEncoder(weight);
+	result.Id = dictionary::ComputeId(result.Lengths);
+	return result;
 }
 
-// Encodes the file at <input> with the pre-generated encoding table and writes to <output>
+// Encodes the <size> bytes at <data> with the pre-generated encoding table, and writes the
+// encoded file to <out>
+//
+// File Format (Version 3):
+//		2 Bytes - 0x687A - 'hz' Magic Header to distinguish file format
+//		1 Byte  - 0x03   - File format version number
+//		1 Byte  - Flags, any of FLAG_BLOCKS, FLAG_STREAMS, FLAG_CONTEXT, FLAG_ADAPTIVE, FLAG_DICTIONARY, FLAG_FRAMED,
+//				  FLAG_ANS and FLAG_RUNS
+//		8 Bytes - The length of the original file, big-endian, or UNKNOWN_LENGTH for framed streams
+//		Code Lengths - Variable, the length of the canonical code for each byte in one of the following formats:
+//				1 Byte  - 0x00 followed by 128 bytes, each holding two 4-bit lengths (the even byte in the high nibble)
+//				1 Byte  - 0x01 followed by 256 bytes, one length per byte
+//				1 Byte  - 0x02 followed by the number of coded bytes and a (byte, length) pair for each
+//			The format that takes the least space is used. Bytes that do not occur in the file have a length of 0
+//		Encoded Data
+//			Variable - The canonical codes converted to binary. The last byte is padded with zeros
+//
+//		If the flags have FLAG_BLOCKS set, the input is split into blocks that are encoded independently:
+//		4 Bytes - The number of input bytes in each block (the last block may be shorter), big-endian
+//		Blocks  - Variable, the encoded data of each block, each padded with zeros to a whole byte
+//		Index   - 8 Bytes per block, the offset of the end of each block from the start of the first, big-endian
+//
+//		If the flags also have FLAG_ADAPTIVE set, there are no code lengths in the header. Instead, each block
+//		starts with its kind:
+//		1 Byte  - BLOCK_HUFFMAN, followed by the code lengths of the block in the format above, then the encoded data
+//				  BLOCK_RAW, followed by the bytes of the block as they are
+//				  BLOCK_RUNS, followed by a (byte, run length - 1) pair for each run of at most 256 bytes
+//
+//		If the flags also have FLAG_STREAMS set, the bytes of each block are dealt round-robin into four
+//		bitstreams (byte i goes to stream i % 4), and each block is laid out as:
+//		12 Bytes - The sizes of the first three streams in bytes, 4 bytes each, big-endian
+//		Streams  - Variable, each stream padded with zeros to a whole byte. The last stream takes up the
+//					rest of the block
+//
+//		If the flags have FLAG_CONTEXT set, the code lengths are replaced by a code table per cluster of contexts:
+//		1 Byte   - The number of tables, minus one
+//		256 Bytes - The table that codes the bytes after each byte. Left out if there is only one table
+//		Code Lengths - Variable, the code lengths of each table in the format above
+//			Each byte is coded with the table of the byte before it. The first byte of every block
+//			is coded as if it followed context::INITIAL_CONTEXT. Files with contexts always have blocks
+//
+//		If the flags have FLAG_DICTIONARY set, the code lengths are replaced by the dictionary the codes come from:
+//		4 Bytes - The ID of the dictionary, big-endian (see dictionary::ComputeId)
+//
+//		If the flags have FLAG_ANS set, the code lengths are replaced by the tANS distribution (see
+//		ans::AppendDistribution), and each block is coded with it as a single backwards-read stream:
+//		1 Byte   - The table log
+//		1 Byte   - The number of bytes that own states, minus one
+//		3 Bytes  - For each of them, the byte and the number of states it owns, big-endian
+//			Files with tANS always have blocks, and can't have streams, contexts, adaptive blocks or a dictionary
+//
+//		If the flags have FLAG_RUNS set, the bytes that are coded (and split into blocks) are the run-length
+//		pre-transformed input (see runlength::Transform), and their number follows the original length:
+//		8 Bytes - The length of the pre-transformed input, big-endian
+//
+//		If the flags have FLAG_FRAMED set, the header after the flags is put in front of its size, and the
+//		blocks are written as frames instead of being followed by an index:
+//		4 Bytes - The size of the rest of the header, big-endian
+//		Header  - The length (and pre-transformed length), codes and block size, as above
+//		Frames  - For each block, its encoded size and original size, 4 bytes each, big-endian, then the
+//				  encoded block. A frame with both sizes 0 ends the file
 //
 // File Format (Version 2):
 //		2 Bytes - 0x687A - 'hz' Magic Header to distinguish file format
@@ -108,433 +229,2088 @@ HuffmanEncoder* HuffmanEncoder::InitializeFromFile(std::string path)
 //		Encoded Data
 //			Variable - The raw bitstrings converted to binary. The last bitstring is padded with the beginning of the
 //						longest bitstring
-void HuffmanEncoder::EncodeFile(std::string input, std::string output, size_t& bytesRead, size_t& bytesWritten)
+void HuffmanEncoder::Encode(const unsigned char* data, size_t size, ByteSink& out)
 {
-	// Somehow, we have an encoder that wasn't properly initialized
-	if (TreeRoot == nullptr) throw std::runtime_error("Encoder not initialized");
-
-	// The encoding table was marked dirty, it needs to be rebuilt from the tree
-	if (IsDirty) BuildEncodingTable("", TreeRoot);
+	// The header records the length of the original input, but the pre-transformed bytes are the ones that are coded
+	auto length = static_cast<unsigned long long>(size);
+	std::vector<unsigned char> transformed;
 
-	std::ifstream reader;
-	std::ofstream writer;
+	// The pre-transformed bytes are coded with codes built from their own weights, which only fit this input.
+	// The encoder's weights are left alone, and the codes are rebuilt from them the next time they're needed
+	unsigned long long transformedWeights[256];
+	auto transform = RunTransform && FormatVersion == VERSION;
 
-	reader.open(input, std::ios::binary);
-	if (!reader.is_open() || !reader.good()) throw std::runtime_error("Cannot open file for read");
-	
-	writer.open(output, std::ios::binary);
-	if (!writer.is_open() || !writer.good())
+	if (transform)
 	{
-		reader.close();
-		throw std::runtime_error("Cannot open file for write");
+		TransformRuns(data, size, transformed, transformedWeights);
+		data = transformed.data();
+		size = transformed.size();
+		IsDirty = true;
 	}
 
-	verbose::write("Starting encode of " + input);
-
-	// Write the header and file format version
-	writer.put((HEADER >> 8) & 0xFF);
-	writer.put(HEADER & 0xFF);
-	writer.put(VERSION);
-	bytesWritten += 3;
+	PrepareEncode(transform && HasWeights ? transformedWeights : Weights);
+	if (transform) IsDirty = true;
 
-	// Write the decoding tree
-	// This allows encoded files to be decoded without needing the original file
-	WriteEncodingTree(writer, TreeRoot, bytesWritten);
+	if (FormatVersion == LEGACY_VERSION)
+	{
+		if (BlockSize > 0 || Interleaved || MaxContextTables > 0 || Adaptive || Pipelined || UseAns || RunTransform) verbose::write("Version 2 files can't be split into blocks or streams, use contexts or be pre-transformed, encoding a single stream");
 
-	std::string encodingBuffer = "";
+		// Write the header and file format version
+		out.Put((HEADER >> 8) & 0xFF);
+		out.Put(HEADER & 0xFF);
+		out.Put(static_cast<unsigned char>(FormatVersion));
 
-	// Read the file one byte at a time
-	char byte;
-	while(reader.get(byte))
+		// Write the decoding tree
+		// This allows encoded files to be decoded without needing the original file
+		WriteEncodingTree(out, Tree, Tree.Root);
+	}
+	else
 	{
-		bytesRead++;
+		auto blockSize = BlockSize > 0 ? BlockSize : DEFAULT_BLOCK_SIZE;
+		auto flags = PrepareFlags(data, size, blockSize, false);
 
-		// And add its encoding representation to the output buffer
-		encodingBuffer += EncodingTable[reinterpret_cast<unsigned char&>(byte)];
+		WriteHeader(out, flags, length, size, blockSize);
 
-		while (encodingBuffer.length() >= 8)
+		if ((flags & FLAG_FRAMED) != 0)
 		{
-			// Its time to flush the buffer
-			bytesWritten++;
-
-			// Extract 8 bits from the buffer
-			auto slice = encodingBuffer.substr(0, 8);
-			encodingBuffer.erase(0, 8);
+			EncodeFrames(MemoryReader(data, size), blockSize, out);
+			return;
+		}
 
-			// And write the byte value to the file
-			writer.put(BitfieldToByte(slice));
+		if ((flags & FLAG_BLOCKS) != 0)
+		{
+			EncodeBlocks(data, size, blockSize, out);
+			return;
 		}
 	}
-	reader.close();
 
-	// Now that a read failed, we should be at the end of the file
-	if (!reader.eof())
-	{
-		writer.close();
-		throw std::runtime_error("Falied to read file completely");
-	}
+	// Codes are packed into a 64-bit accumulator and written out a word at a time. Small inputs
+	// don't need the whole output buffer, which would cost more to allocate than to encode them
+	BitWriter bits(out, size + 8);
+	EncodeBytes(data, size, bits);
 
 	// Check to see if we have a partial byte to write
-	if(encodingBuffer.length() > 0)
+	if(bits.PendingBits() > 0)
 	{
-		bytesWritten++;
-
-		verbose::write(
-			"Encoded output not byte-aligned. Need " + std::to_string(8 - encodingBuffer.length()) +
-			" more bits (Buffer contains: " + encodingBuffer + ")"
-		);
-
-		// Pad the buffer in case we're not aligned to a byte
-		// By padding with the longest bitstring, we ensure we will never reach a leaf node when decoding the final byte
-		encodingBuffer += PaddingHint.substr(0, 8 - encodingBuffer.size());
+		auto needed = 8 - bits.PendingBits();
+		verbose::write("Encoded output not byte-aligned. Need " + std::to_string(needed) + " more bits");
 
-		writer.put(BitfieldToByte(encodingBuffer));
+		// Pad the output in case we're not aligned to a byte
+		if (FormatVersion == LEGACY_VERSION)
+		{
+			// By padding with the longest bitstring, we ensure we will never reach a leaf node when decoding the final byte
+			WriteBitstring(bits, PaddingHint.substr(0, needed));
+		}
+		else
+		{
+			// The decoder knows how many bytes to decode, so the padding is never read
+			bits.Put(0, needed);
+		}
 	}
 
-	writer.flush();
-	writer.close();
+	bits.Finish();
 }
 
-// Read the subtree from the specified input stream
-HuffmanTreeNode* HuffmanEncoder::ReadEncodingTree(std::ifstream& reader, size_t& bytesRead)
+// Builds the codes for the file format version now, instead of when the first file is encoded
+void HuffmanEncoder::BuildCodes()
 {
-	// Read the node type from the stream
-	char nodeType;
-	reader.get(nodeType);
-	bytesRead++;
-
-	// If this is a leaf node, read its payload 
-	if (nodeType == FLAG_LEAF_NODE)
-	{
-		char b;
-		reader.get(b);
-		bytesRead++;
-
-		return new HuffmanTreeNode(reinterpret_cast<unsigned char&>(b), 0);
-	}
-	
-	// If this isn't a type of node we recognized, then either the file format is corrupt
-	// Or it wasn't encoded with this version of the software
-	if (nodeType > FLAG_BOTH_NODES) throw std::invalid_argument("Unrecognized node type: " + static_cast<unsigned>(nodeType));
-	
-	// Otherwise, read the left and right sub trees from the stream if their bitmask is set
-	auto result = new HuffmanTreeNode(0, 0);
-	if ((nodeType & FLAG_LEFT_CHILD) == FLAG_LEFT_CHILD)   result->Left  = ReadEncodingTree(reader, bytesRead);
-	if ((nodeType & FLAG_RIGHT_CHILD) == FLAG_RIGHT_CHILD) result->Right = ReadEncodingTree(reader, bytesRead);
+	PrepareEncode(Weights);
+}
 
-	return result;
+// Copies the length of the canonical code for each byte to <lengths>, building the codes first if needed
+void HuffmanEncoder::GetCodeLengths(unsigned char lengths[256])
+{
+	PrepareEncode(Weights);
+	std::copy(CodeLengths, CodeLengths + 256, lengths);
 }
 
-// Decodes the bit from ubyte masked by the specified mask, moving the specified node pointer along the tree
-// If the bit is set, we're supposed to "take" the right branch, so we should expect a node to the right
-// If the bit is not set, we're supposed to "take" the left branch, so we should expect a node to the left
+// Works out the size of the file Encode would write with the current settings, from the weights and codes alone
 //
-// If for some reason we can't take the path indicated by the bit, the file is corrupt
-// Since the currentNode pointer would have been reset by the call to WriteIfLeaf immediately before this method
-void HuffmanEncoder::DecodeBit(HuffmanTreeNode*& currentNode, unsigned char ubyte, unsigned char mask)
+// The encoded data of a code is the sum of every byte's weight times the length of its code, and everything
+// around it (header, code table, block sizes and index, frames) has a size that only depends on the settings
+// and the number of blocks. The data of each block and stream is padded to a whole byte, which is only
+// known once it's encoded, so files with more than one block or stream are given the most they can take
+HuffmanEncoder::SizeEstimate HuffmanEncoder::Estimate()
 {
-	if((ubyte & mask) == mask)
+	if (!HasWeights) throw std::runtime_error("Only an encoder built from weights can estimate the size of its input");
+
+	SizeEstimate estimate;
+	for (auto weight : Weights) estimate.InputBytes += weight;
+	estimate.EntropyBytes = histogram::EntropyBits(Weights) / 8;
+
+	PrepareEncode(Weights);
+
+	if (FormatVersion == LEGACY_VERSION)
 	{
-		if(currentNode->Right != nullptr) currentNode = currentNode->Right;
-		else throw std::runtime_error("Input file is corrupt (expected right treepath does not exist)");
+		// The header, the whole tree and the codes from it, padded to a whole byte
+		std::vector<unsigned char> tree;
+		VectorSink sink(tree);
+		WriteEncodingTree(sink, Tree, Tree.Root);
+
+		unsigned long long bits = 0;
+		for (auto b = 0; b < 256; b++) bits += Weights[b] * EncodingTable[b].size();
+
+		estimate.EncodedBytes = 3 + tree.size() + (bits + 7) / 8;
+		return estimate;
 	}
-	else
+
+	if (MaxContextTables > 0 || Adaptive || RunTransform)
 	{
-		if (currentNode->Left != nullptr) currentNode = currentNode->Left;
-		else throw std::runtime_error("Input file is corrupt (expected left treepath does not exist)");
+		throw std::invalid_argument("Context tables, adaptive blocks and the run-length pre-transform depend on the order of the bytes, not just their weights, so their size can't be estimated");
 	}
-}
 
-// Checks the specified node pointer, and if it is a leaf, writes its payload to the specified output stream
-void HuffmanEncoder::WriteIfLeaf(std::ofstream& writer, HuffmanTreeNode*& currentNode, size_t& bytesWritten) const
-{
-	if(currentNode->IsLeaf())
-	{
-		// We're at a leaf. Write a new byte
-		writer.put(currentNode->payload);
-		bytesWritten++;
+	auto blockSize = BlockSize > 0 ? BlockSize : DEFAULT_BLOCK_SIZE;
+	auto flags = PrepareFlags(nullptr, 0, blockSize, false);
 
-		// Reset the currentNode pointer to the root of the tree
-		currentNode = TreeRoot;
-	}
-}
+	// The magic header, version, flags, length and codes, then the block size and the size of a framed header
+	std::vector<unsigned char> codes;
+	VectorSink sink(codes);
+	WriteCodes(sink, flags);
 
-// Decodes the input file to the specified output file
-//
-// See EncodeFile(...) for documentation on the file format
-void HuffmanEncoder::DecodeFile(std::string input, std::string output, size_t& bytesRead, size_t& bytesWritten)
-{
-	std::ifstream reader;
-	std::ofstream writer;
+	estimate.EncodedBytes = 4 + 8 + codes.size();
+	if ((flags & FLAG_BLOCKS) != 0) estimate.EncodedBytes += 4;
+	if ((flags & FLAG_FRAMED) != 0) estimate.EncodedBytes += 4;
 
-	reader.open(input, std::ios::binary);
-	if (!reader.is_open() || !reader.good()) throw std::runtime_error("Cannot open file for read");
+	auto ans = (flags & FLAG_ANS) != 0;
+	auto bits = ans ? ans::EncodedBits(Weights, AnsDistribution) : canonical::EncodedBits(Weights, CodeLengths);
 
-	writer.open(output, std::ios::binary);
-	if (!writer.is_open() || !writer.good())
+	if ((flags & FLAG_BLOCKS) == 0)
 	{
-		reader.close();
-		throw std::runtime_error("Cannot open file for write");
+		estimate.EncodedBytes += (bits + 7) / 8;
+		return estimate;
 	}
 
-	verbose::write("Starting decoding of " + input);
+	auto blocks = (estimate.InputBytes + blockSize - 1) / blockSize;
+	auto streams = (flags & FLAG_STREAMS) != 0 ? HuffmanDecodeTable::STREAM_COUNT : 1;
 
-	// Read the file header and version
-	short header = 0;
-	char version;
+	// Every block has an index entry or a frame header of 8 bytes, and framed files end with an empty frame.
+	// Interleaved blocks start with the sizes of their streams, and tANS blocks end with the final state and a marker bit
+	auto overhead = 8 + 4 * (streams - 1);
+	if (ans) bits += blocks * (AnsDistribution.TableLog + 1);
 
-	char h1;
-	char h2;
-	reader.get(h1);
-	reader.get(h2);
+	// Each block and stream gives up to seven bits of padding
+	auto padded = blocks * streams;
+	estimate.EncodedBytes += blocks * overhead + (bits + 7 * padded) / 8;
+	if ((flags & FLAG_FRAMED) != 0) estimate.EncodedBytes += 8;
 
-	header |= h1 << 8;
-	header |= h2;
+	// A single block of a single stream is padded the same as a file without blocks
+	estimate.Exact = padded <= 1 && !ans;
 
-	reader.get(version);
-
-	bytesRead += 3;
+	return estimate;
+}
 
-	// Make sure we're decoding a file made by this program
-	if (reinterpret_cast<unsigned short&>(header) != 0x687a)
+// Makes sure the codes are ready to encode with: the dictionary's if there is one, otherwise the
+// ones built for the file format version
+void HuffmanEncoder::PrepareEncode(const unsigned long long weights[256])
+{
+	if (UseAns && FormatVersion == VERSION)
 	{
-		reader.close();
-		writer.close();
+		// The distribution takes the place of the codes, and is as cheap to rebuild as to check
+		if (Adaptive || HasDictionary) throw std::invalid_argument("tANS blocks are coded with the distribution of the weights and can't be adaptive or use a dictionary");
+		if (!HasWeights) throw std::runtime_error("tANS coding needs the weights of the input");
+
+		ans::Normalize(weights, ans::DEFAULT_TABLE_LOG, AnsDistribution);
+		AnsEncoder.Build(AnsDistribution);
 
-		throw std::invalid_argument("Not a huffman file");
+		verbose::write("tANS table log " + std::to_string(AnsDistribution.TableLog) + ", about " + std::to_string((ans::EncodedBits(weights, AnsDistribution) + 7) / 8) + " bytes of encoded data");
+		return;
 	}
 
-	// Make sure we know how to decode this specific version
-	if (version != VERSION)
+	if (HasDictionary)
 	{
-		reader.close();
-		writer.close();
+		// The dictionary's codes are used for every byte, so there's nothing left to build
+		if (FormatVersion == LEGACY_VERSION) throw std::invalid_argument("Version 2 files store the whole tree and can't use a dictionary");
+		if (MaxContextTables > 0 || Adaptive) throw std::invalid_argument("Context tables and adaptive blocks build their own codes and can't use a dictionary");
 
-		throw std::invalid_argument("Don't know how to decode file version " + static_cast<unsigned>(version));
+		UseDictionaryCodes();
+		return;
 	}
 
-	// We may have recycled an existing encoder. Get rid of its encoding tree
-	if (TreeRoot != nullptr)
+	// Adaptive blocks build their own codes, so they don't need any weights
+	if (Adaptive && FormatVersion == VERSION) return;
+
+	// Somehow, we have an encoder that wasn't properly initialized
+	if (!HasWeights && Tree.Empty() && CodesVersion == 0) throw std::runtime_error("Encoder not initialized");
+
+	// Make sure the codes match the version we're about to write
+	PrepareCodes(weights);
+}
+
+// Works out the flags of a version 3 file, and builds the context tables it needs from the <size> bytes at <data>
+//
+// Streams (<stream> is true) don't have the whole input up front, so they are always framed and can't use contexts
+unsigned char HuffmanEncoder::PrepareFlags(const unsigned char* data, size_t size, size_t blockSize, bool stream)
+{
+	// Adaptive blocks build their own codes and tANS blocks have a single distribution, so there is no use for context tables
+	auto contexts = MaxContextTables > 0 && !Adaptive && !UseAns && !stream;
+	if (MaxContextTables > 0 && Adaptive) verbose::write("Adaptive blocks have their own codes, ignoring the context tables");
+	else if (MaxContextTables > 0 && UseAns) verbose::write("tANS blocks have a single distribution, ignoring the context tables");
+	else if (MaxContextTables > 0 && stream) verbose::write("Context tables are built from the whole input, which a stream doesn't have, ignoring them");
+
+	// tANS reads each block backwards from its end, so it has no use for interleaved streams
+	auto streams = Interleaved && !UseAns;
+	if (Interleaved && UseAns) verbose::write("tANS blocks are a single stream, ignoring the interleaved streams");
+
+	// Interleaved streams, contexts, adaptive and tANS blocks are always written in blocks, so they can be decoded from memory
+	auto framed = Pipelined || stream;
+	auto blocks = BlockSize > 0 || streams || contexts || Adaptive || UseAns || framed;
+
+	ContextTables.clear();
+	if (contexts) BuildContextTables(data, size, blockSize);
+
+	unsigned char flags = 0;
+	if (blocks) flags |= FLAG_BLOCKS;
+	if (streams) flags |= FLAG_STREAMS;
+	if (contexts) flags |= FLAG_CONTEXT;
+	if (Adaptive) flags |= FLAG_ADAPTIVE;
+	if (HasDictionary) flags |= FLAG_DICTIONARY;
+	if (framed) flags |= FLAG_FRAMED;
+	if (UseAns) flags |= FLAG_ANS;
+	if (RunTransform && !stream) flags |= FLAG_RUNS;
+
+	return flags;
+}
+
+// Writes the header of a version 3 file, up to the encoded data
+//
+// Framed files put the size of the rest of the header in front of it, so a stream can read the whole
+// header before parsing it
+void HuffmanEncoder::WriteHeader(ByteSink& out, unsigned char flags, unsigned long long length, unsigned long long codedLength, size_t blockSize) const
+{
+	out.Put((HEADER >> 8) & 0xFF);
+	out.Put(HEADER & 0xFF);
+	out.Put(static_cast<unsigned char>(VERSION));
+	out.Put(flags);
+
+	if ((flags & FLAG_FRAMED) != 0)
 	{
-		verbose::write("WARNING: An encoding tree already exists and will be overwritten");
-		verbose::write("WARNING: This can be ignored if this encoder is only being used to decode a file");
-		verbose::write("WARNING: Construct a new encoder if you intend to encode another file");
-		delete TreeRoot;
-		IsDirty = true;
+		std::vector<unsigned char> header;
+		VectorSink sink(header);
+
+		WriteUInt64(sink, length);
+		if ((flags & FLAG_RUNS) != 0) WriteUInt64(sink, codedLength);
+		WriteCodes(sink, flags);
+		WriteUInt32(sink, static_cast<unsigned>(blockSize));
+
+		WriteUInt32(out, static_cast<unsigned>(header.size()));
+		out.Write(header.data(), header.size());
+		return;
 	}
 
-	// Read the decoding tree
-	try
+	// Write the original length, and the code lengths the decoder needs to rebuild the codes
+	WriteUInt64(out, length);
+	if ((flags & FLAG_RUNS) != 0) WriteUInt64(out, codedLength);
+	WriteCodes(out, flags);
+
+	if ((flags & FLAG_BLOCKS) != 0) WriteUInt32(out, static_cast<unsigned>(blockSize));
+}
+
+// Writes whatever the decoder needs to rebuild the codes of a version 3 file with the specified flags
+void HuffmanEncoder::WriteCodes(ByteSink& out, unsigned char flags) const
+{
+	if ((flags & FLAG_DICTIONARY) != 0)
 	{
-		TreeRoot = ReadEncodingTree(reader, bytesRead);
+		WriteUInt32(out, SharedDictionary.Id);
 	}
-	catch(std::invalid_argument e)
+	else if ((flags & FLAG_CONTEXT) != 0)
 	{
-		// Close the streams
-		reader.close();
-		writer.close();
+		WriteContextTables(out);
+	}
+	else if ((flags & FLAG_ANS) != 0)
+	{
+		std::vector<unsigned char> table;
+		ans::AppendDistribution(AnsDistribution, table);
+		out.Write(table.data(), table.size());
+	}
+	else if ((flags & FLAG_ADAPTIVE) == 0)
+	{
+		std::vector<unsigned char> table;
+		canonical::AppendLengths(CodeLengths, table);
+		out.Write(table.data(), table.size());
+	}
+}
+
+// Appends the pre-transformed <size> bytes at <data> to <out>, and counts their weights into <weights>
+//
+// The codes have to fit the bytes that are actually coded, which have fewer of the bytes that run and
+// the repeat counts on top. Encoders without weights use codes that don't depend on them, so their
+// <weights> are left alone
+void HuffmanEncoder::TransformRuns(const unsigned char* data, size_t size, std::vector<unsigned char>& out, unsigned long long weights[256]) const
+{
+	out.reserve(size);
+	runlength::Transform(data, size, out);
 
-		// And re-throw the exception
-		throw;
+	verbose::write("Run-length pre-transform: " + std::to_string(size) + " bytes to " + std::to_string(out.size()));
+
+	if (HasWeights)
+	{
+		std::fill(weights, weights + 256, 0);
+		histogram::Count(out.data(), out.size(), weights, Threads);
 	}
+}
 
-	auto currentNode = TreeRoot;
+// Encodes everything left in <in> as a stream of frames and writes the encoded file to <out>
+//
+// The length of the input isn't known until it has all been read, so the header records UNKNOWN_LENGTH
+// and the decoder stops at the empty frame at the end
+unsigned long long HuffmanEncoder::EncodeStream(std::istream& in, ByteSink& out)
+{
+	if (FormatVersion == LEGACY_VERSION) throw std::invalid_argument("Version 2 files can't be written as a stream");
 
-	// Decode the file one byte at a time
-	char byte;
-	while(reader.get(byte))
+	// Without weights or a dictionary, the only codes that can be built are each block's own. tANS has
+	// no such fallback, so it fails in PrepareEncode instead
+	if (!Adaptive && !UseAns && !HasDictionary && !HasWeights && Tree.Empty() && CodesVersion == 0)
 	{
-		// Read the next byte of the file
-		bytesRead++;
+		verbose::write("The encoder has no weights or dictionary, giving every block of the stream its own codes");
+		Adaptive = true;
+	}
 
-		// Parse the read byte as unsigned
-		auto ubyte = reinterpret_cast<unsigned char&>(byte);
+	PrepareEncode(Weights);
 
-		// Attempt to decode the read byte bit-by-bit
-		// At each bit, check to see if we're at a leaf node
-		// If we are, write the payload byte to the output file
-		// And reset the node pointer to the root of the tree
-		for (auto i = 7; i >= 0; i--)
-		{
-			WriteIfLeaf(writer, currentNode, bytesWritten);
-			try
-			{
-				DecodeBit(currentNode, ubyte, 1 << i);
-			}
-			catch(std::runtime_error e)
-			{
-				// Close the streams
-				reader.close();
-				writer.close();
+	auto blockSize = BlockSize > 0 ? BlockSize : DEFAULT_BLOCK_SIZE;
+	auto flags = PrepareFlags(nullptr, 0, blockSize, true);
 
-				// And re-throw the exception
-				throw;
-			}
-		}
-	}
+	if (RunTransform) verbose::write("The run-length pre-transform needs the whole input, which a stream doesn't have, ignoring it");
 
-	// Now that a read failed, we should be at the end of the file
-	if (!reader.eof()) throw std::invalid_argument("Falied to read file completely");
-	reader.close();
+	WriteHeader(out, flags, UNKNOWN_LENGTH, UNKNOWN_LENGTH, blockSize);
 
-	// Check if we're evenly alligned. If not, we won't be at a leaf node anyways
-	WriteIfLeaf(writer, currentNode, bytesWritten);
+	unsigned long long bytesRead = 0;
+	EncodeFrames(StreamReader(in, bytesRead), blockSize, out);
 
-	// Close the streams
-	writer.flush();
-	writer.close();
+	return bytesRead;
 }
 
-// Write the subtree from the specified node to the specified output stream
-void HuffmanEncoder::WriteEncodingTree(std::ostream& output, HuffmanTreeNode* node, size_t& bytesWritten)
+// Encodes the <size> bytes at <data> and appends the encoded file to <out>
+void HuffmanEncoder::Encode(const unsigned char* data, size_t size, std::vector<unsigned char>& out)
 {
-	if (node == nullptr) return;
+	VectorSink sink(out);
+	Encode(data, size, sink);
+}
 
-	// Assume we're at a leaf node
-	unsigned char nodeType = FLAG_LEAF_NODE;
+// Encodes the <size> bytes at <data> into the <capacity> bytes at <out>
+//
+// Returns: The size of the encoded file
+// Throws: std::length_error if it doesn't fit
+size_t HuffmanEncoder::Encode(const unsigned char* data, size_t size, unsigned char* out, size_t capacity)
+{
+	BufferSink sink(out, capacity);
+	Encode(data, size, sink);
 
-	// If we are, write it to the stream
-	if(node->IsLeaf())
-	{
-		output.put(nodeType);
-		output.put(node->payload);
+	return sink.BytesWritten();
+}
 
-		bytesWritten += 2;
-		return;
-	}
+// Encodes the file at <input> with the pre-generated encoding table and writes to <output>
+void HuffmanEncoder::EncodeFile(std::string input, std::string output, size_t& bytesRead, size_t& bytesWritten)
+{
+	// Reuse the mapping from InitializeFromFile if this is the same file, otherwise map the input now
+	auto source = Source != nullptr && Source->Path() == input ? Source : std::make_shared<MappedFile>(input);
 
-	// Otherwise, set the node type bitmask correctly
-	if(node->Left != nullptr) nodeType |= FLAG_LEFT_CHILD;
-	if (node->Right != nullptr) nodeType |= FLAG_RIGHT_CHILD;
+	std::ofstream writer;
+	writer.open(output, std::ios::binary);
+	if (!writer.is_open() || !writer.good()) throw std::runtime_error("Cannot open file for write");
 
-	// Write the node type
-	output.put(nodeType);
-	bytesWritten++;
+	StreamSink sink(writer);
+	EncodeSource(*source, sink, bytesRead);
 
-	// And then write the left and right subtrees
-	WriteEncodingTree(output, node->Left, bytesWritten);
-	WriteEncodingTree(output, node->Right, bytesWritten);
+	writer.flush();
+	writer.close();
+
+	bytesWritten += sink.BytesWritten();
 }
 
-// Builds the internal encoding tree from an array of nodes
-void HuffmanEncoder::BuildTreeFromNodes(HuffmanTreeNode* nodes[256])
+// Encodes the file at <input> with the pre-generated encoding table and writes the encoded file to <out>
+void HuffmanEncoder::EncodeFile(std::string input, ByteSink& out, size_t& bytesRead)
 {
-	verbose::write("Building Encoding Tree...");
-
-	int firstSmallest = -1;
-	int secondSmallest = -1;
-
-	// Pair nodes until we have a single root node forming the tree
-	do
-	{
-		for (int i = 0; i < 256; i++)
-		{
-			// Skip nodes that were not used or have already been joined
-			if (nodes[i] == nullptr) continue;
-
-			// Pick the first non null node to be the "smallest"
-			if (firstSmallest == -1)
-			{
-				firstSmallest = i;
-				continue;
-			}
+	auto source = Source != nullptr && Source->Path() == input ? Source : std::make_shared<MappedFile>(input);
 
-			// Pick the next non null node to be the "smallest"
-			if (secondSmallest == -1)
-			{
-				secondSmallest = i;
-				continue;
-			}
+	EncodeSource(*source, out, bytesRead);
+}
 
-			if (nodes[secondSmallest]->weight < nodes[firstSmallest]->weight)
-			{
-				// Make sure the first smallest is always <= to the second smallest
-				std::swap(firstSmallest, secondSmallest);
-			}
+// Encodes the mapped (or otherwise readable) file and writes the encoded file to <out>
+//
+// The mapping is handed to Encode. Files that can't be mapped are encoded as they are read when the
+// codes don't depend on the whole input, and read into memory first otherwise
+void HuffmanEncoder::EncodeSource(const MappedFile& source, ByteSink& out, size_t& bytesRead)
+{
+	verbose::write("Starting encode of " + source.Path() + (source.IsMapped() ? " (memory mapped)" : ""));
 
-			if (nodes[i]->weight < nodes[firstSmallest]->weight)
-			{
-				// The first smallest is at least as small as the second smallest
-				// So save firstSmallest in secondSmallest
-				secondSmallest = firstSmallest;
-				// Then remember the location of the next smallest
-				firstSmallest = i;
-			}
-			else if (nodes[i]->weight < nodes[secondSmallest]->weight)
-			{
-				secondSmallest = i;
-			}
-		}
+	if (source.IsMapped())
+	{
+		Encode(source.Data(), source.Size(), out);
+		bytesRead += source.Size();
+		return;
+	}
 
-		// If we still have two nodes to merge, pair them
-		if (firstSmallest != -1 && secondSmallest != -1)
-		{
-			// Construct a new internal node whose weight is the sum of its left and right sub-trees
-			auto temp = new HuffmanTreeNode(0, nodes[firstSmallest]->weight + nodes[secondSmallest]->weight);
-			temp->Left = nodes[firstSmallest];
-			temp->Right = nodes[secondSmallest];
+	std::ifstream reader;
+	reader.open(source.Path(), std::ios::binary);
+	if (!reader.is_open() || !reader.good()) throw std::runtime_error("Cannot open file for read");
 
-			verbose::write("\tMerging nodes at " + std::to_string(firstSmallest) + " and " + std::to_string(secondSmallest) + " into " + std::to_string(firstSmallest));
+	if (Pipelined && FormatVersion == VERSION && (Adaptive || HasDictionary) && !RunTransform)
+	{
+		bytesRead += static_cast<size_t>(EncodeStream(reader, out));
+		return;
+	}
 
-			nodes[firstSmallest] = temp;
-			nodes[secondSmallest] = nullptr;
-			
-			firstSmallest = secondSmallest = -1;
-		}
-		else
-		{
-			break;
-		}
-	} while (true);
+	std::vector<unsigned char> contents;
+	ReadStream(reader, contents);
 
-	// First Smallest should now be the index of the root of the huffman tree
-	TreeRoot = nodes[firstSmallest];
-	nodes[firstSmallest] = nullptr;
+	Encode(contents.data(), contents.size(), out);
+	bytesRead += contents.size();
 }
 
-// Populates the encoding table from the subtree at the specified node
-void HuffmanEncoder::BuildEncodingTable(std::string bitstring, HuffmanTreeNode* node)
+// Appends the canonical code for a byte from the specified code table to the bit writer
+inline void HuffmanEncoder::PutCanonical(BitWriter& bits, const unsigned long long codes[256], const unsigned char lengths[256], unsigned char ubyte)
 {
-	if (node == nullptr) return;
+	auto codeLength = lengths[ubyte];
 
-	if (node->IsLeaf())
+	if (codeLength <= BitWriter::MAX_PUT_BITS)
 	{
-		// We found a leaf node, record the bitstring that got us here
-		EncodingTable[node->payload] = bitstring;
+		// A code length of zero means the byte wasn't in the data the codes were built for
+		if (codeLength == 0) throw std::runtime_error("Byte " + std::to_string(ubyte) + " does not have a code");
 
-		// Remember the largest bitstring for easy padding of non-aligned bytes when encoding
-		if(bitstring.length() >= 8 && bitstring.length() > PaddingHint.length())
-		{
-			PaddingHint = bitstring;
-			verbose::write("\tElecting new padding hint " + bitstring);
-		}
+		bits.Put(codes[ubyte], codeLength);
 	}
 	else
 	{
-		// Go find another leaf, 0 for left
-		BuildEncodingTable(bitstring + "0", node->Left);
-		// and 1 for right
-		BuildEncodingTable(bitstring + "1", node->Right);
+		bits.Put(codes[ubyte] >> BitWriter::MAX_PUT_BITS, codeLength - BitWriter::MAX_PUT_BITS);
+		bits.Put(codes[ubyte] & 0xFFFFFFFF, BitWriter::MAX_PUT_BITS);
 	}
 }
 
-// Converts the specified 8-character string to a byte
-// 
-// The input string MUST be 8 characters, and can only consist of '0' and '1'
-unsigned char HuffmanEncoder::BitfieldToByte(std::string byte)
+// Appends the code for a single byte to the specified bit writer
+inline void HuffmanEncoder::PutCode(BitWriter& bits, unsigned char ubyte) const
 {
-	if (byte.length() != 8) throw std::invalid_argument("Bitfield length not 8 bits");
+	// Only the codes of a version 2 tree can be too long for an integer
+	if (CodeLengths[ubyte] <= 2 * BitWriter::MAX_PUT_BITS) PutCanonical(bits, Codes, CodeLengths, ubyte);
+	else WriteBitstring(bits, EncodingTable[ubyte]);
+}
 
-	unsigned char result = 0;
+// Appends the codes for <size> bytes at <data> to the specified bit writer
+void HuffmanEncoder::EncodeBytes(const unsigned char* data, size_t size, BitWriter& bits) const
+{
+	for (size_t i = 0; i < size; i++) PutCode(bits, data[i]);
+}
 
-	result |= (byte[0] == '1') << 7;
-	result |= (byte[1] == '1') << 6;
-	result |= (byte[2] == '1') << 5;
-	result |= (byte[3] == '1') << 4;
-	result |= (byte[4] == '1') << 3;
-	result |= (byte[5] == '1') << 2;
-	result |= (byte[6] == '1') << 1;
-	result |= (byte[7] == '1') << 0;
+// Appends the codes of <size> bytes to <out>, where coder(bits, i) writes the code of byte i
+//
+// The codes are padded to a whole byte. If interleaved streams are enabled, the bytes are dealt
+// into their streams, and the streams are written one after the other behind their sizes
+template <typename Coder>
+void HuffmanEncoder::EncodeStreams(size_t size, Coder coder, std::vector<unsigned char>& out) const
+{
+	if (!Interleaved)
+	{
+		BitWriter bits(out);
+		for (size_t i = 0; i < size; i++) coder(bits, i);
+
+		// Every block starts on a byte boundary, and the decoder knows how many bytes are in it
+		if (bits.PendingBits() > 0) bits.Put(0, 8 - bits.PendingBits());
+		bits.Finish();
+		return;
+	}
+
+	const auto STREAMS = HuffmanDecodeTable::STREAM_COUNT;
+
+	std::vector<unsigned char> streams[STREAMS];
+	{
+		BitWriter bits[STREAMS] = { BitWriter(streams[0]), BitWriter(streams[1]), BitWriter(streams[2]), BitWriter(streams[3]) };
+
+		// Deal whole rounds of bytes first so the stream doesn't have to be picked for every byte
+		size_t i = 0;
+		for (; i + STREAMS <= size; i += STREAMS)
+		{
+			coder(bits[0], i);
+			coder(bits[1], i + 1);
+			coder(bits[2], i + 2);
+			coder(bits[3], i + 3);
+		}
+
+		for (; i < size; i++) coder(bits[i % STREAMS], i);
+
+		for (auto& stream : bits)
+		{
+			if (stream.PendingBits() > 0) stream.Put(0, 8 - stream.PendingBits());
+			stream.Finish();
+		}
+	}
+
+	// The sizes of every stream but the last, which is whatever is left of the block
+	for (unsigned s = 0; s < STREAMS - 1; s++)
+	{
+		auto streamSize = static_cast<unsigned>(streams[s].size());
+		for (auto shift = 24; shift >= 0; shift -= 8) out.push_back(static_cast<unsigned char>(streamSize >> shift));
+	}
+
+	for (auto& stream : streams) out.insert(out.end(), stream.begin(), stream.end());
+}
+
+// Encodes <size> bytes at <data> as a single block, replacing the contents of <out>
+void HuffmanEncoder::EncodeBlock(const unsigned char* data, size_t size, std::vector<unsigned char>& out) const
+{
+	out.clear();
+
+	if (UseAns)
+	{
+		AnsEncoder.Encode(data, size, out);
+	}
+	else if (Adaptive)
+	{
+		EncodeAdaptiveBlock(data, size, out);
+	}
+	else if (!ContextTables.empty())
+	{
+		// Each byte is coded with the table of the byte before it
+		EncodeStreams(size, [&](BitWriter& bits, size_t i)
+		{
+			auto previous = i == 0 ? context::INITIAL_CONTEXT : data[i - 1];
+			auto& table = ContextTables[ContextMap[previous]];
+
+			PutCanonical(bits, table.Codes, table.Lengths, data[i]);
+		}, out);
+	}
+	else
+	{
+		EncodeStreams(size, [&](BitWriter& bits, size_t i) { PutCode(bits, data[i]); }, out);
+	}
+}
+
+// Encodes <size> bytes at <data> as a block with its own code, or stores it raw or run-length coded
+//
+// The size of each option is known exactly from the block's histogram and run count before anything
+// is encoded, so incompressible blocks are copied without spending any time on codes. Ties go to the
+// option that is cheapest to decode
+void HuffmanEncoder::EncodeAdaptiveBlock(const unsigned char* data, size_t size, std::vector<unsigned char>& out) const
+{
+	unsigned long long weights[256] = { 0 };
+	histogram::Count(data, size, weights);
+
+	unsigned char lengths[256];
+	BuildLengths(weights, lengths);
+
+	// Blocks are never big enough for a code that's too long, but storing the block is always an option
+	auto coded = *std::max_element(lengths, lengths + 256) <= canonical::MAX_CODE_LENGTH;
+
+	auto raw = 1 + static_cast<unsigned long long>(size);
+	auto runs = 1 + static_cast<unsigned long long>(runlength::EncodedSize(data, size));
+	auto huffman = 1 + canonical::LengthsSize(lengths) + (canonical::EncodedBits(weights, lengths) + 7) / 8;
+
+	// Interleaved streams cost their sizes and up to a byte of padding each
+	if (Interleaved) huffman += 4 * (HuffmanDecodeTable::STREAM_COUNT - 1) + HuffmanDecodeTable::STREAM_COUNT - 1;
+
+	if (coded && huffman < raw && huffman < runs)
+	{
+		unsigned long long codes[256];
+		canonical::AssignCodes(lengths, codes);
+
+		out.push_back(static_cast<unsigned char>(BLOCK_HUFFMAN));
+		canonical::AppendLengths(lengths, out);
+
+		EncodeStreams(size, [&](BitWriter& bits, size_t i) { PutCanonical(bits, codes, lengths, data[i]); }, out);
+	}
+	else if (runs < raw)
+	{
+		out.push_back(static_cast<unsigned char>(BLOCK_RUNS));
+		runlength::Encode(data, size, out);
+	}
+	else
+	{
+		out.push_back(static_cast<unsigned char>(BLOCK_RAW));
+		out.insert(out.end(), data, data + size);
+	}
+}
+
+// Encodes the <size> bytes at <data> as independent blocks of <blockSize> bytes
+//
+// The input is taken a batch of blocks at a time. Every block in a batch is encoded on its own
+// thread into its own buffer, then the buffers are written out in order. Once the whole input is
+// encoded, the index of block end offsets is written
+void HuffmanEncoder::EncodeBlocks(const unsigned char* data, size_t size, size_t blockSize, ByteSink& out) const
+{
+	auto threads = parallel::ThreadCount(Threads);
+	verbose::write("Encoding blocks of " + std::to_string(blockSize) + " bytes on " + std::to_string(threads) + " threads");
+
+	// Give every thread a couple of blocks per batch so they don't wait on each other too often
+	auto batchBlocks = static_cast<size_t>(threads) * 2;
+
+	std::vector<std::vector<unsigned char>> encoded(batchBlocks);
+	std::vector<unsigned long long> index;
+	unsigned long long offset = 0;
+
+	// The number of adaptive blocks of each kind
+	size_t kinds[3] = { 0 };
+
+	for (size_t consumed = 0; consumed < size;)
+	{
+		auto input = data + consumed;
+		auto count = std::min(batchBlocks * blockSize, size - consumed);
+		consumed += count;
+
+		auto blocks = (count + blockSize - 1) / blockSize;
+
+		parallel::For(blocks, threads, [&](size_t b)
+		{
+			auto start = b * blockSize;
+			auto length = std::min(blockSize, count - start);
+
+			EncodeBlock(input + start, length, encoded[b]);
+		});
+
+		for (size_t b = 0; b < blocks; b++)
+		{
+			out.Write(encoded[b].data(), encoded[b].size());
+
+			if (Adaptive) kinds[encoded[b][0]]++;
+
+			offset += encoded[b].size();
+			index.push_back(offset);
+		}
+	}
+
+	if (Adaptive)
+	{
+		verbose::write("Adaptive blocks: " + std::to_string(kinds[BLOCK_HUFFMAN]) + " Huffman, " + std::to_string(kinds[BLOCK_RAW]) + " raw, " + std::to_string(kinds[BLOCK_RUNS]) + " run-length coded");
+	}
+
+	// The decoder finds the index from the end of the file, since it knows how many blocks there are
+	for (auto end : index) WriteUInt64(out, end);
+}
+
+// Encodes the input from <read> as frames of up to <blockSize> bytes and writes them to <out>
+//
+// Blocks are read, coded and written by a pipeline (see pipeline::Run), so all three overlap and only
+// a few blocks are in memory at once. Each frame is its encoded size and block size, 4 bytes each,
+// followed by the encoded block. An empty frame marks the end
+//
+// Returns: The number of bytes that were encoded
+unsigned long long HuffmanEncoder::EncodeFrames(const Reader& read, size_t blockSize, ByteSink& out) const
+{
+	auto threads = parallel::ThreadCount(Threads);
+	verbose::write("Encoding frames of " + std::to_string(blockSize) + " bytes on " + std::to_string(threads) + " coder threads");
+
+	unsigned long long length = 0;
+
+	// The number of adaptive blocks of each kind
+	size_t kinds[3] = { 0 };
+
+	pipeline::Run<std::vector<unsigned char>, Frame>(threads,
+		[&](std::vector<unsigned char>& block)
+		{
+			block.resize(blockSize);
+			block.resize(ReadFully(read, block.data(), blockSize));
+
+			return !block.empty();
+		},
+		[&](std::vector<unsigned char>& block, Frame& frame)
+		{
+			EncodeBlock(block.data(), block.size(), frame.Data);
+			frame.Size = block.size();
+
+			if (frame.Data.size() > UINT_MAX) throw std::runtime_error("An encoded block is too big for a frame, use a smaller block size");
+		},
+		[&](Frame& frame)
+		{
+			WriteUInt32(out, static_cast<unsigned>(frame.Data.size()));
+			WriteUInt32(out, static_cast<unsigned>(frame.Size));
+			out.Write(frame.Data.data(), frame.Data.size());
+
+			if (Adaptive) kinds[frame.Data[0]]++;
+			length += frame.Size;
+		});
+
+	WriteUInt32(out, 0);
+	WriteUInt32(out, 0);
+
+	if (Adaptive)
+	{
+		verbose::write("Adaptive blocks: " + std::to_string(kinds[BLOCK_HUFFMAN]) + " Huffman, " + std::to_string(kinds[BLOCK_RAW]) + " raw, " + std::to_string(kinds[BLOCK_RUNS]) + " run-length coded");
+	}
+
+	return length;
+}
+
+// Writes a bitstring of any length to the specified bit writer
+//
+// This is only used for codes too long to be written with a single call to BitWriter::Put,
+// which only happens for bytes that are very rare (or absent) in the file
+void HuffmanEncoder::WriteBitstring(BitWriter& bits, const std::string& bitstring)
+{
+	for (size_t start = 0; start < bitstring.length(); start += BitWriter::MAX_PUT_BITS)
+	{
+		auto end = std::min(start + BitWriter::MAX_PUT_BITS, bitstring.length());
+
+		unsigned long long value = 0;
+		for (auto i = start; i < end; i++) value = (value << 1) | (bitstring[i] == '1');
+
+		bits.Put(value, static_cast<unsigned>(end - start));
+	}
+}
+
+// Read the subtree starting at <position> in the <size> bytes at <data> into <tree>, and return its index
+//
+// A well-formed tree never has more than HuffmanTree::MAX_NODES nodes, so a corrupt one that does
+// is rejected by the tree before it can recurse any deeper
+unsigned short HuffmanEncoder::ReadEncodingTree(const unsigned char* data, size_t size, size_t& position, HuffmanTree& tree)
+{
+	// Read the node type
+	auto nodeType = ReadByte(data, size, position);
+
+	// If this is a leaf node, read its payload 
+	if (nodeType == FLAG_LEAF_NODE)
+	{
+		return tree.Add(ReadByte(data, size, position));
+	}
+	
+	// If this isn't a type of node we recognized, then either the file format is corrupt
+	// Or it wasn't encoded with this version of the software
+	if (nodeType > FLAG_BOTH_NODES) throw std::invalid_argument("Unrecognized node type: " + std::to_string(static_cast<unsigned>(nodeType)));
+	
+	// Otherwise, read the left and right sub trees if their bitmask is set
+	auto result = tree.Add(0);
+	if ((nodeType & FLAG_LEFT_CHILD) == FLAG_LEFT_CHILD)
+	{
+		auto left = ReadEncodingTree(data, size, position, tree);
+		tree.Nodes[result].Left = left;
+	}
+	if ((nodeType & FLAG_RIGHT_CHILD) == FLAG_RIGHT_CHILD)
+	{
+		auto right = ReadEncodingTree(data, size, position, tree);
+		tree.Nodes[result].Right = right;
+	}
 
 	return result;
 }
+
+// Decodes the bit from ubyte masked by the specified mask, moving the specified node index along the tree
+// If the bit is set, we're supposed to "take" the right branch, so we should expect a node to the right
+// If the bit is not set, we're supposed to "take" the left branch, so we should expect a node to the left
+//
+// If for some reason we can't take the path indicated by the bit, the file is corrupt
+// Since the currentNode index would have been reset by the call to WriteIfLeaf immediately before this method
+void HuffmanEncoder::DecodeBit(unsigned short& currentNode, unsigned char ubyte, unsigned char mask) const
+{
+	auto& node = Tree[currentNode];
+
+	if((ubyte & mask) == mask)
+	{
+		if(node.Right != HuffmanTree::NO_NODE) currentNode = node.Right;
+		else throw std::runtime_error("Input file is corrupt (expected right treepath does not exist)");
+	}
+	else
+	{
+		if (node.Left != HuffmanTree::NO_NODE) currentNode = node.Left;
+		else throw std::runtime_error("Input file is corrupt (expected left treepath does not exist)");
+	}
+}
+
+// Checks the specified node, and if it is a leaf, writes its payload to the specified sink
+void HuffmanEncoder::WriteIfLeaf(ByteSink& out, unsigned short& currentNode) const
+{
+	if(Tree[currentNode].IsLeaf())
+	{
+		// We're at a leaf. Write a new byte
+		out.Put(Tree[currentNode].Payload);
+
+		// Reset the currentNode index to the root of the tree
+		currentNode = Tree.Root;
+	}
+}
+
+// If set to true, files are decoded by walking the encoding tree one bit at a time
+// instead of with the decoding table
+void HuffmanEncoder::SetReferenceDecoding(bool enable)
+{
+	ReferenceDecoding = enable;
+}
+
+// Decodes the encoded file in the <size> bytes at <data> and writes the original bytes to <out>
+//
+// See Encode(...) for documentation on the file format
+void HuffmanEncoder::Decode(const unsigned char* data, size_t size, ByteSink& out)
+{
+	DecodeRange(data, size, 0, UNKNOWN_LENGTH, out);
+}
+
+// Decodes the <length> bytes of the original input starting at <offset> from the encoded file in the
+// <size> bytes at <data>, and writes them to <out>
+//
+// Blocks and frames outside the range are skipped without being decoded, and a single stream is
+// only decoded up to the end of the range. Pre-transformed files are always decoded whole
+void HuffmanEncoder::DecodeRange(const unsigned char* data, size_t size, unsigned long long offset, unsigned long long length, ByteSink& out)
+{
+	// The end of the range, which can't be past the largest offset
+	auto last = length > UNKNOWN_LENGTH - offset ? UNKNOWN_LENGTH : offset + length;
+
+	// Make sure we're decoding a file made by this program
+	if (size < 3 || ((data[0] << 8) | data[1]) != HEADER) throw std::invalid_argument("Not a huffman file");
+
+	// Make sure we know how to decode this specific version
+	auto version = data[2];
+	if (version != VERSION && version != LEGACY_VERSION)
+	{
+		throw std::invalid_argument("Don't know how to decode file version " + std::to_string(static_cast<unsigned>(version)));
+	}
+
+	size_t position = 3;
+
+	ResetCodes();
+
+	if (version == LEGACY_VERSION)
+	{
+		// Read the decoding tree
+		Tree.Root = ReadEncodingTree(data, size, position, Tree);
+
+		// Version 2 files don't record their length, so they are decoded to the end and anything
+		// outside the range is dropped
+		RangeSink range(out, offset, length);
+
+		// Decode the rest of the file with the decoding table, unless we were asked to use the reference decoder
+		if (ReferenceDecoding)
+		{
+			DecodeWithTree(data + position, size - position, range);
+		}
+		else
+		{
+			DecodeTable.Build(Tree);
+			DecodeWithTable(DecodeTable, data + position, size - position, range, ULLONG_MAX);
+		}
+
+		return;
+	}
+
+	auto flags = ReadByte(data, size, position);
+	CheckFlags(flags);
+
+	if (ReferenceDecoding) verbose::write("The reference decoder needs an encoding tree, using the decoding table instead");
+
+	// Runs can only be expanded from the start of the file, so a pre-transformed file is decoded whole and
+	// the range is cut from the expanded bytes
+	auto runs = (flags & FLAG_RUNS) != 0;
+	RangeSink expandedRange(out, offset, length);
+	runlength::ExpandingSink expanded(expandedRange);
+	auto& target = runs ? static_cast<ByteSink&>(expanded) : out;
+
+	if (runs)
+	{
+		offset = 0;
+		length = UNKNOWN_LENGTH;
+		last = UNKNOWN_LENGTH;
+	}
+
+	unsigned long long fileLength;
+	unsigned long long codedLength;
+
+	if ((flags & FLAG_FRAMED) != 0)
+	{
+		auto headerSize = ReadUInt32(data, size, position);
+		if (headerSize > size - position) throw std::invalid_argument("Unexpected end of input");
+
+		size_t blockSize;
+		auto table = ReadFramedHeader(data + position, headerSize, flags, fileLength, codedLength, blockSize);
+		position += headerSize;
+
+		DecodeFrames(*table, MemoryReader(data + position, size - position), codedLength, flags, blockSize, offset, last, target);
+	}
+	else
+	{
+		// Read the length of the original file (and of the bytes that were coded) and the codes
+		fileLength = ReadUInt64(data, size, position);
+		codedLength = runs ? ReadUInt64(data, size, position) : fileLength;
+		auto table = ReadCodes(data, size, position, flags);
+
+		if ((flags & FLAG_BLOCKS) != 0)
+		{
+			DecodeBlocks(*table, data + position, size - position, codedLength, flags, offset, last, target);
+		}
+		else
+		{
+			// A single stream can only be decoded from the start, but there is no need to go past the range
+			RangeSink range(target, offset, length);
+			DecodeWithTable(*table, data + position, size - position, range, std::min(codedLength, last));
+		}
+	}
+
+	if (runs) CheckExpanded(expanded, fileLength);
+}
+
+// Throws: std::runtime_error if the runs written to <expanded> didn't expand to exactly <length> bytes
+void HuffmanEncoder::CheckExpanded(const runlength::ExpandingSink& expanded, unsigned long long length)
+{
+	if (!expanded.IsComplete() || (length != UNKNOWN_LENGTH && expanded.BytesExpanded() != length))
+	{
+		throw std::runtime_error("Input file is corrupt (the runs don't expand to the length of the original file)");
+	}
+}
+
+// Forgets the codes and tree of the encoder, before they are replaced by the ones in a file
+void HuffmanEncoder::ResetCodes()
+{
+	// We may have recycled an existing encoder. Get rid of its encoding tree
+	if (!Tree.Empty() || CodesVersion != 0)
+	{
+		verbose::write("WARNING: An encoding tree already exists and will be overwritten");
+		verbose::write("WARNING: This can be ignored if this encoder is only being used to decode a file");
+		verbose::write("WARNING: Construct a new encoder if you intend to encode another file");
+		Tree.Clear();
+		IsDirty = true;
+	}
+
+	// The codes in the file replace the ones built from the weights
+	HasWeights = false;
+	CodesVersion = 0;
+}
+
+// Throws: std::invalid_argument if the flags of a version 3 file are unknown or don't make sense together
+//
+// Streams, contexts, adaptive blocks, frames and tANS are only written in blocks, only one of contexts,
+// adaptive blocks, a dictionary and tANS can provide the codes, and tANS blocks are never split into streams
+void HuffmanEncoder::CheckFlags(unsigned char flags)
+{
+	auto known = FLAG_BLOCKS | FLAG_STREAMS | FLAG_CONTEXT | FLAG_ADAPTIVE | FLAG_DICTIONARY | FLAG_FRAMED | FLAG_ANS | FLAG_RUNS;
+	auto needBlocks = FLAG_STREAMS | FLAG_CONTEXT | FLAG_ADAPTIVE | FLAG_FRAMED | FLAG_ANS;
+	auto codeSources = (flags & FLAG_CONTEXT) != 0 ? 1 : 0;
+	if ((flags & FLAG_ADAPTIVE) != 0) codeSources++;
+	if ((flags & FLAG_DICTIONARY) != 0) codeSources++;
+	if ((flags & FLAG_ANS) != 0) codeSources++;
+
+	auto ansStreams = (flags & FLAG_ANS) != 0 && (flags & FLAG_STREAMS) != 0;
+	auto invalid = (flags & ~known) != 0 || ((flags & needBlocks) != 0 && (flags & FLAG_BLOCKS) == 0) || codeSources > 1 || ansStreams;
+	if (invalid) throw std::invalid_argument("Unsupported flags: " + std::to_string(flags));
+}
+
+// Reads the codes of a version 3 file with the specified flags starting at <position>, and returns the
+// table to decode it with
+//
+// Files with a dictionary are decoded with its table, which was built when it was given
+const HuffmanDecodeTable* HuffmanEncoder::ReadCodes(const unsigned char* data, size_t size, size_t& position, unsigned char flags)
+{
+	if ((flags & FLAG_ADAPTIVE) != 0)
+	{
+		// Every block has its own codes, so there is nothing to read here
+		return &DecodeTable;
+	}
+
+	if ((flags & FLAG_DICTIONARY) != 0)
+	{
+		auto id = ReadUInt32(data, size, position);
+
+		if (!HasDictionary) throw std::invalid_argument("The file was encoded with dictionary " + dictionary::FormatId(id) + ", which was not given");
+		if (id != SharedDictionary.Id)
+		{
+			throw std::invalid_argument("The file was encoded with dictionary " + dictionary::FormatId(id) + ", not " + dictionary::FormatId(SharedDictionary.Id));
+		}
+
+		UseDictionaryCodes();
+		return &DictionaryTable;
+	}
+
+	if ((flags & FLAG_ANS) != 0)
+	{
+		// Blocks are decoded with the tANS table, so the Huffman table is never used
+		position += ans::ParseDistribution(data + position, size - position, AnsDistribution);
+		AnsDecoder.Build(AnsDistribution);
+		return &DecodeTable;
+	}
+
+	if ((flags & FLAG_CONTEXT) != 0)
+	{
+		// The context tables can't be used to encode another file with a single table
+		ReadContextTables(data, size, position);
+		return &DecodeTable;
+	}
+
+	// Rebuild the canonical codes from the code lengths. The encoder keeps them, so the
+	// same codes are used if it is asked to encode a version 3 file afterwards
+	position += canonical::ParseLengths(data + position, size - position, CodeLengths);
+	canonical::AssignCodes(CodeLengths, Codes);
+	CodesVersion = VERSION;
+	IsDirty = false;
+
+	DecodeTable.Build(Codes, CodeLengths);
+	return &DecodeTable;
+}
+
+// Reads the header of a framed file, which is the <size> bytes at <data>, and returns the table to decode it with
+//
+// Anything in the header after the block size is skipped, so later versions can add to it
+const HuffmanDecodeTable* HuffmanEncoder::ReadFramedHeader(const unsigned char* data, size_t size, unsigned char flags, unsigned long long& length, unsigned long long& codedLength, size_t& blockSize)
+{
+	size_t position = 0;
+
+	length = ReadUInt64(data, size, position);
+	codedLength = (flags & FLAG_RUNS) != 0 ? ReadUInt64(data, size, position) : length;
+	auto table = ReadCodes(data, size, position, flags);
+
+	blockSize = ReadUInt32(data, size, position);
+	if (blockSize == 0 || blockSize > MAX_BLOCK_SIZE) throw std::invalid_argument("Invalid block size: " + std::to_string(blockSize));
+
+	return table;
+}
+
+// Decodes the encoded file in <in> and writes the original bytes to <out>
+//
+// Returns: The number of bytes read from <in>
+unsigned long long HuffmanEncoder::DecodeStream(std::istream& in, ByteSink& out)
+{
+	unsigned long long bytesRead = 0;
+	auto read = StreamReader(in, bytesRead);
+
+	// The header, version and flags tell whether the file is framed
+	unsigned char start[4];
+	auto got = ReadFully(read, start, sizeof(start));
+	auto framed = got == sizeof(start) && ((start[0] << 8) | start[1]) == HEADER && start[2] == VERSION && (start[3] & FLAG_FRAMED) != 0;
+
+	if (!framed)
+	{
+		std::vector<unsigned char> contents(start, start + got);
+		ReadStream(in, contents);
+
+		Decode(contents.data(), contents.size(), out);
+		return contents.size();
+	}
+
+	auto flags = start[3];
+	CheckFlags(flags);
+	ResetCodes();
+
+	unsigned char sizeBytes[4];
+	if (ReadFully(read, sizeBytes, sizeof(sizeBytes)) != sizeof(sizeBytes)) throw std::invalid_argument("Unexpected end of input");
+
+	size_t position = 0;
+	std::vector<unsigned char> header(ReadUInt32(sizeBytes, sizeof(sizeBytes), position));
+	if (ReadFully(read, header.data(), header.size()) != header.size()) throw std::invalid_argument("Unexpected end of input");
+
+	unsigned long long length;
+	unsigned long long codedLength;
+	size_t blockSize;
+	auto table = ReadFramedHeader(header.data(), header.size(), flags, length, codedLength, blockSize);
+
+	if ((flags & FLAG_RUNS) != 0)
+	{
+		runlength::ExpandingSink expanded(out);
+		DecodeFrames(*table, read, codedLength, flags, blockSize, 0, UNKNOWN_LENGTH, expanded);
+		CheckExpanded(expanded, length);
+
+		return bytesRead;
+	}
+
+	DecodeFrames(*table, read, length, flags, blockSize, 0, UNKNOWN_LENGTH, out);
+	return bytesRead;
+}
+
+// Decodes the encoded file in the <size> bytes at <data> and appends the original bytes to <out>
+void HuffmanEncoder::Decode(const unsigned char* data, size_t size, std::vector<unsigned char>& out)
+{
+	// Version 3 files know how big they are, so the output only needs to grow once
+	auto length = DecodedSize(data, size);
+	if (length != UNKNOWN_LENGTH && length <= out.max_size() - out.size()) out.reserve(out.size() + static_cast<size_t>(length));
+
+	VectorSink sink(out);
+	Decode(data, size, sink);
+}
+
+// Decodes the encoded file in the <size> bytes at <data> into the <capacity> bytes at <out>
+//
+// Returns: The size of the original file
+// Throws: std::length_error if it doesn't fit
+size_t HuffmanEncoder::Decode(const unsigned char* data, size_t size, unsigned char* out, size_t capacity)
+{
+	BufferSink sink(out, capacity);
+	Decode(data, size, sink);
+
+	return sink.BytesWritten();
+}
+
+// Returns: The size of the original file the encoded file in the <size> bytes at <data> decodes to,
+// or ULLONG_MAX if it isn't recorded, which is the case for version 2 files
+unsigned long long HuffmanEncoder::DecodedSize(const unsigned char* data, size_t size)
+{
+	if (size < 3 || ((data[0] << 8) | data[1]) != HEADER) throw std::invalid_argument("Not a huffman file");
+	if (data[2] != VERSION) return UNKNOWN_LENGTH;
+
+	// The length comes right after the flags, or after the size of the header in framed files
+	size_t position = 3;
+	auto flags = ReadByte(data, size, position);
+	if ((flags & FLAG_FRAMED) != 0) position += 4;
+
+	return ReadUInt64(data, size, position);
+}
+
+// Decodes the input file to the specified output file
+void HuffmanEncoder::DecodeFile(std::string input, std::string output, size_t& bytesRead, size_t& bytesWritten)
+{
+	MappedFile source(input);
+
+	std::ofstream writer;
+	writer.open(output, std::ios::binary);
+	if (!writer.is_open() || !writer.good()) throw std::runtime_error("Cannot open file for write");
+
+	StreamSink sink(writer);
+	DecodeSource(source, sink, bytesRead);
+
+	writer.flush();
+	writer.close();
+
+	bytesWritten += sink.BytesWritten();
+}
+
+// Decodes the file at <input> and writes the original bytes to <out>
+void HuffmanEncoder::DecodeFile(std::string input, ByteSink& out, size_t& bytesRead)
+{
+	MappedFile source(input);
+
+	DecodeSource(source, out, bytesRead);
+}
+
+// Decodes the <length> bytes of the original input starting at <offset> from the file at <input>
+// and writes them to <out>
+//
+// Files that can't be mapped are decoded as a stream, and anything outside the range is dropped
+void HuffmanEncoder::DecodeFileRange(std::string input, unsigned long long offset, unsigned long long length, ByteSink& out, size_t& bytesRead)
+{
+	MappedFile source(input);
+
+	if (source.IsMapped())
+	{
+		DecodeRange(source.Data(), source.Size(), offset, length, out);
+		bytesRead += source.Size();
+		return;
+	}
+
+	RangeSink range(out, offset, length);
+	DecodeSource(source, range, bytesRead);
+}
+
+// Decodes the mapped (or otherwise readable) file and writes the original bytes to <out>
+//
+// The mapping is handed to Decode. Files that can't be mapped are decoded with DecodeStream
+void HuffmanEncoder::DecodeSource(const MappedFile& source, ByteSink& out, size_t& bytesRead)
+{
+	verbose::write("Starting decoding of " + source.Path() + (source.IsMapped() ? " (memory mapped)" : ""));
+
+	if (source.IsMapped())
+	{
+		Decode(source.Data(), source.Size(), out);
+		bytesRead += source.Size();
+		return;
+	}
+
+	std::ifstream reader;
+	reader.open(source.Path(), std::ios::binary);
+	if (!reader.is_open() || !reader.good()) throw std::runtime_error("Cannot open file for read");
+
+	bytesRead += static_cast<size_t>(DecodeStream(reader, out));
+}
+
+// Decodes the <size> bytes at <data> by walking the encoding tree one bit at a time
+//
+// This is the original decoder, and is kept as a reference for the table-driven decoder
+void HuffmanEncoder::DecodeWithTree(const unsigned char* data, size_t size, ByteSink& out)
+{
+	auto currentNode = Tree.Root;
+
+	// Decode the file one byte at a time
+	for (size_t position = 0; position < size; position++)
+	{
+		auto ubyte = data[position];
+
+		// Attempt to decode the read byte bit-by-bit
+		// At each bit, check to see if we're at a leaf node
+		// If we are, write the payload byte to the output
+		// And reset the node pointer to the root of the tree
+		for (auto i = 7; i >= 0; i--)
+		{
+			WriteIfLeaf(out, currentNode);
+			DecodeBit(currentNode, ubyte, 1 << i);
+		}
+	}
+
+	// Check if we're evenly alligned. If not, we won't be at a leaf node anyways
+	WriteIfLeaf(out, currentNode);
+}
+
+// Decodes the <size> bytes at <data> as blocks written by EncodeBlocks, <length> bytes in total, and
+// writes the original bytes from <first> up to <last> to <out>
+//
+// The index at the end of the file is read first, so the size of every block is known up front
+// and the blocks can be decoded in parallel. Every block starts at a multiple of the block size in
+// the original input, so only the blocks that overlap the range need to be decoded
+void HuffmanEncoder::DecodeBlocks(const HuffmanDecodeTable& table, const unsigned char* data, size_t size, unsigned long long length, unsigned char flags, unsigned long long first, unsigned long long last, ByteSink& out) const
+{
+	size_t position = 0;
+	auto blockSize = ReadUInt32(data, size, position);
+	if (blockSize == 0 || blockSize > MAX_BLOCK_SIZE) throw std::invalid_argument("Invalid block size: " + std::to_string(blockSize));
+
+	// Rounded up without adding to the length first, which can overflow when the header is corrupt
+	auto count = length / blockSize + (length % blockSize != 0);
+
+	// Find the index at the end of the file
+	if ((size - position) / 8 < count) throw std::invalid_argument("Input file is truncated");
+	auto dataSize = static_cast<size_t>(size - position - count * 8);
+	auto blocks = data + position;
+	auto indexStart = position + dataSize;
+
+	std::vector<unsigned long long> index(static_cast<size_t>(count));
+	for (size_t b = 0; b < index.size(); b++)
+	{
+		index[b] = ReadUInt64(data, size, indexStart);
+
+		if (index[b] > dataSize || (b > 0 && index[b] < index[b - 1])) throw std::invalid_argument("Block index is corrupt");
+	}
+
+	if (!index.empty() && index.back() != dataSize) throw std::invalid_argument("Block index is corrupt");
+
+	// The blocks that overlap the range
+	last = std::min(last, length);
+	if (first >= last) return;
+	auto firstBlock = static_cast<size_t>(first / blockSize);
+	auto lastBlock = static_cast<size_t>(last / blockSize + (last % blockSize != 0));
+	if (lastBlock > count) throw std::invalid_argument("Block index is corrupt");
+
+	// Decode a batch of blocks at a time, every block in it on its own thread. Each block
+	// decodes into its own slice of the output buffer, so the whole batch is written out at once
+	auto threads = parallel::ThreadCount(Threads);
+	auto batchBlocks = static_cast<size_t>(threads) * 2;
+	verbose::write("Decoding " + std::to_string(lastBlock - firstBlock) + " of " + std::to_string(count) + " blocks on " + std::to_string(threads) + " threads");
+
+	std::vector<unsigned char> output(static_cast<size_t>(std::min<unsigned long long>(batchBlocks * static_cast<unsigned long long>(blockSize), length)));
+
+	for (auto batch = firstBlock; batch < lastBlock; batch += batchBlocks)
+	{
+		auto batchEnd = std::min(batch + batchBlocks, lastBlock);
+
+		// The last block of the file may be short
+		auto outputStart = batch * static_cast<unsigned long long>(blockSize);
+		auto produced = static_cast<size_t>(std::min<unsigned long long>((batchEnd - batch) * static_cast<unsigned long long>(blockSize), length - outputStart));
+
+		parallel::For(batchEnd - batch, threads, [&](size_t i)
+		{
+			auto b = batch + i;
+			auto start = static_cast<size_t>(b == 0 ? 0 : index[b - 1]);
+			auto end = static_cast<size_t>(index[b]);
+			auto expected = std::min<size_t>(blockSize, produced - i * blockSize);
+
+			if (!DecodeBlock(table, blocks + start, end - start, output.data() + i * blockSize, expected, flags))
+			{
+				throw std::runtime_error("Input file is corrupt (block " + std::to_string(b) + " is truncated)");
+			}
+		});
+
+		// Only write the part of the batch inside the range
+		auto skip = first > outputStart ? static_cast<size_t>(first - outputStart) : 0;
+		auto end = static_cast<size_t>(std::min<unsigned long long>(produced, last - outputStart));
+		out.Write(output.data() + skip, end - skip);
+	}
+}
+
+// Decodes the frames written by EncodeFrames from <read> and writes the original bytes from <first>
+// up to <last> to <out>
+//
+// Frames are read, decoded and written by a pipeline (see pipeline::Run), so the file never has to be
+// in memory all at once. Frames before the range are read past without being decoded, and reading stops
+// at the end of the range. If every frame is read and <length> isn't UNKNOWN_LENGTH, the blocks must add up to it
+void HuffmanEncoder::DecodeFrames(const HuffmanDecodeTable& table, const Reader& read, unsigned long long length, unsigned char flags, size_t blockSize, unsigned long long first, unsigned long long last, ByteSink& out) const
+{
+	auto threads = parallel::ThreadCount(Threads);
+	verbose::write("Decoding frames on " + std::to_string(threads) + " coder threads");
+
+	// No block can take up more than its longest codes, its code lengths and its stream sizes
+	auto largest = static_cast<unsigned long long>(blockSize) * canonical::MAX_CODE_LENGTH / 8 + (1 << 16);
+
+	// The offset in the original input of the next frame, and whether the end frame was reached
+	unsigned long long position = 0;
+	auto finished = false;
+
+	pipeline::Run<Frame, std::vector<unsigned char>>(threads,
+		[&](Frame& frame)
+		{
+			while (position < last)
+			{
+				unsigned char sizes[8];
+				if (ReadFully(read, sizes, sizeof(sizes)) != sizeof(sizes)) throw std::runtime_error("Input file is truncated");
+
+				size_t sizePosition = 0;
+				auto encoded = ReadUInt32(sizes, sizeof(sizes), sizePosition);
+				frame.Size = ReadUInt32(sizes, sizeof(sizes), sizePosition);
+
+				// An empty frame marks the end
+				if (encoded == 0 && frame.Size == 0)
+				{
+					finished = true;
+					return false;
+				}
+
+				if (encoded == 0 || encoded > largest || frame.Size == 0 || frame.Size > blockSize)
+				{
+					throw std::runtime_error("Input file is corrupt (a frame has invalid sizes)");
+				}
+
+				frame.Data.resize(encoded);
+				if (ReadFully(read, frame.Data.data(), encoded) != encoded) throw std::runtime_error("Input file is truncated");
+
+				frame.Offset = position;
+				position += frame.Size;
+
+				// Frames that end before the range don't need decoding
+				if (position > first) return true;
+			}
+
+			return false;
+		},
+		[&](Frame& frame, std::vector<unsigned char>& block)
+		{
+			block.resize(frame.Size);
+			if (!DecodeBlock(table, frame.Data.data(), frame.Data.size(), block.data(), frame.Size, flags))
+			{
+				throw std::runtime_error("Input file is corrupt (a frame is truncated)");
+			}
+
+			// Trim the parts of the block outside the range
+			auto end = frame.Offset + frame.Size;
+			if (end > last) block.resize(static_cast<size_t>(last - frame.Offset));
+			if (frame.Offset < first) block.erase(block.begin(), block.begin() + static_cast<size_t>(first - frame.Offset));
+		},
+		[&](std::vector<unsigned char>& block)
+		{
+			out.Write(block.data(), block.size());
+		});
+
+	if (finished && length != UNKNOWN_LENGTH && position != length)
+	{
+		throw std::runtime_error("Input file is corrupt (decoded " + std::to_string(position) + " bytes instead of " + std::to_string(length) + ")");
+	}
+}
+
+// Decodes the <size> encoded bytes of a block at <data> into the <count> bytes at <out>
+//
+// Returns: false iff the block ran out of bits before <count> bytes were decoded
+bool HuffmanEncoder::DecodeBlock(const HuffmanDecodeTable& table, const unsigned char* data, size_t size, unsigned char* out, size_t count, unsigned char flags) const
+{
+	if ((flags & FLAG_ADAPTIVE) != 0) return DecodeAdaptiveBlock(data, size, out, count, flags);
+	if ((flags & FLAG_ANS) != 0) return AnsDecoder.Decode(data, size, out, count);
+
+	return DecodeStreams(table, data, size, out, count, flags);
+}
+
+// Decodes a block written by EncodeAdaptiveBlock
+//
+// Huffman blocks carry their own code lengths, so each one builds its own decoding table
+bool HuffmanEncoder::DecodeAdaptiveBlock(const unsigned char* data, size_t size, unsigned char* out, size_t count, unsigned char flags) const
+{
+	if (size == 0) return false;
+
+	auto kind = data[0];
+	data++;
+	size--;
+
+	switch (kind)
+	{
+	case BLOCK_HUFFMAN:
+	{
+		unsigned char lengths[256];
+		unsigned long long codes[256];
+
+		auto used = canonical::ParseLengths(data, size, lengths);
+		canonical::AssignCodes(lengths, codes);
+
+		HuffmanDecodeTable table;
+		table.Build(codes, lengths);
+
+		return DecodeStreams(table, data + used, size - used, out, count, flags);
+	}
+
+	case BLOCK_RAW:
+		if (size != count) return false;
+
+		std::copy(data, data + size, out);
+		return true;
+
+	case BLOCK_RUNS:
+		return runlength::Decode(data, size, out, count);
+
+	default:
+		throw std::runtime_error("Input file is corrupt (unknown block kind " + std::to_string(kind) + ")");
+	}
+}
+
+// Decodes the bitstreams of a block with the specified table, or with the context tables if the
+// flags have FLAG_CONTEXT set
+//
+// Returns: false iff the block ran out of bits before <count> bytes were decoded
+bool HuffmanEncoder::DecodeStreams(const HuffmanDecodeTable& table, const unsigned char* data, size_t size, unsigned char* out, size_t count, unsigned char flags) const
+{
+	auto contexts = (flags & FLAG_CONTEXT) != 0;
+
+	if ((flags & FLAG_STREAMS) == 0)
+	{
+		BitReader bits(data, size);
+		if (contexts) return DecodeContext(&bits, 1, out, count);
+
+		return table.Decode(bits, out, count) == count;
+	}
+
+	// The sizes of the first three streams come first, and the last stream is the rest of the block
+	const auto STREAMS = HuffmanDecodeTable::STREAM_COUNT;
+	const size_t SIZES_LENGTH = 4 * (STREAMS - 1);
+	if (size < SIZES_LENGTH) return false;
+
+	size_t sizes[STREAMS];
+	size_t used = SIZES_LENGTH;
+	for (unsigned s = 0; s < STREAMS - 1; s++)
+	{
+		auto p = data + 4 * s;
+		sizes[s] = (static_cast<size_t>(p[0]) << 24) | (static_cast<size_t>(p[1]) << 16) | (static_cast<size_t>(p[2]) << 8) | p[3];
+
+		if (sizes[s] > size - used) throw std::runtime_error("Input file is corrupt (stream sizes don't fit in the block)");
+		used += sizes[s];
+	}
+
+	sizes[STREAMS - 1] = size - used;
+
+	auto stream = data + SIZES_LENGTH;
+	BitReader readers[STREAMS] =
+	{
+		BitReader(stream, sizes[0]),
+		BitReader(stream + sizes[0], sizes[1]),
+		BitReader(stream + sizes[0] + sizes[1], sizes[2]),
+		BitReader(stream + sizes[0] + sizes[1] + sizes[2], sizes[3])
+	};
+
+	if (contexts) return DecodeContext(readers, STREAMS, out, count);
+
+	return table.DecodeInterleaved(readers, out, count) == count;
+}
+
+// Decodes <count> context-coded bytes into <out>, where byte i is read from readers[i % streams]
+//
+// Every byte picks the table for the next one, so unlike the other decoders, the streams can't
+// be decoded ahead of each other. <streams> must be a power of two
+bool HuffmanEncoder::DecodeContext(BitReader readers[], unsigned streams, unsigned char* out, size_t count) const
+{
+	const HuffmanDecodeTable* tables[256];
+	for (auto c = 0; c < 256; c++) tables[c] = &ContextTables[ContextMap[c]].Decoder;
+
+	if (streams == 1) return HuffmanDecodeTable::DecodeContext(tables, context::INITIAL_CONTEXT, readers[0], out, count) == count;
+
+	auto previous = context::INITIAL_CONTEXT;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (!tables[previous]->DecodeSymbol(readers[i & (streams - 1)], out[i])) return false;
+		previous = out[i];
+	}
+
+	return true;
+}
+
+// Decodes the <size> bytes at <data> with the specified decoding table, stopping after <count> bytes were written
+//
+// Each step resolves up to the width of the table's root (see HuffmanDecodeTable::RootBits) with a single lookup.
+// The decoded bytes are collected in a large buffer so the output is written in big chunks
+//
+// Version 2 files don't record their length, so <count> is ULLONG_MAX for them. The last byte of
+// those files is padded with the beginning of the longest code. Since that can never form a complete
+// code, decoding stops once the reader can't produce another symbol
+void HuffmanEncoder::DecodeWithTable(const HuffmanDecodeTable& table, const unsigned char* data, size_t size, ByteSink& out, unsigned long long count) const
+{
+	BitReader bits(data, size);
+
+	// Small files don't need the whole output buffer
+	std::vector<unsigned char> buffer(static_cast<size_t>(std::min(count, static_cast<unsigned long long>(OUTPUT_BUFFER_SIZE))));
+
+	auto lengthKnown = count != ULLONG_MAX;
+
+	while (count > 0)
+	{
+		auto wanted = static_cast<size_t>(std::min<unsigned long long>(count, buffer.size()));
+		auto decoded = table.Decode(bits, buffer.data(), wanted);
+		if (decoded == 0) break;
+
+		out.Write(buffer.data(), decoded);
+		count -= decoded;
+	}
+
+	if (lengthKnown && count > 0) throw std::runtime_error("Input file is truncated");
+}
+
+// Write the subtree from the specified node of <tree> to the specified sink
+void HuffmanEncoder::WriteEncodingTree(ByteSink& out, const HuffmanTree& tree, unsigned short node)
+{
+	if (node == HuffmanTree::NO_NODE) return;
+
+	auto& current = tree[node];
+
+	// Assume we're at a leaf node
+	unsigned char nodeType = FLAG_LEAF_NODE;
+
+	// If we are, write it to the sink
+	if(current.IsLeaf())
+	{
+		out.Put(nodeType);
+		out.Put(current.Payload);
+		return;
+	}
+
+	// Otherwise, set the node type bitmask correctly
+	if(current.Left != HuffmanTree::NO_NODE) nodeType |= FLAG_LEFT_CHILD;
+	if (current.Right != HuffmanTree::NO_NODE) nodeType |= FLAG_RIGHT_CHILD;
+
+	// Write the node type
+	out.Put(nodeType);
+
+	// And then write the left and right subtrees
+	WriteEncodingTree(out, tree, current.Left);
+	WriteEncodingTree(out, tree, current.Right);
+}
+
+// Builds an encoding tree in <tree> from the specified weights
+//
+// If <everyByte> is set, every byte gets a leaf even if its weight is zero. Otherwise only the bytes
+// with a weight do, and if there are none the tree is left empty
+//
+// The leaves are sorted by weight once. After that, the two lightest nodes are always at the
+// front of either the sorted leaves or the internal nodes made so far, since every internal node
+// is at least as heavy as the one made before it. That makes each merge constant time, so the
+// whole tree takes O(n log n) for n leaves instead of rescanning every slot for each merge.
+//
+// The leaves are added to the tree first, so leaf i is node i and the internal nodes follow them in
+// the order they were made. The weights are only needed while building, so they're kept on the side
+void HuffmanEncoder::BuildTree(const unsigned long long weights[256], bool everyByte, HuffmanTree& tree)
+{
+	verbose::write("Building Encoding Tree...");
+
+	tree.Clear();
+
+	// The weight of every node, by index
+	unsigned long long weight[HuffmanTree::MAX_NODES];
+
+	for (auto b = 0; b < 256; b++)
+	{
+		if (!everyByte && weights[b] == 0) continue;
+
+		weight[tree.Add(static_cast<unsigned char>(b))] = weights[b];
+	}
+
+	// There was nothing to build a tree from
+	auto leafCount = static_cast<unsigned short>(tree.Count);
+	if (leafCount == 0) return;
+
+	// Keep nodes of the same weight in byte order, so the tree doesn't depend on the sort
+	unsigned short leaves[256];
+	for (unsigned short i = 0; i < leafCount; i++) leaves[i] = i;
+
+	std::stable_sort(leaves, leaves + leafCount, [&](unsigned short a, unsigned short b)
+	{
+		return weight[a] < weight[b];
+	});
+
+	// Internal nodes are made in order of weight, so they are a second sorted queue, starting right after the leaves
+	auto nextLeaf = 0;
+	auto nextInternal = leafCount;
+
+	// Takes the lighter of the nodes at the front of the two queues, preferring leaves on ties
+	auto takeLightest = [&]()
+	{
+		if (nextInternal == tree.Count || (nextLeaf < leafCount && weight[leaves[nextLeaf]] <= weight[nextInternal]))
+		{
+			return leaves[nextLeaf++];
+		}
+
+		return nextInternal++;
+	};
+
+	// Pair nodes until we have a single root node forming the tree
+	for (auto merges = 0; merges < leafCount - 1; merges++)
+	{
+		auto first = takeLightest();
+		auto second = takeLightest();
+
+		// Make a new internal node whose weight is the sum of its left and right sub-trees
+		auto node = tree.Add(0, first, second);
+		weight[node] = weight[first] + weight[second];
+
+		verbose::write("\tMerging nodes with weights " + std::to_string(weight[first]) + " and " + std::to_string(weight[second]));
+	}
+
+	// The last node added is the root, which is the only leaf if there was just one
+	tree.Root = static_cast<unsigned short>(tree.Count - 1);
+}
+
+// Rebuilds the bitstring table, integer codes and padding hint from the encoding tree
+void HuffmanEncoder::BuildEncodingTables()
+{
+	PaddingHint = "";
+	std::fill(CodeLengths, CodeLengths + 256, 0);
+
+	BuildEncodingTable("", Tree.Root);
+	BuildCodeTable(Tree.Root, 0, 0);
+
+	CodesVersion = LEGACY_VERSION;
+	IsDirty = false;
+}
+
+// Makes sure the codes are built for the file format version that will be written
+//
+// Version 2 files use the codes from the encoding tree, version 3 files use canonical codes
+void HuffmanEncoder::PrepareCodes(const unsigned long long weights[256])
+{
+	if (FormatVersion == LEGACY_VERSION)
+	{
+		if (Tree.Empty() && HasWeights)
+		{
+			// Every byte is a leaf, even ones that don't occur in the file. The decoder relies on
+			// there being a code of at least 8 bits to pad the last byte with
+			BuildTree(Weights, true, Tree);
+			IsDirty = true;
+		}
+
+		// Version 2 files store the whole tree, which we don't have after decoding a version 3 file
+		if (Tree.Empty()) throw std::runtime_error("Version 2 files can only be written by an encoder with an encoding tree");
+
+		if (MaxCodeLength != 0) verbose::write("Version 2 files always use the codes from the whole encoding tree, ignoring the code length limit");
+
+		if (IsDirty || CodesVersion != LEGACY_VERSION)
+		{
+			// This assignment requires us to use std::strings and not bitsets
+			verbose::write("Building Encoding Table...");
+			BuildEncodingTables();
+
+			verbose::write("Padding Hint: " + PaddingHint);
+		}
+	}
+	else if (IsDirty || CodesVersion != VERSION)
+	{
+		BuildCanonicalCodes(weights);
+	}
+}
+
+// Makes the codes of the dictionary the current codes, unless they already are
+//
+// Encoding or decoding many small files with the same dictionary then only compares the lengths
+void HuffmanEncoder::UseDictionaryCodes()
+{
+	auto current = CodesVersion == VERSION && !IsDirty && std::equal(CodeLengths, CodeLengths + 256, SharedDictionary.Lengths);
+	if (current) return;
+
+	std::copy(SharedDictionary.Lengths, SharedDictionary.Lengths + 256, CodeLengths);
+	std::copy(DictionaryCodes, DictionaryCodes + 256, Codes);
+
+	CodesVersion = VERSION;
+	IsDirty = false;
+	LimitCost = 0;
+}
+
+// Rebuilds the code lengths and canonical codes used for version 3 files
+//
+// The lengths come from a tree built only from the bytes that occur in the file, so unused
+// bytes don't get a code at all. If the encoder was built by decoding a version 2 file, the
+// weights are unknown and the lengths are taken from the tree in that file instead
+void HuffmanEncoder::BuildCanonicalCodes(const unsigned long long weights[256])
+{
+	verbose::write("Building Canonical Codes...");
+
+	std::fill(CodeLengths, CodeLengths + 256, 0);
+	LimitCost = 0;
+
+	if (HasWeights)
+	{
+		LimitCost = BuildLengths(weights, CodeLengths);
+	}
+	else
+	{
+		BuildCodeTable(Tree.Root, 0, 0);
+
+		if (MaxCodeLength != 0) verbose::write("The byte weights are unknown, so the code lengths can't be limited");
+	}
+
+	for (auto b = 0; b < 256; b++)
+	{
+		if (CodeLengths[b] > canonical::MAX_CODE_LENGTH)
+		{
+			throw std::runtime_error("The code for byte " + std::to_string(b) + " is " + std::to_string(CodeLengths[b]) + " bits long, which is too long for a canonical code");
+		}
+	}
+
+	canonical::AssignCodes(CodeLengths, Codes);
+
+	CodesVersion = VERSION;
+	IsDirty = false;
+}
+
+// Builds the code lengths of a Huffman code for the specified weights, limited to MaxCodeLength
+//
+// The lengths come from a tree built only from the bytes with a weight, so bytes that don't occur
+// don't get a code at all
+//
+// Returns: The number of extra bits the length limit costs for the weights
+unsigned long long HuffmanEncoder::BuildLengths(const unsigned long long weights[256], unsigned char lengths[256]) const
+{
+	std::fill(lengths, lengths + 256, 0);
+
+	HuffmanTree tree;
+	BuildTree(weights, false, tree);
+
+	// Nothing to code
+	if (tree.Empty()) return 0;
+
+	if (tree[tree.Root].IsLeaf())
+	{
+		// A tree with a single leaf has no edges, but every byte still needs at least one bit
+		lengths[tree[tree.Root].Payload] = 1;
+	}
+	else
+	{
+		BuildLengthTable(tree, tree.Root, 0, lengths);
+	}
+
+	// If the tree has codes that are too long, find the best codes that aren't
+	unsigned long long cost = 0;
+	if (MaxCodeLength != 0 && *std::max_element(lengths, lengths + 256) > MaxCodeLength)
+	{
+		auto unlimited = canonical::EncodedBits(weights, lengths);
+		canonical::LimitLengths(weights, MaxCodeLength, lengths);
+		cost = canonical::EncodedBits(weights, lengths) - unlimited;
+
+		verbose::write("Limited codes to " + std::to_string(MaxCodeLength) + " bits at a cost of " + std::to_string(cost) + " bits");
+	}
+
+	return cost;
+}
+
+// Counts the byte pairs of the <size> bytes at <data> and builds the context map and context tables from them
+void HuffmanEncoder::BuildContextTables(const unsigned char* data, size_t size, size_t blockSize)
+{
+	verbose::write("Building Context Tables...");
+
+	context::PairCounter pairs(blockSize);
+	pairs.Add(data, size);
+
+	std::vector<unsigned long long> weights;
+	auto tables = context::Cluster(pairs, MaxContextTables, ContextMap, weights);
+
+	ContextTables.resize(tables);
+	LimitCost = 0;
+
+	for (unsigned t = 0; t < tables; t++)
+	{
+		auto& table = ContextTables[t];
+		LimitCost += BuildLengths(weights.data() + 256 * static_cast<size_t>(t), table.Lengths);
+
+		for (auto b = 0; b < 256; b++)
+		{
+			if (table.Lengths[b] > canonical::MAX_CODE_LENGTH)
+			{
+				throw std::runtime_error("The code for byte " + std::to_string(b) + " in context table " + std::to_string(t) + " is too long for a canonical code");
+			}
+		}
+
+		canonical::AssignCodes(table.Lengths, table.Codes);
+	}
+}
+
+// Writes the number of context tables, the context map and the code lengths of every table
+void HuffmanEncoder::WriteContextTables(ByteSink& out) const
+{
+	std::vector<unsigned char> tables;
+	tables.push_back(static_cast<unsigned char>(ContextTables.size() - 1));
+
+	// With a single table, every context maps to it
+	if (ContextTables.size() > 1) tables.insert(tables.end(), ContextMap, ContextMap + 256);
+
+	for (auto& table : ContextTables) canonical::AppendLengths(table.Lengths, tables);
+
+	out.Write(tables.data(), tables.size());
+}
+
+// Reads the context tables written by WriteContextTables and builds their decoding tables
+void HuffmanEncoder::ReadContextTables(const unsigned char* data, size_t size, size_t& position)
+{
+	auto tables = static_cast<unsigned>(ReadByte(data, size, position)) + 1;
+
+	std::fill(ContextMap, ContextMap + 256, 0);
+	if (tables > 1)
+	{
+		if (size - position < 256) throw std::invalid_argument("Unexpected end of input in context map");
+		std::copy(data + position, data + position + 256, ContextMap);
+		position += 256;
+
+		for (auto c = 0; c < 256; c++)
+		{
+			if (ContextMap[c] >= tables) throw std::invalid_argument("Context map refers to table " + std::to_string(ContextMap[c]) + " of " + std::to_string(tables));
+		}
+	}
+
+	verbose::write("Reading " + std::to_string(tables) + " context tables");
+
+	ContextTables.resize(tables);
+	for (auto& table : ContextTables)
+	{
+		position += canonical::ParseLengths(data + position, size - position, table.Lengths);
+		canonical::AssignCodes(table.Lengths, table.Codes);
+		table.Decoder.Build(table.Codes, table.Lengths);
+	}
+}
+
+// Codes each byte of version 3 files with one of up to <tables> code tables, or 0 to use a single table
+void HuffmanEncoder::SetContextTables(unsigned tables)
+{
+	if (tables > context::MAX_TABLES)
+	{
+		throw std::invalid_argument("At most " + std::to_string(context::MAX_TABLES) + " context tables can be used");
+	}
+
+	MaxContextTables = tables;
+}
+
+// Sets the file format version written by EncodeFile. Must be VERSION or LEGACY_VERSION
+void HuffmanEncoder::SetFormatVersion(unsigned short version)
+{
+	if (version != VERSION && version != LEGACY_VERSION)
+	{
+		throw std::invalid_argument("Can't write file version " + std::to_string(version));
+	}
+
+	FormatVersion = version;
+}
+
+// Limits the canonical codes used for version 3 files to at most <bits> bits, or 0 for no limit
+void HuffmanEncoder::SetMaxCodeLength(unsigned bits)
+{
+	if (bits > canonical::MAX_CODE_LENGTH)
+	{
+		throw std::invalid_argument("Codes can't be limited to " + std::to_string(bits) + " bits, the most is " + std::to_string(canonical::MAX_CODE_LENGTH));
+	}
+
+	// Codes read from a file can't be rebuilt, since the weights are unknown
+	if (bits != MaxCodeLength && HasWeights) IsDirty = true;
+	MaxCodeLength = bits;
+}
+
+// Returns: The number of extra bits the code length limit added to the encoded data of the last
+// version 3 file, compared to unlimited codes
+unsigned long long HuffmanEncoder::LengthLimitCost() const
+{
+	return LimitCost;
+}
+
+// Sets the number of input bytes in each independently encoded block of version 3 files, or 0 for a single block
+void HuffmanEncoder::SetBlockSize(size_t bytes)
+{
+	if (bytes > MAX_BLOCK_SIZE)
+	{
+		throw std::invalid_argument("Blocks can be at most " + std::to_string(MAX_BLOCK_SIZE) + " bytes");
+	}
+
+	BlockSize = bytes;
+}
+
+// If set to true, each block of a version 3 file is split into four interleaved bitstreams
+void HuffmanEncoder::SetInterleaved(bool enable)
+{
+	Interleaved = enable;
+}
+
+// If set to true, every block of a version 3 file gets its own code, or is stored raw or run-length coded
+void HuffmanEncoder::SetAdaptive(bool enable)
+{
+	Adaptive = enable;
+}
+
+// If set to true, the blocks of version 3 files are coded with tANS instead of Huffman codes
+void HuffmanEncoder::SetAns(bool enable)
+{
+	UseAns = enable;
+}
+
+// If set to true, version 3 files are written as a stream of frames by a reader, coders and a writer
+void HuffmanEncoder::SetPipelined(bool enable)
+{
+	Pipelined = enable;
+}
+
+// If set to true, version 3 files are run-length pre-transformed before they are coded
+void HuffmanEncoder::SetRunTransform(bool enable)
+{
+	RunTransform = enable;
+}
+
+// Encodes version 3 files with the codes of the specified dictionary, and decodes files that refer to it
+//
+// The codes and the decoding table of the dictionary are built here, once
+void HuffmanEncoder::SetDictionary(const dictionary::Dictionary& dictionary)
+{
+	SharedDictionary = dictionary;
+	HasDictionary = true;
+
+	canonical::AssignCodes(SharedDictionary.Lengths, DictionaryCodes);
+	DictionaryTable.Build(DictionaryCodes, SharedDictionary.Lengths);
+
+	// The current codes may have come from an older dictionary
+	IsDirty = true;
+}
+
+// Sets the number of threads used to encode and decode blocks, or 0 for one per core
+void HuffmanEncoder::SetThreads(unsigned threads)
+{
+	Threads = threads;
+}
+
+// Writes a 4-byte big-endian integer to the specified sink
+void HuffmanEncoder::WriteUInt32(ByteSink& out, unsigned value)
+{
+	for (auto shift = 24; shift >= 0; shift -= 8)
+	{
+		out.Put(static_cast<unsigned char>((value >> shift) & 0xFF));
+	}
+}
+
+// Reads a 4-byte big-endian integer from <position> in the <size> bytes at <data>
+unsigned HuffmanEncoder::ReadUInt32(const unsigned char* data, size_t size, size_t& position)
+{
+	unsigned value = 0;
+	for (auto i = 0; i < 4; i++) value = (value << 8) | ReadByte(data, size, position);
+
+	return value;
+}
+
+// Writes an 8-byte big-endian integer to the specified sink
+void HuffmanEncoder::WriteUInt64(ByteSink& out, unsigned long long value)
+{
+	for (auto shift = 56; shift >= 0; shift -= 8)
+	{
+		out.Put(static_cast<unsigned char>((value >> shift) & 0xFF));
+	}
+}
+
+// Reads an 8-byte big-endian integer from <position> in the <size> bytes at <data>
+unsigned long long HuffmanEncoder::ReadUInt64(const unsigned char* data, size_t size, size_t& position)
+{
+	unsigned long long value = 0;
+	for (auto i = 0; i < 8; i++) value = (value << 8) | ReadByte(data, size, position);
+
+	return value;
+}
+
+// Reads the byte at <position> in the <size> bytes at <data>
+unsigned char HuffmanEncoder::ReadByte(const unsigned char* data, size_t size, size_t& position)
+{
+	if (position >= size) throw std::invalid_argument("Unexpected end of input");
+
+	return data[position++];
+}
+
+// Reads the rest of the specified stream into <contents>
+void HuffmanEncoder::ReadStream(std::istream& reader, std::vector<unsigned char>& contents)
+{
+	std::vector<char> buffer(INPUT_BUFFER_SIZE);
+	while (reader.read(buffer.data(), buffer.size()), reader.gcount() > 0)
+	{
+		contents.insert(contents.end(), buffer.data(), buffer.data() + reader.gcount());
+	}
+}
+
+// Returns: A reader over the <size> bytes at <data>
+HuffmanEncoder::Reader HuffmanEncoder::MemoryReader(const unsigned char* data, size_t size)
+{
+	return [data, size](unsigned char* buffer, size_t wanted) mutable
+	{
+		auto count = std::min(wanted, size);
+		std::copy(data, data + count, buffer);
+
+		data += count;
+		size -= count;
+		return count;
+	};
+}
+
+// Returns: A reader over the specified stream, which adds the number of bytes it reads to <bytesRead>
+HuffmanEncoder::Reader HuffmanEncoder::StreamReader(std::istream& in, unsigned long long& bytesRead)
+{
+	return [&in, &bytesRead](unsigned char* buffer, size_t wanted)
+	{
+		in.read(reinterpret_cast<char*>(buffer), wanted);
+		auto count = static_cast<size_t>(in.gcount());
+
+		bytesRead += count;
+		return count;
+	};
+}
+
+// Reads from <read> until the <size> bytes at <buffer> are filled or the input is exhausted
+//
+// Returns: The number of bytes that were read
+size_t HuffmanEncoder::ReadFully(const Reader& read, unsigned char* buffer, size_t size)
+{
+	size_t filled = 0;
+	while (filled < size)
+	{
+		auto count = read(buffer + filled, size - filled);
+		if (count == 0) break;
+
+		filled += count;
+	}
+
+	return filled;
+}
+
+// Populates <lengths> with the depth of every leaf in the subtree at the specified node of <tree>
+void HuffmanEncoder::BuildLengthTable(const HuffmanTree& tree, unsigned short node, unsigned length, unsigned char lengths[256])
+{
+	if (node == HuffmanTree::NO_NODE) return;
+
+	auto& current = tree[node];
+	if (current.IsLeaf())
+	{
+		lengths[current.Payload] = static_cast<unsigned char>(length);
+		return;
+	}
+
+	BuildLengthTable(tree, current.Left, length + 1, lengths);
+	BuildLengthTable(tree, current.Right, length + 1, lengths);
+}
+
+// Populates the integer codes and code lengths from the subtree at the specified node
+//
+// Codes longer than 64 bits can't be represented as an integer, but their length is
+// still recorded so the encoder knows to fall back to the bitstring
+void HuffmanEncoder::BuildCodeTable(unsigned short node, unsigned long long code, unsigned length)
+{
+	if (node == HuffmanTree::NO_NODE) return;
+
+	auto& current = Tree[node];
+	if (current.IsLeaf())
+	{
+		Codes[current.Payload] = code;
+		CodeLengths[current.Payload] = static_cast<unsigned char>(length);
+		return;
+	}
+
+	// 0 for left and 1 for right, just like the bitstrings
+	BuildCodeTable(current.Left, code << 1, length + 1);
+	BuildCodeTable(current.Right, (code << 1) | 1, length + 1);
+}
+
+// Populates the encoding table from the subtree at the specified node
+void HuffmanEncoder::BuildEncodingTable(std::string bitstring, unsigned short node)
+{
+	if (node == HuffmanTree::NO_NODE) return;
+
+	auto& current = Tree[node];
+	if (current.IsLeaf())
+	{
+		// We found a leaf node, record the bitstring that got us here
+		EncodingTable[current.Payload] = bitstring;
+
+		// Remember the largest bitstring for easy padding of non-aligned bytes when encoding
+		if(bitstring.length() >= 8 && bitstring.length() > PaddingHint.length())
+		{
+			PaddingHint = bitstring;
+			verbose::write("\tElecting new padding hint " + bitstring);
+		}
+	}
+	else
+	{
+		// Go find another leaf, 0 for left
+		BuildEncodingTable(bitstring + "0", current.Left);
+		// and 1 for right
+		BuildEncodingTable(bitstring + "1", current.Right);
+	}
+}
@@ -26,6 +26,24 @@
  */
 
 #pragma once
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "Ans.h"
+#include "ByteSink.h"
+#include "DecodeTable.h"
+#include "Dictionary.h"
+
+class BitWriter;
+class MappedFile;
+
+namespace runlength
+{
+	class ExpandingSink;
+}
 
 // The next node in the stream is a leaf node
 static const unsigned char FLAG_LEAF_NODE   = 0x00;
@@ -36,31 +54,71 @@ static const unsigned char FLAG_RIGHT_CHILD = 0x02;
 // The next node in the stream has both a left and right child
 static const unsigned char FLAG_BOTH_NODES  = FLAG_LEFT_CHILD | FLAG_RIGHT_CHILD;
 
-// A structure for representing a node in a Huffman Tree
-struct HuffmanTreeNode
+// A Huffman tree whose nodes are kept in a single flat array
+//
+// A tree over bytes has at most 256 leaves and 255 internal nodes, so all of them fit in one fixed
+// block and children are referred to by their 16-bit index instead of a pointer. Building or reading
+// a tree doesn't allocate anything, and walking it doesn't chase pointers all over the heap
+struct HuffmanTree
 {
-	// The payload of the node
-	unsigned char payload;
-	// The weight of this node
-	unsigned long long weight;
-
-	// The left child
-	HuffmanTreeNode* Left = nullptr;
-	// The right child
-	HuffmanTreeNode* Right = nullptr;
-
-	// Construct a tree node from the specified character and weight
-	explicit HuffmanTreeNode(unsigned char p, unsigned long long w) : payload(p), weight(w) {}
-	~HuffmanTreeNode()
+	// The most nodes a tree can have
+	static const unsigned MAX_NODES = 511;
+	// The index of a child that doesn't exist, and the root of an empty tree
+	static const unsigned short NO_NODE = 0xFFFF;
+
+	// A node of the tree
+	struct Node
 	{
-		if (Left != nullptr) delete Left;
-		if (Right != nullptr) delete Right;
+		// The left child
+		unsigned short Left;
+		// The right child
+		unsigned short Right;
+		// The payload of the node, if it is a leaf
+		unsigned char Payload;
+
+		// Returns: True iff this node is a leaf (has no children)
+		bool IsLeaf() const
+		{
+			return Left == NO_NODE && Right == NO_NODE;
+		}
+	};
+
+	// The nodes of the tree, in the order they were added
+	Node Nodes[MAX_NODES];
+	// The number of nodes in use
+	unsigned Count = 0;
+	// The index of the root node
+	unsigned short Root = NO_NODE;
+
+	// Returns: True iff there is no tree
+	bool Empty() const
+	{
+		return Root == NO_NODE;
 	}
 
-	// Returns: True iff this node is a leaf (has no children)
-	bool IsLeaf() const
+	// Removes every node from the tree
+	void Clear()
 	{
-		return Left == nullptr && Right == nullptr;
+		Count = 0;
+		Root = NO_NODE;
+	}
+
+	// Adds a node with the specified payload and children to the tree
+	//
+	// Returns: The index of the new node
+	// Throws: std::runtime_error if the tree is already full
+	unsigned short Add(unsigned char payload, unsigned short left = NO_NODE, unsigned short right = NO_NODE)
+	{
+		if (Count == MAX_NODES) throw std::runtime_error("Huffman tree has too many nodes");
+
+		Nodes[Count] = Node{ left, right, payload };
+		return static_cast<unsigned short>(Count++);
+	}
+
+	// Returns: The node at the specified index
+	const Node& operator[](unsigned short index) const
+	{
+		return Nodes[index];
 	}
 };
 
@@ -72,9 +130,9 @@ struct HuffmanTreeNode
 // While re-using the same encoder for multiple files will work, the compression will
 // not be ideal since each encoding scheme is optimized per file.
 //
-// During encoding, the encoding tree is written to the output file. This means that
-// if you just need to decode a file, you do not need to have a copy of the original
-// file.
+// During encoding, the code lengths (or the whole encoding tree for version 2 files)
+// are written to the output file. This means that if you just need to decode a file,
+// you do not need to have a copy of the original file.
 //
 // If you try to encode another file using an Encoder built by decoding a file,
 // the encoding table will first be rebuilt
@@ -83,8 +141,61 @@ class HuffmanEncoder
 public:
 	// A magic header written to differentiate huffman encoded files from other file types
 	static const unsigned short HEADER = 0x687A;
-	// The file format version that this copy of the program will support
-	static const unsigned short VERSION = 0x02;
+	// The file format version written by default
+	static const unsigned short VERSION = 0x03;
+	// The previous file format version, which stores the whole encoding tree. It can still be read and written
+	static const unsigned short LEGACY_VERSION = 0x02;
+
+	// Version 3 flag: the input is split into independently encoded blocks with an index at the end of the file
+	static const unsigned char FLAG_BLOCKS = 0x01;
+	// Version 3 flag: each block is split into four interleaved bitstreams that are decoded together
+	static const unsigned char FLAG_STREAMS = 0x02;
+	// Version 3 flag: each byte is coded with one of several code tables, picked by the byte before it
+	static const unsigned char FLAG_CONTEXT = 0x04;
+	// Version 3 flag: every block starts with its own kind, and Huffman blocks with their own code lengths
+	static const unsigned char FLAG_ADAPTIVE = 0x08;
+	// Version 3 flag: the codes come from a dictionary, which is named by its ID instead of storing the code lengths
+	static const unsigned char FLAG_DICTIONARY = 0x10;
+	// Version 3 flag: blocks are written as frames with their sizes in front instead of an index at the
+	// end, so the file can be written and read as a stream
+	static const unsigned char FLAG_FRAMED = 0x20;
+	// Version 3 flag: blocks are coded with tANS instead of Huffman codes, with the distribution stored
+	// in place of the code lengths
+	static const unsigned char FLAG_ANS = 0x40;
+	// Version 3 flag: the input was run-length pre-transformed (see runlength::Transform) before it was
+	// coded, and the length of the coded bytes follows the length of the original file
+	static const unsigned char FLAG_RUNS = 0x80;
+
+	// The length recorded for a stream whose length wasn't known when it was encoded
+	static const unsigned long long UNKNOWN_LENGTH = ~0ULL;
+
+	// Adaptive block kinds: coded with the block's own canonical code
+	static const unsigned char BLOCK_HUFFMAN = 0x00;
+	// Adaptive block kinds: the bytes are stored as they are
+	static const unsigned char BLOCK_RAW = 0x01;
+	// Adaptive block kinds: the bytes are run-length coded (see runlength::Encode)
+	static const unsigned char BLOCK_RUNS = 0x02;
+
+	// What encoding the input the weights were counted from would produce, worked out without encoding it
+	struct SizeEstimate
+	{
+		// The number of bytes the weights add up to
+		unsigned long long InputBytes = 0;
+		// The size of the encoded file, header and all
+		unsigned long long EncodedBytes = 0;
+		// Set to true if EncodedBytes is exactly what Encode writes. Otherwise it is the most Encode can
+		// write, since every block (and stream) is padded to a whole byte depending on where its codes end.
+		// tANS is never exact: its size comes from the ideal cost of each byte, which it gets within a
+		// fraction of a percent of
+		bool Exact = true;
+		// The order-0 entropy of the input in bytes, which no code for single bytes can get below
+		double EntropyBytes = 0;
+	};
+
+	// The largest block that may be used, so a block's bytes always fit in memory
+	static const size_t MAX_BLOCK_SIZE = 1 << 30;
+	// The block size used for interleaved streams when no block size was set
+	static const size_t DEFAULT_BLOCK_SIZE = 1 << 20;
 
 	// Construct an empty Huffman Encoder
 	explicit HuffmanEncoder();
@@ -93,11 +204,100 @@ public:
 	~HuffmanEncoder();
 
 	// Construct a huffman encoder, populating the weights table from the bytes at the
-	// specified file path
-	static HuffmanEncoder* InitializeFromFile(std::string path);
+	// specified file path. The bytes are counted on up to <threads> threads (0 for one per core)
+	static HuffmanEncoder* InitializeFromFile(std::string path, unsigned threads = 0);
+
+	// Construct a huffman encoder, populating the weights table from the <size> bytes at <data>.
+	// The bytes are counted on up to <threads> threads (0 for one per core)
+	static HuffmanEncoder* InitializeFromBuffer(const unsigned char* data, size_t size, unsigned threads = 0);
+
+	// Construct a huffman encoder that encodes with the codes of the specified dictionary,
+	// without counting any weights. See SetDictionary
+	static HuffmanEncoder* InitializeFromDictionary(const dictionary::Dictionary& dictionary, unsigned threads = 0);
+
+	// Builds a dictionary from the weights this encoder was constructed with, limited to the max code length
+	//
+	// Bytes that don't occur in the weights still get a code, since the files encoded with the
+	// dictionary may contain them
+	dictionary::Dictionary BuildDictionary() const;
+
+	// Builds the codes for the file format version now, instead of when the first file is encoded,
+	// so the time it takes can be measured on its own
+	void BuildCodes();
+	// Copies the length of the canonical code for each byte to <lengths>, building the codes first
+	// if needed. Only meaningful for version 3 codes
+	void GetCodeLengths(unsigned char lengths[256]);
+
+	// Works out the size of the file Encode would write with the current settings for the input the
+	// weights were counted from, from the weights and the codes alone, without encoding anything
+	//
+	// With InitializeFromFile, this costs a pass of the histogram over the file and building the codes,
+	// so files that don't compress can be skipped at about the speed they can be read
+	//
+	// Throws: std::runtime_error if the encoder has no weights, and std::invalid_argument for context tables
+	// and adaptive blocks, whose codes depend on the order of the bytes and not just on their weights
+	SizeEstimate Estimate();
+
+	// Encodes the <size> bytes at <data> with the pre-generated encoding table, and writes the
+	// encoded file (header and all) to <out>
+	void Encode(const unsigned char* data, size_t size, ByteSink& out);
+	// Encodes the <size> bytes at <data> and appends the encoded file to <out>
+	void Encode(const unsigned char* data, size_t size, std::vector<unsigned char>& out);
+	// Encodes the <size> bytes at <data> into the <capacity> bytes at <out>
+	//
+	// Returns: The size of the encoded file
+	// Throws: std::length_error if it doesn't fit
+	size_t Encode(const unsigned char* data, size_t size, unsigned char* out, size_t capacity);
+
+	// Decodes the encoded file in the <size> bytes at <data> and writes the original bytes to <out>
+	//
+	// Like DecodeFile, this replaces the codes of the encoder with the ones stored in the file
+	void Decode(const unsigned char* data, size_t size, ByteSink& out);
+	// Decodes the encoded file in the <size> bytes at <data> and appends the original bytes to <out>
+	void Decode(const unsigned char* data, size_t size, std::vector<unsigned char>& out);
+	// Decodes the encoded file in the <size> bytes at <data> into the <capacity> bytes at <out>
+	//
+	// Returns: The number of bytes decoded
+	// Throws: std::length_error if they don't fit
+	size_t Decode(const unsigned char* data, size_t size, unsigned char* out, size_t capacity);
+
+	// Decodes the <length> bytes of the original input starting at <offset> from the encoded file in the
+	// <size> bytes at <data>, and writes them to <out>
+	//
+	// Files written in blocks (see SetBlockSize) only decode the blocks the range overlaps: the block index
+	// says where each block starts, so every block boundary is a point decoding can start at. Framed files
+	// skip the frames before the range without decoding them. Single stream files have to be decoded from
+	// the start, but stop at the end of the range. Bytes past the end of the original input are ignored,
+	// and a <length> of UNKNOWN_LENGTH decodes to the end
+	void DecodeRange(const unsigned char* data, size_t size, unsigned long long offset, unsigned long long length, ByteSink& out);
+
+	// Returns: The size of the original input of the encoded file in the <size> bytes at <data>,
+	// or UNKNOWN_LENGTH for version 2 files and streams, which don't record it
+	// Throws: std::invalid_argument if it isn't a huffman file
+	static unsigned long long DecodedSize(const unsigned char* data, size_t size);
+
+	// Encodes everything left in <in> as a stream of frames and writes the encoded file to <out>
+	//
+	// The input is read, coded and written by a pipeline (see SetPipelined), so only a few blocks are
+	// in memory at once, however long the input is. The codes can't depend on the whole input: they
+	// come from the weights the encoder was built with, a dictionary, or every block (adaptive blocks).
+	// An encoder without weights or a dictionary switches to adaptive blocks. Context tables are ignored
+	//
+	// Returns: The number of bytes read from <in>
+	unsigned long long EncodeStream(std::istream& in, ByteSink& out);
+
+	// Decodes the encoded file in <in> and writes the original bytes to <out>
+	//
+	// Files written as frames are decoded by a pipeline as they are read. Other files need their
+	// index or don't record their length, so they are read into memory first
+	//
+	// Returns: The number of bytes read from <in>
+	unsigned long long DecodeStream(std::istream& in, ByteSink& out);
 
 	// Encodes the file at <input> with the pre-generated encoding table and writes to <output>
 	void EncodeFile(std::string input, std::string output, size_t& bytesRead, size_t& bytesWritten);
+	// Encodes the file at <input> with the pre-generated encoding table and writes the encoded file to <out>
+	void EncodeFile(std::string input, ByteSink& out, size_t& bytesRead);
 
 	// Decodes the input file to the specified output file
 	//
@@ -106,14 +306,199 @@ public:
 	//
 	// If this is undesired, a new Encoder must be constructed
 	void DecodeFile(std::string input, std::string output, size_t& bytesRead, size_t& bytesWritten);
+	// Decodes the file at <input> and writes the original bytes to <out>
+	void DecodeFile(std::string input, ByteSink& out, size_t& bytesRead);
+	// Decodes the <length> bytes of the original input starting at <offset> from the file at <input>
+	// and writes them to <out>. See DecodeRange
+	void DecodeFileRange(std::string input, unsigned long long offset, unsigned long long length, ByteSink& out, size_t& bytesRead);
+
+	// Sets the file format version written by EncodeFile. Must be VERSION or LEGACY_VERSION
+	void SetFormatVersion(unsigned short version);
+
+	// Limits the canonical codes used for version 3 files to at most <bits> bits, or 0 for no limit
+	//
+	// Codes that fit in HuffmanDecodeTable::ROOT_BITS always decode with a single table lookup
+	void SetMaxCodeLength(unsigned bits);
+
+	// Returns: The number of extra bits the code length limit added to the encoded data of the last
+	// version 3 file, compared to unlimited codes
+	unsigned long long LengthLimitCost() const;
+
+	// Sets the number of input bytes in each independently encoded block of version 3 files, or 0 for a single block
+	//
+	// Blocks are encoded in parallel, at the cost of some padding and an 8 byte index entry per block
+	void SetBlockSize(size_t bytes);
+
+	// If set to true, each block of a version 3 file is split into four interleaved bitstreams
+	//
+	// The decoder works on all four streams at once, so the lookups for one stream can overlap the
+	// others. This implies blocks, which are DEFAULT_BLOCK_SIZE bytes unless a block size was set
+	void SetInterleaved(bool enable);
+
+	// Codes each byte of version 3 files with one of up to <tables> code tables, picked by the byte
+	// before it, or 0 to use a single table
+	//
+	// Contexts with similar statistics share a table (see context::Cluster). The tables are built from
+	// the file being encoded, so this costs an extra pass over it. This implies blocks, which are
+	// DEFAULT_BLOCK_SIZE bytes unless a block size was set, and the context starts over in every block
+	void SetContextTables(unsigned tables);
+
+	// If set to true, every block of a version 3 file gets a code built from its own histogram, or is
+	// stored raw or run-length coded when that is smaller
+	//
+	// This suits inputs whose content changes along the way, like archives and logs with binary data
+	// in them. It implies blocks, which are DEFAULT_BLOCK_SIZE bytes unless a block size was set, and
+	// takes the place of context tables
+	void SetAdaptive(bool enable);
+
+	// Encodes version 3 files with the codes of the specified dictionary, and decodes files that refer to it
+	//
+	// Files encoded with a dictionary only store its ID, so neither the weights nor the code lengths
+	// need to be known per file. They can't use context tables or adaptive blocks, which build their
+	// own codes, and the decoder must be given the same dictionary
+	void SetDictionary(const dictionary::Dictionary& dictionary);
+
+	// If set to true, the blocks of version 3 files are coded with tANS (see ans) instead of Huffman codes
+	//
+	// tANS spends fractions of a bit on each byte, so it beats Huffman codes on skewed inputs, where the
+	// most common bytes carry well under a bit each. The distribution is normalized from the weights the
+	// encoder was built with. This implies blocks, which are DEFAULT_BLOCK_SIZE bytes unless a block size
+	// was set, and can't be combined with interleaved streams, context tables, adaptive blocks or a dictionary
+	void SetAns(bool enable);
+
+	// If set to true, version 3 files are written as a stream of frames by a pipeline: a reader thread,
+	// a coder on every thread and a writer, connected by bounded blocking queues of whole blocks
+	//
+	// Reading, coding and writing all overlap, and framed files can be decoded the same way as they are
+	// read, without their index. This implies blocks, which are DEFAULT_BLOCK_SIZE bytes unless a block
+	// size was set. Framed files are always decoded with a pipeline
+	void SetPipelined(bool enable);
+
+	// If set to true, version 3 files are run-length pre-transformed before they are coded, and expanded
+	// again after they are decoded
+	//
+	// Inputs with long runs of the same byte, like sparse dumps or padded records, otherwise take at least a
+	// bit per byte of every run, and every byte goes through the coder. The codes are built from the weights
+	// of the transformed input, which replace the weights the encoder was built with. The whole input is
+	// transformed before it is coded, so streams from standard input are read into memory first, and
+	// decoding a range of a file decodes the whole file
+	void SetRunTransform(bool enable);
+
+	// Sets the number of threads used to encode and decode blocks, or 0 for one per core
+	//
+	// Files without blocks are always encoded and decoded on a single thread
+	void SetThreads(unsigned threads);
+
+	// If set to true, files are decoded by walking the encoding tree one bit at a time
+	// instead of with the decoding table. This is much slower, and is only intended
+	// for verifying the output of the table-driven decoder
+	void SetReferenceDecoding(bool enable);
 
 private:
-	// The root of the encoding tree
-	HuffmanTreeNode* TreeRoot = nullptr;
+	// The size of the chunks the input file is read in when encoding
+	static const size_t INPUT_BUFFER_SIZE = 1 << 20;
+	// The size of the buffer decoded bytes are collected in before being written to the output file
+	static const size_t OUTPUT_BUFFER_SIZE = 1 << 20;
+
+	// The encoding tree, which is only built for version 2 files or read from one
+	HuffmanTree Tree;
+
+	// The mapping of the file the weights were counted from, so encoding it doesn't have to map it again
+	std::shared_ptr<MappedFile> Source;
+
+	// The weight table this encoder was constructed from
+	unsigned long long Weights[256] = {};
+	// Set to true if the weight table is known (the encoder was not built by decoding a file)
+	bool HasWeights = false;
+
+	// The file format version written by EncodeFile
+	unsigned short FormatVersion = VERSION;
+	// The file format version the codes were last built for
+	unsigned short CodesVersion = 0;
+
+	// The number of input bytes in each block, or 0 to encode the file as a single block
+	size_t BlockSize = 0;
+	// The number of threads used for blocks, or 0 for one per core
+	unsigned Threads = 0;
+	// Set to true to split each block into interleaved streams
+	bool Interleaved = false;
+	// The most context tables to code with, or 0 to code with a single table
+	unsigned MaxContextTables = 0;
+	// Set to true to give every block its own code
+	bool Adaptive = false;
+	// Set to true to write framed files with a pipeline
+	bool Pipelined = false;
+	// Set to true to code blocks with tANS instead of Huffman codes
+	bool UseAns = false;
+	// Set to true to run-length pre-transform the input before it is coded
+	bool RunTransform = false;
+
+	// Fills up to <size> bytes at <buffer> with the next bytes of an input, and returns how many it
+	// filled. Returns 0 once the input is exhausted
+	typedef std::function<size_t(unsigned char* buffer, size_t size)> Reader;
+
+	// An encoded block and the number of bytes it decodes to
+	struct Frame
+	{
+		// The encoded block
+		std::vector<unsigned char> Data;
+		// The number of bytes in the block before it was encoded
+		size_t Size = 0;
+		// The offset of the block in the original input
+		unsigned long long Offset = 0;
+	};
+
+	// The dictionary files are encoded with and decoded with, if HasDictionary is set
+	dictionary::Dictionary SharedDictionary = {};
+	// Set to true if a dictionary was given
+	bool HasDictionary = false;
+	// The canonical codes of the dictionary
+	unsigned long long DictionaryCodes[256] = {};
+	// The table used to decode files encoded with the dictionary, so it is only built once
+	HuffmanDecodeTable DictionaryTable;
+
+	// The tANS distribution of the last file encoded or decoded with FLAG_ANS
+	ans::Distribution AnsDistribution;
+	// The table used to encode blocks with tANS
+	ans::EncodeTable AnsEncoder;
+	// The table used to decode blocks coded with tANS
+	ans::DecodeTable AnsDecoder;
+
+	// The codes for one cluster of contexts
+	struct ContextTable
+	{
+		// The code for each byte, right-aligned
+		unsigned long long Codes[256];
+		// The length of the code for each byte in bits
+		unsigned char Lengths[256];
+		// The table used to decode the codes
+		HuffmanDecodeTable Decoder;
+	};
+
+	// The code tables of the last context-coded file, empty if it used a single table
+	std::vector<ContextTable> ContextTables;
+	// The index of the table that codes the bytes after each byte
+	unsigned char ContextMap[256] = {};
+
+	// The longest canonical code that may be built, or 0 for no limit
+	unsigned MaxCodeLength = 0;
+	// The number of extra bits the length limit costs for the weight table
+	unsigned long long LimitCost = 0;
 
 	// A table of bitstrings used for encoding
 	std::string EncodingTable[256] = {};
 
+	// The code for each byte, right-aligned, as an integer. Only valid for codes of up to 64 bits
+	unsigned long long Codes[256] = {};
+	// The length of the code for each byte in bits
+	unsigned char CodeLengths[256] = {};
+
+	// The table used to decode several bits at a time
+	HuffmanDecodeTable DecodeTable;
+
+	// If set to true, files are decoded with the tree walker instead of the decoding table
+	bool ReferenceDecoding = false;
+
 	// The longest bitstring, used for padding to the nearest byte when encoding the last byte of a file
 	std::string PaddingHint = "";
 
@@ -122,23 +507,127 @@ private:
 	// Set after a file is decoded, since the tree is replaced with the one in the file
 	bool IsDirty = true;
 
-	// Write the subtree from the specified node to the specified output stream
-	static void WriteEncodingTree(std::ostream& output, HuffmanTreeNode* node, size_t& bytesWritten);
-	// Read the subtree from the specified input stream
-	static HuffmanTreeNode* ReadEncodingTree(std::ifstream& reader, size_t& bytesRead);
+	// Write the subtree from the specified node of <tree> to the specified sink
+	static void WriteEncodingTree(ByteSink& out, const HuffmanTree& tree, unsigned short node);
+	// Read the subtree starting at <position> in the <size> bytes at <data> into <tree>, and return its index
+	static unsigned short ReadEncodingTree(const unsigned char* data, size_t size, size_t& position, HuffmanTree& tree);
 
-	// Decodes the bit from ubyte masked by the specified mask, moving the specified node pointer along the tree
-	static void DecodeBit(HuffmanTreeNode*& currentNode, unsigned char ubyte, unsigned char mask);
-	// Checks the specified node pointer, and if it is a leaf, writes its payload to the specified output stream
-	void WriteIfLeaf(std::ofstream& writer, HuffmanTreeNode*& currentNode, size_t& bytesWritten) const;
+	// Decodes the bit from ubyte masked by the specified mask, moving the specified node index along the tree
+	void DecodeBit(unsigned short& currentNode, unsigned char ubyte, unsigned char mask) const;
+	// Checks the specified node, and if it is a leaf, writes its payload to the specified sink
+	void WriteIfLeaf(ByteSink& out, unsigned short& currentNode) const;
 
-	// Builds the internal encoding tree from an array of nodes
-	void BuildTreeFromNodes(HuffmanTreeNode* nodes[256]);
+	// Decodes the <size> bytes at <data> by walking the encoding tree one bit at a time
+	void DecodeWithTree(const unsigned char* data, size_t size, ByteSink& out);
+	// Decodes the <size> bytes at <data> as independently encoded blocks, <length> bytes in total, and
+	// writes the original bytes from <first> up to (not including) <last> to <out>
+	void DecodeBlocks(const HuffmanDecodeTable& table, const unsigned char* data, size_t size, unsigned long long length, unsigned char flags, unsigned long long first, unsigned long long last, ByteSink& out) const;
+	// Decodes the <size> encoded bytes of a block at <data> into the <count> bytes at <out>
+	//
+	// Returns: false iff the block ran out of bits before <count> bytes were decoded
+	bool DecodeBlock(const HuffmanDecodeTable& table, const unsigned char* data, size_t size, unsigned char* out, size_t count, unsigned char flags) const;
+	// Decodes the bitstreams of a block with the specified table (or the context tables)
+	bool DecodeStreams(const HuffmanDecodeTable& table, const unsigned char* data, size_t size, unsigned char* out, size_t count, unsigned char flags) const;
+	// Decodes a block written by EncodeAdaptiveBlock
+	bool DecodeAdaptiveBlock(const unsigned char* data, size_t size, unsigned char* out, size_t count, unsigned char flags) const;
+	// Decodes <count> context-coded bytes into <out>, where byte i is read from readers[i % streams]
+	//
+	// Returns: false iff a stream ran out of bits before <count> bytes were decoded
+	bool DecodeContext(BitReader readers[], unsigned streams, unsigned char* out, size_t count) const;
+	// Decodes the frames from <read> with a pipeline and writes the original bytes from <first> up to (not
+	// including) <last> to <out>. If all of them are read, they must add up to <length> unless it is UNKNOWN_LENGTH
+	void DecodeFrames(const HuffmanDecodeTable& table, const Reader& read, unsigned long long length, unsigned char flags, size_t blockSize, unsigned long long first, unsigned long long last, ByteSink& out) const;
+	// Decodes the mapped (or otherwise readable) file and writes the original bytes to <out>
+	void DecodeSource(const MappedFile& source, ByteSink& out, size_t& bytesRead);
+	// Forgets the codes and tree of the encoder, before they are replaced by the ones in a file
+	void ResetCodes();
+	// Throws: std::invalid_argument if the flags of a version 3 file are unknown or don't make sense together
+	static void CheckFlags(unsigned char flags);
+	// Reads the codes of a version 3 file with the specified flags, and returns the table to decode it with
+	const HuffmanDecodeTable* ReadCodes(const unsigned char* data, size_t size, size_t& position, unsigned char flags);
+	// Throws: std::runtime_error if the runs written to <expanded> didn't expand to exactly <length> bytes
+	static void CheckExpanded(const runlength::ExpandingSink& expanded, unsigned long long length);
+	// Reads the header of a framed file, which is the <size> bytes at <data>, and returns the table to decode it with
+	const HuffmanDecodeTable* ReadFramedHeader(const unsigned char* data, size_t size, unsigned char flags, unsigned long long& length, unsigned long long& codedLength, size_t& blockSize);
+	// Decodes the <size> bytes at <data> with the specified decoding table, stopping after <count> bytes were written
+	void DecodeWithTable(const HuffmanDecodeTable& table, const unsigned char* data, size_t size, ByteSink& out, unsigned long long count) const;
+
+	// Builds an encoding tree in <tree> from the specified weights, with a leaf for every byte or only the used ones
+	static void BuildTree(const unsigned long long weights[256], bool everyByte, HuffmanTree& tree);
+	// Makes sure the codes are built for the file format version that will be written, from <weights> if they are needed
+	void PrepareCodes(const unsigned long long weights[256]);
+	// Makes the codes of the dictionary the current codes
+	void UseDictionaryCodes();
+	// Rebuilds the code lengths and canonical codes used for version 3 files from <weights>, if the encoder has weights
+	void BuildCanonicalCodes(const unsigned long long weights[256]);
+	// Builds the code lengths of a Huffman code for the specified weights, limited to MaxCodeLength
+	unsigned long long BuildLengths(const unsigned long long weights[256], unsigned char lengths[256]) const;
+	// Counts the byte pairs of the <size> bytes at <data> and builds the context map and context tables from them
+	void BuildContextTables(const unsigned char* data, size_t size, size_t blockSize);
+	// Writes the number of context tables, the context map and the code lengths of every table
+	void WriteContextTables(ByteSink& out) const;
+	// Reads the context tables written by WriteContextTables and builds their decoding tables
+	void ReadContextTables(const unsigned char* data, size_t size, size_t& position);
+	// Rebuilds the bitstring table, integer codes and padding hint from the encoding tree
+	void BuildEncodingTables();
 	// Populates the encoding table from the subtree at the specified node
-	void BuildEncodingTable(std::string bitstring, HuffmanTreeNode* node);
+	void BuildEncodingTable(std::string bitstring, unsigned short node);
+	// Populates <lengths> with the depth of every leaf in the subtree at the specified node of <tree>
+	static void BuildLengthTable(const HuffmanTree& tree, unsigned short node, unsigned length, unsigned char lengths[256]);
+	// Populates the integer codes and code lengths from the subtree at the specified node
+	void BuildCodeTable(unsigned short node, unsigned long long code, unsigned length);
+
+	// Appends the canonical code for a byte from the specified code table to the bit writer
+	static void PutCanonical(BitWriter& bits, const unsigned long long codes[256], const unsigned char lengths[256], unsigned char ubyte);
+	// Appends the code for a single byte to the specified bit writer
+	void PutCode(BitWriter& bits, unsigned char ubyte) const;
+	// Appends the codes for <size> bytes at <data> to the specified bit writer
+	void EncodeBytes(const unsigned char* data, size_t size, BitWriter& bits) const;
+	// Appends the codes of <size> bytes to <out>, where coder(bits, i) writes the code of byte i
+	template <typename Coder>
+	void EncodeStreams(size_t size, Coder coder, std::vector<unsigned char>& out) const;
+	// Encodes <size> bytes at <data> as a single block, replacing the contents of <out>
+	void EncodeBlock(const unsigned char* data, size_t size, std::vector<unsigned char>& out) const;
+	// Encodes <size> bytes at <data> as a block with its own code, or stores it raw or run-length coded
+	void EncodeAdaptiveBlock(const unsigned char* data, size_t size, std::vector<unsigned char>& out) const;
+	// Encodes the <size> bytes at <data> as independent blocks of <blockSize> bytes, followed by the block index
+	void EncodeBlocks(const unsigned char* data, size_t size, size_t blockSize, ByteSink& out) const;
+	// Encodes the input from <read> as frames of up to <blockSize> bytes with a pipeline, and returns its length
+	unsigned long long EncodeFrames(const Reader& read, size_t blockSize, ByteSink& out) const;
+	// Encodes the mapped (or otherwise readable) file and writes the encoded file to <out>
+	void EncodeSource(const MappedFile& source, ByteSink& out, size_t& bytesRead);
+	// Makes sure the codes are ready to encode with, building them from <weights> if they are needed
+	//
+	// <weights> are the encoder's own weights, unless the bytes that are coded were pre-transformed
+	void PrepareEncode(const unsigned long long weights[256]);
+	// Works out the flags of a version 3 file and builds the context tables it needs from the <size> bytes at <data>
+	unsigned char PrepareFlags(const unsigned char* data, size_t size, size_t blockSize, bool stream);
+	// Writes the header of a version 3 file, up to the encoded data
+	void WriteHeader(ByteSink& out, unsigned char flags, unsigned long long length, unsigned long long codedLength, size_t blockSize) const;
+	// Appends the pre-transformed <size> bytes at <data> to <out>, and counts their weights into <weights>
+	void TransformRuns(const unsigned char* data, size_t size, std::vector<unsigned char>& out, unsigned long long weights[256]) const;
+	// Writes whatever the decoder needs to rebuild the codes of a version 3 file with the specified flags
+	void WriteCodes(ByteSink& out, unsigned char flags) const;
+
+	// Writes a bitstring of any length to the specified bit writer
+	static void WriteBitstring(BitWriter& bits, const std::string& bitstring);
 
-	// Converts the specified 8-character string to a byte
-	// 
-	// The input string MUST be 8 characters, and can only consist of '0' and '1'
-	static unsigned char BitfieldToByte(std::string in);
+	// Writes a 4-byte big-endian integer to the specified sink
+	static void WriteUInt32(ByteSink& out, unsigned value);
+	// Reads a 4-byte big-endian integer from <position> in the <size> bytes at <data>
+	static unsigned ReadUInt32(const unsigned char* data, size_t size, size_t& position);
+	// Writes an 8-byte big-endian integer to the specified sink
+	static void WriteUInt64(ByteSink& out, unsigned long long value);
+	// Reads an 8-byte big-endian integer from <position> in the <size> bytes at <data>
+	static unsigned long long ReadUInt64(const unsigned char* data, size_t size, size_t& position);
+	// Reads the byte at <position> in the <size> bytes at <data>
+	static unsigned char ReadByte(const unsigned char* data, size_t size, size_t& position);
+	// Reads the rest of the specified stream into <contents>
+	static void ReadStream(std::istream& reader, std::vector<unsigned char>& contents);
+	// Returns: A reader over the <size> bytes at <data>
+	static Reader MemoryReader(const unsigned char* data, size_t size);
+	// Returns: A reader over the specified stream, which adds the number of bytes it reads to <bytesRead>
+	static Reader StreamReader(std::istream& in, unsigned long long& bytesRead);
+	// Reads from <read> until <size> bytes at <buffer> are filled or the input is exhausted, and returns how many were
+	static size_t ReadFully(const Reader& read, unsigned char* buffer, size_t size);
 };
@@ -0,0 +1,122 @@
+/*
+ * MappedFile.cpp - Implementation for read-only memory mapped input files
+ *
+ * Built for EECS2510 - Nonlinear Data Structures
+ *	at The University of Toledo, Spring 2016
+ *
+ * Copyright (c) 2016 Nathan Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "stdafx.h"
+#include <cstdint>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+
+// Opens and maps the file at the specified path
+MappedFile::MappedFile(const std::string& path) : path(path)
+{
+	auto handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) throw std::runtime_error("Unable to open file for read");
+
+	file = handle;
+
+	// Only regular files can be mapped
+	LARGE_INTEGER fileSize;
+	if (GetFileType(handle) != FILE_TYPE_DISK || !GetFileSizeEx(handle, &fileSize)) return;
+	if (static_cast<unsigned long long>(fileSize.QuadPart) > SIZE_MAX) return;
+
+	size = static_cast<size_t>(fileSize.QuadPart);
+
+	// Empty files can't be mapped, but there is nothing to read anyway
+	if (size == 0)
+	{
+		mapped = true;
+		return;
+	}
+
+	mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) return;
+
+	auto view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr) return;
+
+	data = static_cast<const unsigned char*>(view);
+	mapped = true;
+}
+
+MappedFile::~MappedFile()
+{
+	if (data != nullptr) UnmapViewOfFile(data);
+	if (mapping != nullptr) CloseHandle(mapping);
+	if (file != nullptr) CloseHandle(file);
+}
+
+#else
+
+// Opens and maps the file at the specified path
+MappedFile::MappedFile(const std::string& path) : path(path)
+{
+	descriptor = open(path.c_str(), O_RDONLY);
+	if (descriptor < 0) throw std::runtime_error("Unable to open file for read");
+
+	// Only regular files can be mapped
+	struct stat info;
+	if (fstat(descriptor, &info) != 0 || !S_ISREG(info.st_mode)) return;
+	if (static_cast<unsigned long long>(info.st_size) > SIZE_MAX) return;
+
+	size = static_cast<size_t>(info.st_size);
+
+	// Empty files can't be mapped, but there is nothing to read anyway
+	if (size == 0)
+	{
+		mapped = true;
+		return;
+	}
+
+	auto view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+	if (view == MAP_FAILED) return;
+
+	// Every pass reads the file front to back
+	madvise(view, size, MADV_SEQUENTIAL);
+
+	data = static_cast<const unsigned char*>(view);
+	mapped = true;
+}
+
+MappedFile::~MappedFile()
+{
+	if (data != nullptr) munmap(const_cast<unsigned char*>(data), size);
+	if (descriptor >= 0) close(descriptor);
+}
+
+#endif
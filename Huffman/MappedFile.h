@@ -0,0 +1,91 @@
+/*
+ * MappedFile.h - Read-only memory mapped input files
+ *
+ * Built for EECS2510 - Nonlinear Data Structures
+ *	at The University of Toledo, Spring 2016
+ *
+ * Copyright (c) 2016 Nathan Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+#include <string>
+
+// A file mapped read-only into memory
+//
+// Mapping the input lets every pass over it (counting byte weights, encoding) read
+// the same pages straight from the page cache without copying them into a buffer
+// or paying for a read call per chunk. Files that can't be mapped (pipes, devices)
+// can still be opened, but IsMapped() returns false and they must be read as a stream
+class MappedFile
+{
+public:
+	// Opens and maps the file at the specified path
+	//
+	// Throws: std::runtime_error if the file can't be opened
+	explicit MappedFile(const std::string& path);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Returns: true iff the contents of the file are available through Data()
+	bool IsMapped() const
+	{
+		return mapped;
+	}
+
+	// Returns: The contents of the file. May be null if the file is empty
+	const unsigned char* Data() const
+	{
+		return data;
+	}
+
+	// Returns: The size of the file in bytes
+	size_t Size() const
+	{
+		return size;
+	}
+
+	// Returns: The path the file was opened from
+	const std::string& Path() const
+	{
+		return path;
+	}
+
+private:
+	// The path the file was opened from
+	std::string path;
+	// The start of the mapping
+	const unsigned char* data = nullptr;
+	// The size of the file
+	size_t size = 0;
+	// Set to true if the file was mapped
+	bool mapped = false;
+
+#ifdef _WIN32
+	// The file and mapping handles
+	void* file = nullptr;
+	void* mapping = nullptr;
+#else
+	// The file descriptor
+	int descriptor = -1;
+#endif
+};
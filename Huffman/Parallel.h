@@ -0,0 +1,96 @@
+/*
+ * Parallel.h - Runs independent pieces of work on a group of worker threads
+ *
+ * Built for EECS2510 - Nonlinear Data Structures
+ *	at The University of Toledo, Spring 2016
+ *
+ * Copyright (c) 2016 Nathan Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace parallel
+{
+	// Returns: The number of threads to use for <requested> threads, where 0 means one per core
+	inline unsigned ThreadCount(unsigned requested)
+	{
+		if (requested != 0) return requested;
+
+		auto cores = std::thread::hardware_concurrency();
+		return cores == 0 ? 1 : cores;
+	}
+
+	// Calls body(i) for every i in [0, count), spreading the calls over up to <threads> threads
+	//
+	// The calling thread does its share of the work. Items are handed out one at a time, so
+	// items that take longer than others don't hold up the rest. If any call throws, no more
+	// items are started and the first exception is rethrown once every thread has stopped
+	inline void For(size_t count, unsigned threads, const std::function<void(size_t)>& body)
+	{
+		if (threads <= 1 || count <= 1)
+		{
+			for (size_t i = 0; i < count; i++) body(i);
+			return;
+		}
+
+		std::atomic<size_t> next(0);
+		std::exception_ptr error;
+		std::mutex errorLock;
+
+		auto worker = [&]()
+		{
+			while (true)
+			{
+				auto i = next++;
+				if (i >= count) return;
+
+				try
+				{
+					body(i);
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> guard(errorLock);
+					if (!error) error = std::current_exception();
+
+					// Don't start anything else
+					next = count;
+				}
+			}
+		};
+
+		std::vector<std::thread> pool;
+		auto helpers = static_cast<unsigned>(std::min<size_t>(threads, count)) - 1;
+		for (unsigned t = 0; t < helpers; t++) pool.emplace_back(worker);
+
+		worker();
+		for (auto& thread : pool) thread.join();
+
+		if (error) std::rethrow_exception(error);
+	}
+}
@@ -0,0 +1,232 @@
+/*
+ * Pipeline.h - Connects a reader, coders and a writer with bounded blocking queues
+ *
+ * Built for EECS2510 - Nonlinear Data Structures
+ *	at The University of Toledo, Spring 2016
+ *
+ * Copyright (c) 2016 Nathan Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace pipeline
+{
+	// A bounded queue with one thread pushing and one thread popping
+	//
+	// A side that finds the queue full or empty sleeps until the other side makes room or adds an
+	// item, or until its stop condition is met, so a pipeline waiting on slow input uses no CPU.
+	// Every item is a whole block, so the lock taken to move one in or out costs next to nothing
+	template <typename T>
+	class Queue
+	{
+	public:
+		// Construct a queue that holds up to <capacity> items
+		explicit Queue(size_t capacity) : slots(capacity) {}
+
+		// Moves <item> into the queue, waiting while it is full
+		//
+		// Returns: false iff <stop> returned true while the queue was full, in which case <item> is left alone
+		template <typename Stop>
+		bool Push(T& item, Stop stop)
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			changed.wait(guard, [&]() { return count < slots.size() || stop(); });
+			if (count == slots.size()) return false;
+
+			slots[(head + count) % slots.size()] = std::move(item);
+			count++;
+			changed.notify_all();
+			return true;
+		}
+
+		// Moves the oldest item in the queue into <item>, waiting while the queue is empty
+		//
+		// Returns: false iff <stop> returned true while the queue was empty
+		template <typename Stop>
+		bool Pop(T& item, Stop stop)
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			changed.wait(guard, [&]() { return count > 0 || stop(); });
+			if (count == 0) return false;
+
+			item = std::move(slots[head]);
+			head = (head + 1) % slots.size();
+			count--;
+			changed.notify_all();
+			return true;
+		}
+
+		// Wakes the threads waiting on the queue so they check their stop conditions again
+		//
+		// The lock is taken first, so a thread that is about to wait either sees the new condition
+		// or is already waiting when it is notified
+		void Wake()
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			changed.notify_all();
+		}
+
+	private:
+		// The items, as a ring starting at <head>
+		std::vector<T> slots;
+		// The oldest item in the queue
+		size_t head = 0;
+		// The number of items in the queue
+		size_t count = 0;
+		// Guards the ring
+		std::mutex lock;
+		// Signaled whenever an item is pushed or popped, or a stop condition may have changed
+		std::condition_variable changed;
+	};
+
+	// The number of items that may wait in each queue
+	const size_t QUEUE_DEPTH = 2;
+
+	// Runs read, code and write as a pipeline, so reading the input, coding it and writing the
+	// output all overlap
+	//
+	// read(Item&) fills the next item and returns false once there are none left. It runs on its
+	// own thread. code(Item&, Result&) turns an item into a result, on <coders> threads at once.
+	// write(Result&) runs on the calling thread and sees the results in the order the items were read.
+	//
+	// Every coder has its own input and output queue, and items are dealt to them round-robin. That
+	// keeps every queue single-producer and single-consumer, and lets the writer restore the order
+	// by taking from the output queues round-robin too. At most QUEUE_DEPTH items wait in each
+	// queue, so the memory used doesn't depend on the size of the input.
+	//
+	// If any stage throws, the other stages stop at their next item and the first exception is
+	// rethrown once every thread has stopped
+	template <typename Item, typename Result, typename Read, typename Code, typename Write>
+	void Run(unsigned coders, Read read, Code code, Write write)
+	{
+		if (coders == 0) coders = 1;
+
+		std::vector<std::unique_ptr<Queue<Item>>> inputs;
+		std::vector<std::unique_ptr<Queue<Result>>> outputs;
+		for (unsigned c = 0; c < coders; c++)
+		{
+			inputs.emplace_back(new Queue<Item>(QUEUE_DEPTH));
+			outputs.emplace_back(new Queue<Result>(QUEUE_DEPTH));
+		}
+
+		// The number of items read, once the reader has reached the end
+		std::atomic<size_t> total(SIZE_MAX);
+		std::atomic<bool> failed(false);
+		std::exception_ptr error;
+		std::mutex errorLock;
+
+		// Wakes every stage waiting on a queue, once the number of items is known or a stage failed
+		auto wakeAll = [&]()
+		{
+			for (auto& queue : inputs) queue->Wake();
+			for (auto& queue : outputs) queue->Wake();
+		};
+
+		auto fail = [&]()
+		{
+			{
+				std::lock_guard<std::mutex> guard(errorLock);
+				if (!error) error = std::current_exception();
+				failed = true;
+			}
+
+			wakeAll();
+		};
+
+		// Stops a stage waiting on a queue if another stage failed
+		auto stopped = [&]() { return failed.load(); };
+
+		std::vector<std::thread> threads;
+
+		threads.emplace_back([&]()
+		{
+			try
+			{
+				size_t count = 0;
+				Item item;
+				while (!failed && read(item))
+				{
+					if (!inputs[count % coders]->Push(item, stopped)) return;
+					count++;
+				}
+
+				total = count;
+				wakeAll();
+			}
+			catch (...)
+			{
+				fail();
+			}
+		});
+
+		for (unsigned c = 0; c < coders; c++)
+		{
+			threads.emplace_back([&, c]()
+			{
+				try
+				{
+					for (size_t i = c; ; i += coders)
+					{
+						Item item;
+						Result result;
+						if (!inputs[c]->Pop(item, [&]() { return failed || i >= total; })) return;
+
+						code(item, result);
+
+						if (!outputs[c]->Push(result, stopped)) return;
+					}
+				}
+				catch (...)
+				{
+					fail();
+				}
+			});
+		}
+
+		try
+		{
+			for (size_t i = 0; ; i++)
+			{
+				Result result;
+				if (!outputs[i % coders]->Pop(result, [&]() { return failed || i >= total; })) break;
+
+				write(result);
+			}
+		}
+		catch (...)
+		{
+			fail();
+		}
+
+		for (auto& thread : threads) thread.join();
+
+		if (error) std::rethrow_exception(error);
+	}
+}
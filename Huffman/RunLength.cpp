@@ -0,0 +1,256 @@
+/*
+ * RunLength.cpp - A simple byte-oriented run-length coding
+ *
+ * Built for EECS2510 - Nonlinear Data Structures
+ *	at The University of Toledo, Spring 2016
+ *
+ * Copyright (c) 2016 Nathan Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "stdafx.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "RunLength.h"
+
+namespace runlength
+{
+	// Returns: The number of bytes Encode would write for the <size> bytes at <data>
+	size_t EncodedSize(const unsigned char* data, size_t size)
+	{
+		size_t pairs = 0;
+		size_t i = 0;
+
+		while (i < size)
+		{
+			auto start = i++;
+			while (i < size && i - start < MAX_RUN && data[i] == data[start]) i++;
+			pairs++;
+		}
+
+		return 2 * pairs;
+	}
+
+	// Appends the run-length coded <size> bytes at <data> to <out>
+	void Encode(const unsigned char* data, size_t size, std::vector<unsigned char>& out)
+	{
+		size_t i = 0;
+
+		while (i < size)
+		{
+			auto start = i++;
+			while (i < size && i - start < MAX_RUN && data[i] == data[start]) i++;
+
+			out.push_back(data[start]);
+			out.push_back(static_cast<unsigned char>(i - start - 1));
+		}
+	}
+
+	// Decodes the <size> run-length coded bytes at <data> into the <count> bytes at <out>
+	bool Decode(const unsigned char* data, size_t size, unsigned char* out, size_t count)
+	{
+		if (size % 2 != 0) return false;
+
+		size_t produced = 0;
+		for (size_t i = 0; i < size; i += 2)
+		{
+			auto run = static_cast<size_t>(data[i + 1]) + 1;
+			if (run > count - produced) return false;
+
+			std::memset(out + produced, data[i], run);
+			produced += run;
+		}
+
+		return produced == count;
+	}
+
+	// Returns: The eight bytes at <bytes> as a little-endian integer, so the first byte is the lowest
+	static unsigned long long loadWord(const unsigned char* bytes)
+	{
+		// All of our targets are little-endian
+		unsigned long long value;
+		std::memcpy(&value, bytes, sizeof(value));
+
+		return value;
+	}
+
+	// Returns: A mask with the high bit of every byte of <value> that is zero set, and nothing else
+	static unsigned long long zeroBytes(unsigned long long value)
+	{
+		const auto low = 0x7F7F7F7F7F7F7F7FULL;
+		return ~(((value & low) + low) | value | low);
+	}
+
+	// Returns: The index of the lowest byte of <mask> with a bit set. <mask> must not be zero
+	static size_t lowestByte(unsigned long long mask)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, mask);
+		return index / 8;
+#else
+		return static_cast<size_t>(__builtin_ctzll(mask)) / 8;
+#endif
+	}
+
+	// Returns: The offset of the first run of TRANSFORM_MIN_RUN equal bytes in the <size> bytes at <data>,
+	// or <size> if there is none
+	//
+	// Eight bytes xor-ed with the eight bytes after them have a zero wherever a byte equals the next one,
+	// and a run of four starts wherever three of those zeros are in a row. That checks six places at a time
+	// without a branch per byte, so data without runs is skipped about as fast as it can be read
+	size_t FindRun(const unsigned char* data, size_t size)
+	{
+		static_assert(TRANSFORM_MIN_RUN == 4, "FindRun looks for three equal pairs in a row");
+
+		size_t i = 0;
+		while (size - i >= 9)
+		{
+			auto same = zeroBytes(loadWord(data + i) ^ loadWord(data + i + 1));
+			auto starts = same & (same >> 8) & (same >> 16);
+			if (starts != 0) return i + lowestByte(starts);
+
+			i += 6;
+		}
+
+		for (; i + TRANSFORM_MIN_RUN <= size; i++)
+		{
+			if (data[i] == data[i + 1] && data[i] == data[i + 2] && data[i] == data[i + 3]) return i;
+		}
+
+		return size;
+	}
+
+	// Returns: The number of bytes at the start of the <size> bytes at <data> that are equal to the first
+	//
+	// The bytes are compared eight at a time against the first byte repeated, and the first one that
+	// differs is the lowest non-zero byte of the difference
+	size_t RunLength(const unsigned char* data, size_t size)
+	{
+		if (size == 0) return 0;
+
+		auto pattern = data[0] * 0x0101010101010101ULL;
+
+		size_t i = 0;
+		while (size - i >= 8)
+		{
+			auto different = loadWord(data + i) ^ pattern;
+			if (different != 0) return i + lowestByte(different);
+
+			i += 8;
+		}
+
+		while (i < size && data[i] == data[0]) i++;
+		return i;
+	}
+
+	// Appends the pre-transformed <size> bytes at <data> to <out>
+	//
+	// Bytes between runs are copied in one go, and each run becomes its first TRANSFORM_MIN_RUN bytes and
+	// the number of repeats after them. A run longer than TRANSFORM_MAX_RUN simply carries on as a new run
+	void Transform(const unsigned char* data, size_t size, std::vector<unsigned char>& out)
+	{
+		size_t i = 0;
+		while (i < size)
+		{
+			auto literals = FindRun(data + i, size - i);
+			out.insert(out.end(), data + i, data + i + literals);
+			i += literals;
+
+			if (i == size) break;
+
+			auto run = RunLength(data + i, std::min(size - i, TRANSFORM_MAX_RUN));
+			out.insert(out.end(), TRANSFORM_MIN_RUN, data[i]);
+			out.push_back(static_cast<unsigned char>(run - TRANSFORM_MIN_RUN));
+			i += run;
+		}
+	}
+
+	// Undoes the pre-transform on the <size> bytes at <data>, and passes the original bytes on to the target
+	//
+	// Bytes up to and including the start of the next run are passed on as they are, found with the same
+	// search as the transform uses. Only the few bytes of a run that is split between writes, and the repeat
+	// counts, are handled one at a time
+	void ExpandingSink::write(const unsigned char* data, size_t size)
+	{
+		size_t i = 0;
+		while (i < size)
+		{
+			if (repeats == TRANSFORM_MIN_RUN)
+			{
+				// The byte after a run is the number of times it repeats
+				unsigned char fill[TRANSFORM_MAX_RUN - TRANSFORM_MIN_RUN];
+				auto count = static_cast<size_t>(data[i++]);
+
+				std::memset(fill, last, count);
+				emit(fill, count);
+
+				repeats = 0;
+				continue;
+			}
+
+			if (repeats > 0)
+			{
+				// Carry on with a run that started in the last write, unless this byte ends it
+				if (data[i] != last)
+				{
+					repeats = 0;
+					continue;
+				}
+
+				emit(data + i++, 1);
+				repeats++;
+				continue;
+			}
+
+			auto run = FindRun(data + i, size - i);
+			if (run < size - i)
+			{
+				emit(data + i, run + TRANSFORM_MIN_RUN);
+				last = data[i + run];
+				repeats = TRANSFORM_MIN_RUN;
+				i += run + TRANSFORM_MIN_RUN;
+				continue;
+			}
+
+			// There are no runs in the rest of the data, but the bytes at its end may start one that
+			// carries on in the next write
+			emit(data + i, size - i);
+			last = data[size - 1];
+			repeats = 1;
+			while (repeats < size - i && data[size - 1 - repeats] == last) repeats++;
+
+			i = size;
+		}
+	}
+
+	// Passes the <size> bytes at <data> on to the target as they are
+	void ExpandingSink::emit(const unsigned char* data, size_t size)
+	{
+		target.Write(data, size);
+		expanded += size;
+	}
+}
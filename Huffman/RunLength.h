@@ -0,0 +1,112 @@
+/*
+ * RunLength.h - A simple byte-oriented run-length coding
+ *
+ * Built for EECS2510 - Nonlinear Data Structures
+ *	at The University of Toledo, Spring 2016
+ *
+ * Copyright (c) 2016 Nathan Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+#include <vector>
+
+#include "ByteSink.h"
+
+// Run-length coding for blocks that are mostly long runs of the same byte
+//
+// The input is written as (byte, run length - 1) pairs, with runs of at most MAX_RUN bytes.
+// It's too simple to beat Huffman codes on most data, but it's cheap to size up front, and
+// it handles runs far better than a code of at least one bit per byte.
+//
+// The pre-transform is a gentler form for a whole input that is then Huffman coded: bytes are
+// kept as they are, except that after TRANSFORM_MIN_RUN equal bytes comes a single byte with the
+// number of times the byte repeats after them. Data without runs only grows by a byte for every
+// four equal bytes, and a long run shrinks to five bytes for every TRANSFORM_MAX_RUN
+namespace runlength
+{
+	// The longest run a single pair can hold
+	const size_t MAX_RUN = 256;
+
+	// Returns: The number of bytes Encode would write for the <size> bytes at <data>
+	size_t EncodedSize(const unsigned char* data, size_t size);
+
+	// Appends the run-length coded <size> bytes at <data> to <out>
+	void Encode(const unsigned char* data, size_t size, std::vector<unsigned char>& out);
+
+	// Decodes the <size> run-length coded bytes at <data> into the <count> bytes at <out>
+	//
+	// Returns: false iff the runs don't add up to exactly <count> bytes
+	bool Decode(const unsigned char* data, size_t size, unsigned char* out, size_t count);
+
+	// The number of equal bytes the pre-transform follows with a repeat count
+	const size_t TRANSFORM_MIN_RUN = 4;
+	// The longest run a single repeat count can hold
+	const size_t TRANSFORM_MAX_RUN = TRANSFORM_MIN_RUN + 255;
+
+	// Returns: The offset of the first run of TRANSFORM_MIN_RUN equal bytes in the <size> bytes at <data>,
+	// or <size> if there is none
+	size_t FindRun(const unsigned char* data, size_t size);
+
+	// Returns: The number of bytes at the start of the <size> bytes at <data> that are equal to the first
+	size_t RunLength(const unsigned char* data, size_t size);
+
+	// Appends the pre-transformed <size> bytes at <data> to <out>
+	void Transform(const unsigned char* data, size_t size, std::vector<unsigned char>& out);
+
+	// Undoes the pre-transform on everything written to it, and passes the original bytes on to another sink
+	//
+	// The transformed bytes can be written in pieces of any size, since a run that is cut off by the end
+	// of one write is picked up again by the next
+	class ExpandingSink : public ByteSink
+	{
+	public:
+		explicit ExpandingSink(ByteSink& target) : target(target) {}
+
+		// Returns: The number of original bytes passed on so far
+		unsigned long long BytesExpanded() const
+		{
+			return expanded;
+		}
+
+		// Returns: true iff the transformed bytes written so far end on a whole run, and not right
+		// before the repeat count of one
+		bool IsComplete() const
+		{
+			return repeats < TRANSFORM_MIN_RUN;
+		}
+
+	protected:
+		void write(const unsigned char* data, size_t size) override;
+
+	private:
+		// The sink the original bytes are written to
+		ByteSink& target;
+		// The last byte written
+		unsigned char last = 0;
+		// The number of times the last byte was written in a row, since the last repeat count
+		size_t repeats = 0;
+		// The number of original bytes passed on
+		unsigned long long expanded = 0;
+
+		// Passes the <size> bytes at <data> on to the target as they are
+		void emit(const unsigned char* data, size_t size);
+	};
+}
@@ -34,9 +34,13 @@ namespace verbose
 	// The implementation is defined in main.cpp so that multiple files can access this flag
 	extern bool enable;
 
-	// Write a verbose message to standard output if enabled
+	// The stream verbose messages are written to. This is standard output unless the encoded or
+	// decoded file is, in which case messages go to standard error instead
+	extern std::ostream* output;
+
+	// Write a verbose message to the verbose output if enabled
 	inline void write(std::string msg)
 	{
-		if (enable) std::cout << msg << std::endl;
+		if (enable) *output << msg << std::endl;
 	}
 }
@@ -30,9 +30,22 @@
 #include "stdafx.h"
 #include <iostream>
 #include <chrono>
+#include <cmath>
+#include <fstream>
 #include <iomanip>
+#include <iterator>
+#include <memory>
+#include <vector>
 
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "Batch.h"
+#include "ByteSink.h"
 #include "CommandLineOptions.h"
+#include "Dictionary.h"
 #include "HuffmanEncoder.h"
 #include "Verbose.h"
 
@@ -44,6 +57,7 @@ using namespace std;
 namespace verbose
 {
 	bool enable = false;
+	std::ostream* output = &std::cout;
 }
 
 // The encoder we'll use for encoding and decoding files
@@ -57,13 +71,27 @@ static const int EXIT_BAD_ARGUMENTS = -1;
 static const int EXIT_ENCODE_FAILED = -2;
 // The return code for a failed decoding job
 static const int EXIT_DECODE_FAILED = -3;
+// The return code for a failed training job
+static const int EXIT_TRAIN_FAILED = -4;
+// The return code for a failed batch
+static const int EXIT_BATCH_FAILED = -5;
+// The return code for a failed estimate
+static const int EXIT_ESTIMATE_FAILED = -6;
+
+// The input or output file name that stands for standard input or output
+static const string STANDARD_STREAM = "-";
 
 // Forward declare these methods so main is at the top as per project spec
 CommandLineOptions parseArguments(int argc, char* argv[]);
 string PrependExtension(string input, string extension);
+ostream& openOutput(string path, ofstream& file);
+void configureEncoder(HuffmanEncoder& target, const CommandLineOptions& options);
 void printHelp();
 bool doEncode(CommandLineOptions options);
 bool doDecode(CommandLineOptions options);
+bool doTrain(CommandLineOptions options);
+bool doBatch(CommandLineOptions options);
+bool doEstimate(CommandLineOptions options);
 
 // The main entry point of the application
 int main(int argc, char* argv[])
@@ -101,6 +129,9 @@ int main(int argc, char* argv[])
 	// Enable verbose if requested
 	if (options.verbose) verbose::enable = true;
 
+	// Messages can't share standard output with the file being written to it
+	if (options.output == STANDARD_STREAM) verbose::output = &cerr;
+
 	verbose::write(options.ToString());
 
 	// If the help flag was specified, print the help message and exit
@@ -114,19 +145,71 @@ int main(int argc, char* argv[])
 	if (options.parseError) return EXIT_BAD_ARGUMENTS;
 
 	// If neither encode nor decode modes were specified, exit
-	if (!(options.encode || options.decode))
+	if (!(options.encode || options.decode || options.train || options.estimate))
 	{
-		cout << "Nothing to do (specify one of -e, -d, or -t)" << endl;
+		cout << "Nothing to do (specify one of -e, -d, -t, -T, or -E)" << endl;
 		return EXIT_OK;
 	}
 
-	// If the input file or output file are blank, exit
-	if (options.input == "" || options.output == "")
+	// Training writes a dictionary, which can't be decoded
+	if (options.train && (options.encode || options.decode))
+	{
+		cout << "Training can't be combined with encoding or decoding" << endl;
+		return EXIT_BAD_ARGUMENTS;
+	}
+
+	// An estimate only reads the input, so it doesn't do anything else
+	if (options.estimate && (options.encode || options.decode || options.train || options.batch))
+	{
+		cout << "An estimate can't be combined with encoding, decoding, training or a batch" << endl;
+		return EXIT_BAD_ARGUMENTS;
+	}
+
+	// If the input file or output file are blank, exit. An estimate doesn't write anything
+	if (options.input == "" || (options.output == "" && !options.estimate))
 	{
 		cout << "Both the input and output files must be specified" << endl;
 		return EXIT_BAD_ARGUMENTS;
 	}
 
+	// A batch either encodes or decodes every file, from and to files on disk
+	if (options.batch && (options.encode == options.decode || options.range || options.input == STANDARD_STREAM || options.output == STANDARD_STREAM))
+	{
+		cout << "A batch needs exactly one of -e or -d, and files on disk to read and write" << endl;
+		return EXIT_BAD_ARGUMENTS;
+	}
+
+	// Ranges are picked out of the original input while decoding
+	if (options.range && (options.encode || !options.decode))
+	{
+		cout << "A range can only be given when decoding (-d)" << endl;
+		return EXIT_BAD_ARGUMENTS;
+	}
+
+	// The test mode reads back the file it encoded, so it can't be written to standard output
+	if (options.encode && options.decode && (options.input == STANDARD_STREAM || options.output == STANDARD_STREAM))
+	{
+		cout << "The test mode can't read from standard input or write to standard output" << endl;
+		return EXIT_BAD_ARGUMENTS;
+	}
+
+	// Standard input and output can't be mapped or seeked, so they are always coded as a stream of frames
+	if (options.input == STANDARD_STREAM || options.output == STANDARD_STREAM) options.pipelined = true;
+
+#ifdef _WIN32
+	// Encoded files are binary, so standard input and output must not translate line endings
+	if (options.input == STANDARD_STREAM) _setmode(_fileno(stdin), _O_BINARY);
+	if (options.output == STANDARD_STREAM) _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+	// Encode or decode a batch if specified
+	if (options.batch) return doBatch(options) ? EXIT_OK : EXIT_BATCH_FAILED;
+
+	// Estimate the size of the encoded input if specified
+	if (options.estimate) return doEstimate(options) ? EXIT_OK : EXIT_ESTIMATE_FAILED;
+
+	// Train a dictionary if specified
+	if (options.train && !doTrain(options)) return EXIT_TRAIN_FAILED;
 	// Perform an encode operation if specified
 	if (options.encode && !doEncode(options)) return EXIT_ENCODE_FAILED;
 	// Perform a decode operation if specified
@@ -143,27 +226,71 @@ bool doEncode(CommandLineOptions options)
 {
 	try
 	{
-		// Build the encoder from the input file and record how long that takes
+		auto fromStdin = options.input == STANDARD_STREAM;
+
+		// Standard input is encoded as it is read, with a dictionary or with codes built for every block,
+		// so memory use doesn't depend on its length. Version 2 files, context tables, tANS and the run-length
+		// pre-transform need the whole input, so for those it has to be read into memory first
+		auto streamed = fromStdin && options.formatVersion != HuffmanEncoder::LEGACY_VERSION && options.contextTables == 0 && !options.ans && !options.runs;
+		vector<unsigned char> contents;
+
+		// Build the encoder from the input file (or the dictionary, which needs no pass over it) and record how long that takes
 		auto ctor_start = chrono::system_clock::now();
-		encoder = HuffmanEncoder::InitializeFromFile(options.input);
+		if (options.dictionary != "") encoder = HuffmanEncoder::InitializeFromDictionary(dictionary::Load(options.dictionary), options.threads);
+		else if (streamed) encoder = new HuffmanEncoder();
+		else if (!fromStdin) encoder = HuffmanEncoder::InitializeFromFile(options.input, options.threads);
+		else
+		{
+			verbose::write("Reading standard input into memory to count its weights");
+			contents.assign(istreambuf_iterator<char>(cin), istreambuf_iterator<char>());
+			encoder = HuffmanEncoder::InitializeFromBuffer(contents.data(), contents.size(), options.threads);
+		}
 		auto ctor_end = chrono::system_clock::now();
 
+		configureEncoder(*encoder, options);
+		encoder->SetThreads(options.threads);
+
+		ofstream file;
+		auto& output = openOutput(options.output, file);
+		StreamSink sink(output);
+
 		size_t read = 0;
-		size_t written = 0;
 
 		// Encode the file and record how long that takes
 		auto encode_start = chrono::system_clock::now();
-		encoder->EncodeFile(options.input, options.output, read, written);
+		if (streamed) read = static_cast<size_t>(encoder->EncodeStream(cin, sink));
+		else if (fromStdin)
+		{
+			encoder->Encode(contents.data(), contents.size(), sink);
+			read = contents.size();
+		}
+		else encoder->EncodeFile(options.input, sink, read);
+		output.flush();
 		auto encode_end = chrono::system_clock::now();
 
+		auto written = sink.BytesWritten();
+
+		// Reports go to standard error if the encoded file is going to standard output
+		auto& report = options.output == STANDARD_STREAM ? cerr : cout;
+
 		// Calculate the compression ratio
 		auto ratio = static_cast<double>(written) / static_cast<double>(read);
 
-		cout << setiosflags(ios::fixed) << setprecision(3);
-		cout << "File encoded. In: " << read << " bytes, Out: " << written << " bytes. Ratio: " << ratio;
-		cout << "% Time: " << chrono::duration_cast<chrono::duration<float>>(ctor_end - ctor_start).count();
-		cout << "s initialization, " << chrono::duration_cast<chrono::duration<float>>(encode_end - encode_start).count();
-		cout << "s encode" << endl;
+		report << setiosflags(ios::fixed) << setprecision(3);
+		report << "File encoded. In: " << read << " bytes, Out: " << written << " bytes. Ratio: " << ratio;
+		report << "% Time: " << chrono::duration_cast<chrono::duration<float>>(ctor_end - ctor_start).count();
+		report << "s initialization, " << chrono::duration_cast<chrono::duration<float>>(encode_end - encode_start).count();
+		report << "s encode" << endl;
+
+		// Report what limiting the code lengths cost compared to the optimal codes
+		if (options.maxCodeLength != 0)
+		{
+			auto costBytes = (encoder->LengthLimitCost() + 7) / 8;
+			auto unlimitedRatio = static_cast<double>(written - costBytes) / static_cast<double>(read);
+
+			report << "Codes limited to " << options.maxCodeLength << " bits. Cost: " << costBytes << " bytes, Ratio: ";
+			report << ratio << " (" << unlimitedRatio << " unlimited)" << endl;
+		}
 	}
 	catch (exception& e)
 	{
@@ -195,17 +322,37 @@ bool doDecode(CommandLineOptions options)
 			outFile = PrependExtension(options.input, "hz");
 		}
 
+		encoder->SetReferenceDecoding(options.referenceDecoder);
+		encoder->SetThreads(options.threads);
+
+		// The encoder already has the dictionary if it encoded the file
+		if (options.dictionary != "" && !options.encode) encoder->SetDictionary(dictionary::Load(options.dictionary));
+
+		ofstream file;
+		auto& output = openOutput(outFile, file);
+		StreamSink sink(output);
+
 		size_t read = 0;
-		size_t written = 0;
 
 		// Decode the file and record how long that takes
 		auto start = chrono::system_clock::now();
-		encoder->DecodeFile(inFile, outFile, read, written);
+		if (options.range && inFile != STANDARD_STREAM) encoder->DecodeFileRange(inFile, options.rangeOffset, options.rangeLength, sink, read);
+		else if (options.range)
+		{
+			RangeSink range(sink, options.rangeOffset, options.rangeLength);
+			read = static_cast<size_t>(encoder->DecodeStream(cin, range));
+		}
+		else if (inFile == STANDARD_STREAM) read = static_cast<size_t>(encoder->DecodeStream(cin, sink));
+		else encoder->DecodeFile(inFile, sink, read);
+		output.flush();
 		auto end = chrono::system_clock::now();
 
-		cout << setiosflags(ios::fixed) << setprecision(3);
-		cout << "File decoded. In: " << read << " bytes, Out: " << written << " bytes, Time: ";
-		cout << chrono::duration_cast<chrono::duration<float>>(end - start).count() << "s" << endl;
+		// Reports go to standard error if the decoded file is going to standard output
+		auto& report = outFile == STANDARD_STREAM ? cerr : cout;
+
+		report << setiosflags(ios::fixed) << setprecision(3);
+		report << "File decoded. In: " << read << " bytes, Out: " << sink.BytesWritten() << " bytes, Time: ";
+		report << chrono::duration_cast<chrono::duration<float>>(end - start).count() << "s" << endl;
 	}
 	catch (exception& e)
 	{
@@ -216,6 +363,171 @@ bool doDecode(CommandLineOptions options)
 	return true;
 }
 
+// Train a dictionary from the files in the input directory using the specified options
+bool doTrain(CommandLineOptions options)
+{
+	try
+	{
+		// Count the bytes of every file in the corpus and record how long that takes
+		auto count_start = chrono::system_clock::now();
+		unsigned long long weights[256] = { 0 };
+		auto files = dictionary::CountCorpus(options.input, weights, options.threads);
+		auto count_end = chrono::system_clock::now();
+
+		unsigned long long bytes = 0;
+		for (auto weight : weights) bytes += weight;
+
+		if (files == 0) throw invalid_argument("There are no files in " + options.input);
+
+		HuffmanEncoder trainer(weights);
+		trainer.SetMaxCodeLength(options.maxCodeLength);
+		auto trained = trainer.BuildDictionary();
+		dictionary::Save(options.output, trained);
+
+		cout << setiosflags(ios::fixed) << setprecision(3);
+		cout << "Dictionary " << dictionary::FormatId(trained.Id) << " trained. Files: " << files << ", Bytes: " << bytes << ", Time: ";
+		cout << chrono::duration_cast<chrono::duration<float>>(count_end - count_start).count() << "s" << endl;
+	}
+	catch (exception& e)
+	{
+		cerr << "An error occurred while training: " << e.what() << endl;
+
+		return false;
+	}
+	return true;
+}
+
+// Report the size the input would encode to with the specified options, and its entropy, without encoding it
+//
+// Only the histogram of the input is counted and the codes built from it, so this takes about as long
+// as reading the input
+bool doEstimate(CommandLineOptions options)
+{
+	try
+	{
+		vector<unsigned char> contents;
+		HuffmanEncoder* estimator;
+
+		auto count_start = chrono::system_clock::now();
+		if (options.input == STANDARD_STREAM)
+		{
+			contents.assign(istreambuf_iterator<char>(cin), istreambuf_iterator<char>());
+			estimator = HuffmanEncoder::InitializeFromBuffer(contents.data(), contents.size(), options.threads);
+		}
+		else estimator = HuffmanEncoder::InitializeFromFile(options.input, options.threads);
+
+		unique_ptr<HuffmanEncoder> owner(estimator);
+		configureEncoder(*estimator, options);
+		if (options.dictionary != "") estimator->SetDictionary(dictionary::Load(options.dictionary));
+
+		auto estimate = estimator->Estimate();
+		auto count_end = chrono::system_clock::now();
+
+		auto ratio = estimate.InputBytes == 0 ? 0.0 : static_cast<double>(estimate.EncodedBytes) / static_cast<double>(estimate.InputBytes);
+		auto entropyRatio = estimate.InputBytes == 0 ? 0.0 : estimate.EntropyBytes / static_cast<double>(estimate.InputBytes);
+
+		cout << setiosflags(ios::fixed) << setprecision(3);
+		cout << "File estimated. In: " << estimate.InputBytes << " bytes, Out: " << (estimate.Exact ? "" : options.ans ? "about " : "at most ") << estimate.EncodedBytes;
+		cout << " bytes. Ratio: " << ratio << "% Time: " << chrono::duration_cast<chrono::duration<float>>(count_end - count_start).count() << "s" << endl;
+		cout << "Entropy: " << static_cast<unsigned long long>(ceil(estimate.EntropyBytes)) << " bytes (" << 8 * entropyRatio << " bits per byte). Ratio: " << entropyRatio << "%" << endl;
+		cout << "Compressible: " << (estimate.EncodedBytes < estimate.InputBytes ? "yes" : "no") << endl;
+	}
+	catch (exception& e)
+	{
+		cerr << "An error occurred while estimating: " << e.what() << endl;
+
+		return false;
+	}
+	return true;
+}
+
+// Encode or decode every file of a batch using the specified options
+bool doBatch(CommandLineOptions options)
+{
+	try
+	{
+		dictionary::Dictionary shared;
+		auto hasDictionary = options.dictionary != "";
+		if (hasDictionary) shared = dictionary::Load(options.dictionary);
+
+		// Every file gets its own encoder, set up the same way a single file's would be. The batch
+		// is spread over the threads, so each encoder only uses one
+		batch::Factory factory;
+		if (options.encode)
+		{
+			factory = [&](const unsigned char* data, size_t size)
+			{
+				auto fileEncoder = hasDictionary ? HuffmanEncoder::InitializeFromDictionary(shared, 1) : HuffmanEncoder::InitializeFromBuffer(data, size, 1);
+				configureEncoder(*fileEncoder, options);
+				return fileEncoder;
+			};
+		}
+		else
+		{
+			factory = [&](const unsigned char*, size_t)
+			{
+				auto fileDecoder = new HuffmanEncoder();
+				fileDecoder->SetReferenceDecoding(options.referenceDecoder);
+				if (hasDictionary) fileDecoder->SetDictionary(shared);
+				return fileDecoder;
+			};
+		}
+
+		// Code the batch and record how long that takes
+		auto start = chrono::system_clock::now();
+		batch::Totals totals;
+		if (options.encode && options.archive) totals = batch::EncodeToArchive(batch::ListInputs(options.input), options.output, factory, options.threads);
+		else if (options.encode) totals = batch::EncodeToDirectory(batch::ListInputs(options.input), options.output, factory, options.threads);
+		else if (options.archive) totals = batch::ExtractArchive(options.input, options.output, factory, options.threads);
+		else totals = batch::DecodeToDirectory(batch::ListInputs(options.input), options.output, factory, options.threads);
+		auto end = chrono::system_clock::now();
+
+		// Throughput is measured in original bytes, whichever way the batch went
+		auto seconds = chrono::duration_cast<chrono::duration<double>>(end - start).count();
+		auto original = options.encode ? totals.BytesRead : totals.BytesWritten;
+		auto encoded = options.encode ? totals.BytesWritten : totals.BytesRead;
+		auto ratio = original == 0 ? 0.0 : static_cast<double>(encoded) / static_cast<double>(original);
+		auto throughput = seconds > 0 ? static_cast<double>(original) / seconds / 1000000 : 0.0;
+
+		cout << setiosflags(ios::fixed) << setprecision(3);
+		cout << "Batch " << (options.encode ? "encoded" : "decoded") << ". Files: " << totals.Files << ", In: " << totals.BytesRead;
+		cout << " bytes, Out: " << totals.BytesWritten << " bytes. Ratio: " << ratio << " Time: " << seconds << "s, Throughput: ";
+		cout << throughput << " MB/s" << endl;
+	}
+	catch (exception& e)
+	{
+		cerr << "An error occurred while coding the batch: " << e.what() << endl;
+
+		return false;
+	}
+	return true;
+}
+
+// Applies the encoding settings of the specified options to <target>
+void configureEncoder(HuffmanEncoder& target, const CommandLineOptions& options)
+{
+	if (options.formatVersion != 0) target.SetFormatVersion(options.formatVersion);
+	target.SetMaxCodeLength(options.maxCodeLength);
+	target.SetBlockSize(options.blockSize);
+	target.SetInterleaved(options.interleaved);
+	target.SetContextTables(options.contextTables);
+	target.SetAdaptive(options.adaptive);
+	target.SetAns(options.ans);
+	target.SetRunTransform(options.runs);
+	target.SetPipelined(options.pipelined);
+}
+
+// Returns: Standard output if <path> is STANDARD_STREAM, otherwise <file> opened for writing at <path>
+ostream& openOutput(string path, ofstream& file)
+{
+	if (path == STANDARD_STREAM) return cout;
+
+	file.open(path, ios::binary);
+	if (!file.is_open() || !file.good()) throw runtime_error("Cannot open file for write");
+
+	return file;
+}
+
 // Prepend the specified extension before the actual extension of the input string
 // Example: PrependExtension("test.txt", "hz")  returns "test.hz.txt"
 string PrependExtension(string input, string extension)
@@ -233,7 +545,10 @@ string PrependExtension(string input, string extension)
 void printHelp()
 {
 	cout << "Huffman Encoder and Decoder" << endl;
-	cout << "Usage: huffman <options> -i <input_file> -o <output_file>" << endl << endl;
+	cout << "Usage: huffman <options> -i <input_file> -o <output_file>" << endl;
+	cout << "       huffman -T -i <corpus_directory> -o <dictionary_file> [-l <n>]" << endl;
+	cout << "       huffman -B [-A] -e|-d <options> -i <input_directory_or_list> -o <output_directory_or_archive>" << endl;
+	cout << "       huffman -E <options> -i <input_file>" << endl << endl;
 
 	cout << "Options:" << endl;
 	cout << "\t-i, --input\tSpecifies the input file to encode or decode" << endl;
@@ -241,8 +556,27 @@ void printHelp()
 	cout << "\t-e, --encode\tEncode <input_file> and write to <output_file>" << endl;
 	cout << "\t-d, --decode\tDecode <input_file> and write to <output_file>" << endl;
 	cout << "\t-t, --test\tEncode <input_file> to <output>.hz, then decode back to <output_file>" << endl;
+	cout << "\t-T, --train\tBuild a dictionary from the files in <corpus_directory> and write it to <dictionary_file>" << endl;
+	cout << "\t-E, --estimate\tReport the size <input_file> would encode to with the other options, and its entropy, without encoding it" << endl;
+	cout << "\t-B, --batch\tEncode every file in the <input> directory (or listed one per line in the <input> file) into the <output> directory (created if needed), or decode them back" << endl;
+	cout << "\t-A, --archive\tWith -B, encode the files into a single archive at <output>, or extract the archive at <input> into the <output> directory" << endl;
+	cout << "\t-D, --dictionary\tEncode with the codes of <dictionary_file> instead of counting the input, or decode a file encoded with it" << endl;
+	cout << "\t-f, --format\tEncode with file format version 2 (stores the whole tree) or 3 (canonical codes, the default)" << endl;
+	cout << "\t-b, --block-size\tSplit the input into blocks of <n> KB that are encoded in parallel" << endl;
+	cout << "\t-s, --streams\tSplit each block into four interleaved streams that decode faster (implies blocks)" << endl;
+	cout << "\t-c, --context\tCode each byte with one of up to <n> code tables picked by the byte before it (1-256, implies blocks)" << endl;
+	cout << "\t-a, --adaptive\tGive every block its own code, or store it raw or run-length coded when that is smaller (implies blocks)" << endl;
+	cout << "\t-n, --ans\tCode blocks with tANS instead of Huffman codes, which spends fractions of a bit on common bytes (implies blocks)" << endl;
+	cout << "\t-u, --runs\tRun-length pre-transform the input before coding it, which shrinks long runs of the same byte" << endl;
+	cout << "\t-p, --pipeline\tRead, encode and write blocks at the same time, as a stream of frames (implies blocks)" << endl;
+	cout << "\t-j, --threads\tCount byte weights, encode and decode blocks on <n> threads (default: one per core)" << endl;
+	cout << "\t-l, --max-code-length\tLimit codes to at most <n> bits (11 or less decodes with a single table lookup)" << endl;
+	cout << "\t-R, --range\tOnly decode the <length> bytes of the original file starting at <offset>, given as <offset>:<length> or <offset>: for the rest" << endl;
+	cout << "\t-r, --reference\tDecode by walking the tree one bit at a time (slow, for verification)" << endl;
 	cout << "\t-v, --verbose\tPrint verbose messages" << endl;
-	cout << "\t-h, --help\tPrint this help message" << endl;
+	cout << "\t-h, --help\tPrint this help message" << endl << endl;
+	cout << "Use - as <input_file> or <output_file> to read from standard input or write to standard output (implies -p)" << endl;
+	cout << "Standard input is encoded as it is read, with the dictionary or codes for every block, unless -f 2, -c or -n is given" << endl;
 }
 
 // Processes the command-line arguments and returns a CommandLineOptions struct
@@ -265,6 +599,191 @@ CommandLineOptions parseArguments(int argc, char* argv[])
 		{
 			result.encode = result.decode = true;
 		}
+		else if(arg == "-T" || arg == "--train")
+		{
+			result.train = true;
+		}
+		else if(arg == "-E" || arg == "--estimate")
+		{
+			result.estimate = true;
+		}
+		else if(arg == "-B" || arg == "--batch")
+		{
+			result.batch = true;
+		}
+		else if(arg == "-A" || arg == "--archive")
+		{
+			result.batch = result.archive = true;
+		}
+		else if(arg == "-D" || arg == "--dictionary")
+		{
+			if (i >= argc - 1)
+			{
+				result.parseError = true;
+				cout << "Missing Parameter for " << argv[i] << endl;
+			}
+			else
+			{
+				result.dictionary = string(argv[++i]);
+			}
+		}
+		else if(arg == "-f" || arg == "--format")
+		{
+			if (i >= argc - 1)
+			{
+				result.parseError = true;
+				cout << "Missing Parameter for " << argv[i] << endl;
+			}
+			else
+			{
+				auto version = string(argv[++i]);
+				if (version == "2" || version == "3")
+				{
+					result.formatVersion = static_cast<unsigned>(stoul(version));
+				}
+				else
+				{
+					result.parseError = true;
+					cout << "Unsupported file format version: " << version << endl;
+				}
+			}
+		}
+		else if(arg == "-b" || arg == "--block-size")
+		{
+			if (i >= argc - 1)
+			{
+				result.parseError = true;
+				cout << "Missing Parameter for " << argv[i] << endl;
+			}
+			else
+			{
+				auto kilobytes = string(argv[++i]);
+				if (kilobytes.find_first_not_of("0123456789") == string::npos && kilobytes.length() > 0 && kilobytes.length() <= 7)
+				{
+					result.blockSize = static_cast<size_t>(stoul(kilobytes)) * 1024;
+				}
+				else
+				{
+					result.parseError = true;
+					cout << "Invalid block size: " << kilobytes << endl;
+				}
+			}
+		}
+		else if(arg == "-s" || arg == "--streams")
+		{
+			result.interleaved = true;
+		}
+		else if(arg == "-c" || arg == "--context")
+		{
+			if (i >= argc - 1)
+			{
+				result.parseError = true;
+				cout << "Missing Parameter for " << argv[i] << endl;
+			}
+			else
+			{
+				auto tables = string(argv[++i]);
+				if (tables.find_first_not_of("0123456789") == string::npos && tables.length() > 0 && tables.length() <= 3 && stoul(tables) >= 1 && stoul(tables) <= 256)
+				{
+					result.contextTables = static_cast<unsigned>(stoul(tables));
+				}
+				else
+				{
+					result.parseError = true;
+					cout << "Invalid number of context tables: " << tables << endl;
+				}
+			}
+		}
+		else if(arg == "-a" || arg == "--adaptive")
+		{
+			result.adaptive = true;
+		}
+		else if(arg == "-n" || arg == "--ans")
+		{
+			result.ans = true;
+		}
+		else if(arg == "-u" || arg == "--runs")
+		{
+			result.runs = true;
+		}
+		else if(arg == "-p" || arg == "--pipeline")
+		{
+			result.pipelined = true;
+		}
+		else if(arg == "-j" || arg == "--threads")
+		{
+			if (i >= argc - 1)
+			{
+				result.parseError = true;
+				cout << "Missing Parameter for " << argv[i] << endl;
+			}
+			else
+			{
+				auto threads = string(argv[++i]);
+				if (threads.find_first_not_of("0123456789") == string::npos && threads.length() > 0 && threads.length() <= 4)
+				{
+					result.threads = static_cast<unsigned>(stoul(threads));
+				}
+				else
+				{
+					result.parseError = true;
+					cout << "Invalid thread count: " << threads << endl;
+				}
+			}
+		}
+		else if(arg == "-l" || arg == "--max-code-length")
+		{
+			if (i >= argc - 1)
+			{
+				result.parseError = true;
+				cout << "Missing Parameter for " << argv[i] << endl;
+			}
+			else
+			{
+				auto bits = string(argv[++i]);
+				if (bits.find_first_not_of("0123456789") == string::npos && bits.length() > 0 && bits.length() <= 2)
+				{
+					result.maxCodeLength = static_cast<unsigned>(stoul(bits));
+				}
+				else
+				{
+					result.parseError = true;
+					cout << "Invalid code length: " << bits << endl;
+				}
+			}
+		}
+		else if(arg == "-R" || arg == "--range")
+		{
+			if (i >= argc - 1)
+			{
+				result.parseError = true;
+				cout << "Missing Parameter for " << argv[i] << endl;
+			}
+			else
+			{
+				auto range = string(argv[++i]);
+				auto colon = range.find(':');
+				auto offset = range.substr(0, colon);
+				auto length = colon == string::npos ? "" : range.substr(colon + 1);
+				auto isNumber = [](const string& s) { return s.find_first_not_of("0123456789") == string::npos && s.length() > 0 && s.length() <= 19; };
+
+				if (colon != string::npos && isNumber(offset) && (length == "" || isNumber(length)))
+				{
+					result.range = true;
+					result.rangeOffset = stoull(offset);
+					if (length != "") result.rangeLength = stoull(length);
+				}
+				else
+				{
+					result.parseError = true;
+					cout << "Invalid range: " << range << endl;
+				}
+			}
+		}
+		else if(arg == "-r" || arg == "--reference")
+		{
+			result.referenceDecoder = true;
+		}
 		else if(arg == "-v" || arg == "--verbose")
 		{
 			result.verbose = true;
@@ -0,0 +1,535 @@
+/*
+ * HuffmanBenchmarks.cpp - Benchmarks for the Huffman codec and its kernels
+ *
+ * Built for EECS2510 - Nonlinear Data Structures
+ *	at The University of Toledo, Spring 2016
+ *
+ * Copyright (c) 2016 Nathan Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "stdafx.h"
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "BitReader.h"
+#include "BitWriter.h"
+#include "CanonicalCode.h"
+#include "DecodeTable.h"
+#include "Dictionary.h"
+#include "Histogram.h"
+#include "HuffmanEncoder.h"
+#include "Options.h"
+#include "Parallel.h"
+#include "Verbose.h"
+
+using namespace std;
+
+// The codec reports what it's doing through the verbose namespace, which the benchmarks keep quiet
+namespace verbose
+{
+	bool enable = false;
+	std::ostream* output = &std::cout;
+}
+
+// Where the text corpora are looked for when no files are given, from the project and solution directories
+static const char* DEFAULT_CORPORA[] = { "../TreeBenchmarks/Test Files", "TreeBenchmarks/Test Files" };
+
+// The file the encoded inputs are written to and read back from to time I/O
+static const char* SCRATCH_FILE = "HuffmanBenchmarks.tmp";
+
+// An input the benchmarks are run against
+struct BenchmarkInput
+{
+	// The name reported for the input
+	string name;
+	// The contents of the input
+	vector<unsigned char> data;
+};
+
+// Forward-declare the functions so main can be at the top of the file as required
+void printHelp();
+vector<BenchmarkInput> loadInputs(const Options& options);
+int runHistogramBenchmarks(const Options& options);
+int runCodecBenchmarks(const Options& options);
+int runKernelBenchmarks(const Options& options);
+void encodeStreams(const unsigned char* data, size_t size, const unsigned long long codes[256], const unsigned char lengths[256], vector<vector<unsigned char>>& streams);
+double bestTime(size_t trials, const function<void()>& body);
+double gigabytesPerSecond(size_t bytes, double milliseconds);
+double megabytesPerSecond(size_t bytes, double milliseconds);
+
+int main(int argc, char* argv[])
+{
+	// parse the command-line arguments
+	auto opts = Options(argc, argv);
+
+	if (opts.help)
+	{
+		printHelp();
+	}
+	else if(opts.errors)
+	{
+		cout << "One or more errors occurred while parsing arguments: " << endl;
+		cout << opts.errorMessage;
+		cout << endl;
+		cout << "Call with --help for help" << endl;
+
+		return -1;
+	}
+	else if(opts.histogram || opts.codec || opts.kernels)
+	{
+		if (opts.histogram && runHistogramBenchmarks(opts) != 0) return -1;
+		if (opts.codec && runCodecBenchmarks(opts) != 0) return -1;
+		if (opts.kernels && runKernelBenchmarks(opts) != 0) return -1;
+	}
+	else
+	{
+		printHelp();
+	}
+
+	return 0;
+}
+
+void printHelp()
+{
+	cout << "HuffmanBenchmarks <-g|-e|-k> [-f path]... [-d directory]... [-s size] [-b size] [-t trials] [-j threads] [-c [-n]]" << endl;
+	cout << "Parameters:" << endl;
+	cout << "\t-g, --histogram\t\tBenchmark the byte histogram kernels" << endl;
+	cout << "\t-e, --codec\t\tBenchmark encoding and decoding, phase by phase" << endl;
+	cout << "\t-k, --kernels\t\tBenchmark the decoding kernel for every root table width, with one and four streams" << endl;
+	cout << "\t-f, --file\t\tAlso benchmark against the specified file (may be repeated)" << endl;
+	cout << "\t-d, --directory\t\tAlso benchmark against every file in the specified directory (may be repeated)" << endl;
+	cout << "\t-b, --block-size\tEncode in blocks of the specified number of KB in the codec benchmarks" << endl;
+	cout << "\t-s, --size\t\tThe size of each synthetic input in MB (default 64)" << endl;
+	cout << "\t-t, --trials\t\tThe number of times to run each benchmark (default 5)" << endl;
+	cout << "\t-j, --threads\t\tThe number of threads for multi-threaded kernels (default one per core)" << endl;
+	cout << "\t-c, --csv\t\tOutput data in CSV Format" << endl;
+	cout << "\t-n, --no-headers\tDon't include headers in CSV. Implies -c" << endl;
+
+	cout << endl;
+
+	cout << "Every benchmark runs against four synthetic inputs: uniformly random bytes, bytes" << endl;
+	cout << "with a skewed (geometric) distribution, a single repeated byte, and random binary" << endl;
+	cout << "data (random bits packed into bytes, with long runs of zeros). Each benchmark is run" << endl;
+	cout << "several times and the fastest run is reported." << endl;
+	cout << endl;
+	cout << "If no files or directories are given, the codec and kernel benchmarks also run against the text" << endl;
+	cout << "corpora in TreeBenchmarks/Test Files." << endl;
+}
+
+// Generates the synthetic inputs and loads any files specified on the command line
+vector<BenchmarkInput> loadInputs(const Options& options)
+{
+	vector<BenchmarkInput> inputs;
+	auto size = options.SyntheticSize << 20;
+
+	// Always use the same seed so runs are comparable
+	mt19937 random(2510);
+
+	BenchmarkInput uniform{ "uniform", vector<unsigned char>(size) };
+	uniform_int_distribution<int> anyByte(0, 255);
+	for (auto& b : uniform.data) b = static_cast<unsigned char>(anyByte(random));
+	inputs.push_back(move(uniform));
+
+	// Each byte is half as likely as the one before it
+	BenchmarkInput skewed{ "skewed", vector<unsigned char>(size) };
+	geometric_distribution<int> halving(0.5);
+	for (auto& b : skewed.data) b = static_cast<unsigned char>(min(halving(random), 255));
+	inputs.push_back(move(skewed));
+
+	inputs.push_back(BenchmarkInput{ "single", vector<unsigned char>(size, 'a') });
+
+	// Like a typical executable or object file: stretches of random bytes between runs of zeros
+	BenchmarkInput binary{ "binary", vector<unsigned char>(size) };
+	uniform_int_distribution<int> stretch(1, 64);
+	for (size_t i = 0; i < size; )
+	{
+		auto zeros = (i / 64) % 2 == 0;
+		auto end = min(size, i + static_cast<size_t>(stretch(random)));
+		for (; i < end; i++) binary.data[i] = zeros ? 0 : static_cast<unsigned char>(anyByte(random));
+	}
+	inputs.push_back(move(binary));
+
+	auto paths = options.TestFilePaths;
+	auto directories = options.TestDirectories;
+
+	// The codec and kernel benchmarks always cover real text, so fall back to the tree benchmark corpora
+	if ((options.codec || options.kernels) && paths.empty() && directories.empty())
+	{
+		for (auto corpus : DEFAULT_CORPORA)
+		{
+			ifstream probe(string(corpus) + "/Hamlet.txt");
+			if (probe.good())
+			{
+				directories.push_back(corpus);
+				break;
+			}
+		}
+	}
+
+	for (auto& directory : directories)
+	{
+		try
+		{
+			auto files = dictionary::ListFiles(directory);
+			paths.insert(paths.end(), files.begin(), files.end());
+		}
+		catch (exception& e)
+		{
+			cerr << e.what() << endl;
+		}
+	}
+
+	for (auto& path : paths)
+	{
+		ifstream reader(path, ios::binary);
+		if (!reader.good())
+		{
+			cerr << "Unable to open " << path << " for read" << endl;
+			continue;
+		}
+
+		BenchmarkInput file{ path, vector<unsigned char>(istreambuf_iterator<char>(reader), istreambuf_iterator<char>()) };
+		inputs.push_back(move(file));
+	}
+
+	return inputs;
+}
+
+// Benchmark the byte histogram kernels against every input
+int runHistogramBenchmarks(const Options& options)
+{
+	auto inputs = loadInputs(options);
+	auto threads = parallel::ThreadCount(options.Threads);
+
+	if (options.csvMode && !options.noHeaders)
+	{
+		cout << "Input,Bytes,SimpleGBps,BankedGBps,ThreadedGBps,Threads" << endl;
+	}
+
+	for (auto& input : inputs)
+	{
+		auto data = input.data.data();
+		auto size = input.data.size();
+
+		unsigned long long simple[256] = {};
+		unsigned long long banked[256] = {};
+		unsigned long long threaded[256] = {};
+
+		auto simpleTime = bestTime(options.Trials, [&]()
+		{
+			fill(simple, simple + 256, 0);
+			histogram::CountSimple(data, size, simple);
+		});
+		auto bankedTime = bestTime(options.Trials, [&]()
+		{
+			fill(banked, banked + 256, 0);
+			histogram::Count(data, size, banked);
+		});
+		auto threadedTime = bestTime(options.Trials, [&]()
+		{
+			fill(threaded, threaded + 256, 0);
+			histogram::Count(data, size, threaded, threads);
+		});
+
+		// The faster kernels are only useful if they get the same answer
+		if (!equal(simple, simple + 256, banked) || !equal(simple, simple + 256, threaded))
+		{
+			cerr << "Histogram kernels disagree on " << input.name << endl;
+			return -1;
+		}
+
+		if (options.csvMode)
+		{
+			cout << '"' << input.name << "\"," << size << ',';
+			cout << gigabytesPerSecond(size, simpleTime) << ',' << gigabytesPerSecond(size, bankedTime) << ',';
+			cout << gigabytesPerSecond(size, threadedTime) << ',' << threads << endl;
+		}
+		else
+		{
+			cout << "Histogram of \"" << input.name << "\" (" << size << " bytes): ";
+			cout << "Simple=" << gigabytesPerSecond(size, simpleTime) << "GB/s, ";
+			cout << "Banked=" << gigabytesPerSecond(size, bankedTime) << "GB/s, ";
+			cout << "Threaded=" << gigabytesPerSecond(size, threadedTime) << "GB/s (" << threads << " threads)" << endl;
+		}
+	}
+
+	return 0;
+}
+
+// Benchmark every phase of encoding and decoding against every input
+//
+// The phases are timed one at a time, in the order a file goes through them: counting the
+// bytes, building the codes from the counts, building the decoding table from the code
+// lengths, encoding, decoding, and writing the encoded file out and reading it back in
+int runCodecBenchmarks(const Options& options)
+{
+	auto inputs = loadInputs(options);
+	auto threads = parallel::ThreadCount(options.Threads);
+
+	if (options.csvMode && !options.noHeaders)
+	{
+		cout << "Input,Bytes,EncodedBytes,Ratio,HistogramMs,TreeMs,TableMs,EncodeMs,DecodeMs,IoMs,EncodeMBps,DecodeMBps,Threads" << endl;
+	}
+
+	for (auto& input : inputs)
+	{
+		auto data = input.data.data();
+		auto size = input.data.size();
+
+		unsigned long long weights[256] = {};
+		auto histogramTime = bestTime(options.Trials, [&]()
+		{
+			fill(weights, weights + 256, 0);
+			histogram::Count(data, size, weights, threads);
+		});
+
+		auto treeTime = bestTime(options.Trials, [&]()
+		{
+			HuffmanEncoder built(weights);
+			built.BuildCodes();
+		});
+
+		HuffmanEncoder encoder(weights);
+		encoder.SetThreads(threads);
+		encoder.SetBlockSize(options.BlockSize * 1024);
+
+		unsigned char lengths[256];
+		encoder.GetCodeLengths(lengths);
+
+		HuffmanDecodeTable table;
+		auto tableTime = bestTime(options.Trials, [&]()
+		{
+			unsigned long long codes[256];
+			canonical::AssignCodes(lengths, codes);
+			table.Build(codes, lengths);
+		});
+
+		vector<unsigned char> encoded;
+		auto encodeTime = bestTime(options.Trials, [&]()
+		{
+			encoded.clear();
+			encoder.Encode(data, size, encoded);
+		});
+
+		HuffmanEncoder decoder;
+		decoder.SetThreads(threads);
+
+		vector<unsigned char> decoded;
+		auto decodeTime = bestTime(options.Trials, [&]()
+		{
+			decoded.clear();
+			decoder.Decode(encoded.data(), encoded.size(), decoded);
+		});
+
+		// A fast codec is no use if it doesn't give back what it was given
+		if (decoded != input.data)
+		{
+			cerr << "Decoding \"" << input.name << "\" didn't give back the original" << endl;
+			return -1;
+		}
+
+		vector<unsigned char> readBack(encoded.size());
+		auto ioTime = bestTime(options.Trials, [&]()
+		{
+			ofstream writer(SCRATCH_FILE, ios::binary);
+			writer.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+			writer.close();
+
+			ifstream reader(SCRATCH_FILE, ios::binary);
+			reader.read(reinterpret_cast<char*>(readBack.data()), readBack.size());
+		});
+		remove(SCRATCH_FILE);
+
+		auto ratio = size == 0 ? 0.0 : static_cast<double>(encoded.size()) / static_cast<double>(size);
+
+		if (options.csvMode)
+		{
+			cout << '"' << input.name << "\"," << size << ',' << encoded.size() << ',' << ratio << ',';
+			cout << histogramTime << ',' << treeTime << ',' << tableTime << ',' << encodeTime << ',' << decodeTime << ',' << ioTime << ',';
+			cout << megabytesPerSecond(size, encodeTime) << ',' << megabytesPerSecond(size, decodeTime) << ',' << threads << endl;
+		}
+		else
+		{
+			cout << "Codec on \"" << input.name << "\" (" << size << " bytes): Ratio=" << ratio << ", ";
+			cout << "Encode=" << megabytesPerSecond(size, encodeTime) << "MB/s, Decode=" << megabytesPerSecond(size, decodeTime) << "MB/s (";
+			cout << threads << " threads)" << endl;
+			cout << "\tHistogram=" << histogramTime << "ms, Tree=" << treeTime << "ms, Table=" << tableTime << "ms, ";
+			cout << "Encode=" << encodeTime << "ms, Decode=" << decodeTime << "ms, I/O=" << ioTime << "ms" << endl;
+		}
+	}
+
+	return 0;
+}
+
+// Encodes the <size> bytes at <data> with the specified codes into <streams>, dealing byte i to
+// streams[i % streams.size()] the same way interleaved blocks do
+void encodeStreams(const unsigned char* data, size_t size, const unsigned long long codes[256], const unsigned char lengths[256], vector<vector<unsigned char>>& streams)
+{
+	auto count = streams.size();
+
+	for (size_t s = 0; s < count; s++)
+	{
+		streams[s].clear();
+
+		BitWriter bits(streams[s]);
+		for (auto i = s; i < size; i += count) bits.Put(codes[data[i]], lengths[data[i]]);
+
+		if (bits.PendingBits() > 0) bits.Put(0, 8 - bits.PendingBits());
+		bits.Finish();
+	}
+}
+
+// Benchmark the decoding kernel for every root table width against every input, with a single
+// stream and with interleaved streams
+//
+// Each input is coded with its own Huffman code, as long as a bit writer can take. The kernel the
+// decoder would pick for that code is reported next to the fastest one, so the choice can be
+// checked against the corpora
+int runKernelBenchmarks(const Options& options)
+{
+	auto inputs = loadInputs(options);
+	const unsigned STREAMS[] = { 1, HuffmanDecodeTable::STREAM_COUNT };
+
+	if (options.csvMode && !options.noHeaders)
+	{
+		cout << "Input,Bytes,LongestCode,PickedBits,Streams";
+		for (auto bits = HuffmanDecodeTable::MIN_ROOT_BITS; bits <= HuffmanDecodeTable::MAX_ROOT_BITS; bits++) cout << ",Bits" << bits << "MBps";
+		cout << ",FastestBits" << endl;
+	}
+
+	for (auto& input : inputs)
+	{
+		auto data = input.data.data();
+		auto size = input.data.size();
+
+		unsigned long long weights[256] = {};
+		histogram::Count(data, size, weights);
+
+		HuffmanEncoder encoder(weights);
+		encoder.SetMaxCodeLength(BitWriter::MAX_PUT_BITS);
+
+		unsigned char lengths[256];
+		unsigned long long codes[256];
+		encoder.GetCodeLengths(lengths);
+		canonical::AssignCodes(lengths, codes);
+
+		unsigned longest = *max_element(lengths, lengths + 256);
+		auto picked = HuffmanDecodeTable::PickRootBits(longest);
+
+		if (!options.csvMode)
+		{
+			cout << "Kernels on \"" << input.name << "\" (" << size << " bytes, longest code " << longest << " bits, picks " << picked << " bits):" << endl;
+		}
+
+		for (auto streamCount : STREAMS)
+		{
+			vector<vector<unsigned char>> streams(streamCount);
+			encodeStreams(data, size, codes, lengths, streams);
+
+			vector<unsigned char> decoded(size);
+			vector<double> speeds;
+
+			for (auto bits = HuffmanDecodeTable::MIN_ROOT_BITS; bits <= HuffmanDecodeTable::MAX_ROOT_BITS; bits++)
+			{
+				HuffmanDecodeTable table;
+				table.Build(codes, lengths, bits);
+
+				size_t produced = 0;
+				auto time = bestTime(options.Trials, [&]()
+				{
+					vector<BitReader> readers;
+					for (auto& stream : streams) readers.emplace_back(stream.data(), stream.size());
+
+					produced = streamCount == 1 ? table.Decode(readers[0], decoded.data(), size) : table.DecodeInterleaved(readers.data(), decoded.data(), size);
+				});
+
+				// Every kernel has to give back the same bytes for the comparison to mean anything
+				if (produced != size || decoded != input.data)
+				{
+					cerr << "The " << bits << " bit kernel didn't decode \"" << input.name << "\" correctly" << endl;
+					return -1;
+				}
+
+				speeds.push_back(megabytesPerSecond(size, time));
+			}
+
+			auto fastest = HuffmanDecodeTable::MIN_ROOT_BITS + static_cast<unsigned>(max_element(speeds.begin(), speeds.end()) - speeds.begin());
+
+			if (options.csvMode)
+			{
+				cout << '"' << input.name << "\"," << size << ',' << longest << ',' << picked << ',' << streamCount;
+				for (auto speed : speeds) cout << ',' << speed;
+				cout << ',' << fastest << endl;
+			}
+			else
+			{
+				cout << '\t' << streamCount << (streamCount == 1 ? " stream: " : " streams: ");
+				for (size_t i = 0; i < speeds.size(); i++)
+				{
+					cout << (HuffmanDecodeTable::MIN_ROOT_BITS + i) << " bits=" << speeds[i] << "MB/s" << (i + 1 < speeds.size() ? ", " : "");
+				}
+				cout << " (fastest " << fastest << " bits)" << endl;
+			}
+		}
+	}
+
+	return 0;
+}
+
+// Runs <body> <trials> times and returns the fastest run in milliseconds
+double bestTime(size_t trials, const function<void()>& body)
+{
+	double best = 0;
+
+	for (size_t t = 0; t < trials; t++)
+	{
+		auto start = chrono::high_resolution_clock::now();
+		body();
+		auto end = chrono::high_resolution_clock::now();
+
+		chrono::duration<double, milli> duration = end - start;
+		if (t == 0 || duration.count() < best) best = duration.count();
+	}
+
+	return best;
+}
+
+// Converts a number of bytes processed in the specified number of milliseconds to GB/s
+double gigabytesPerSecond(size_t bytes, double milliseconds)
+{
+	if (milliseconds <= 0) return 0;
+
+	return static_cast<double>(bytes) / (milliseconds / 1000.0) / 1e9;
+}
+
+// Converts a number of bytes processed in the specified number of milliseconds to MB/s
+double megabytesPerSecond(size_t bytes, double milliseconds)
+{
+	if (milliseconds <= 0) return 0;
+
+	return static_cast<double>(bytes) / (milliseconds / 1000.0) / 1e6;
+}
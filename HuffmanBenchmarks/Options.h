@@ -0,0 +1,183 @@
+/*
+ * Options.h - Command-line options for the Huffman benchmarks
+ *
+ * Built for EECS2510 - Nonlinear Data Structures
+ *	at The University of Toledo, Spring 2016
+ *
+ * Copyright (c) 2016 Nathan Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+
+// Parses any options passed on the command line
+struct Options
+{
+	// Whether or not the histogram kernels should be benchmarked
+	bool histogram = false;
+	// Whether or not the encoder and decoder should be benchmarked
+	bool codec = false;
+	// Whether or not the decoding kernels should be benchmarked against each other
+	bool kernels = false;
+
+	// The paths to any files to benchmark against, in addition to the synthetic inputs
+	std::vector<std::string> TestFilePaths;
+	// The directories whose files are benchmarked against, in addition to the synthetic inputs
+	std::vector<std::string> TestDirectories;
+	// The number of KB in each block the codec benchmarks encode, or 0 for a single block
+	size_t BlockSize = 0;
+	// The size of each synthetic input in MB
+	size_t SyntheticSize = 64;
+	// The number of times each benchmark is run. The fastest run is reported
+	size_t Trials = 5;
+	// The number of threads for the multi-threaded benchmarks, or 0 for one per core
+	unsigned Threads = 0;
+
+	// Whether or not the help menu was requested
+	bool help = false;
+	// Whether or not errors were encountered while parsing arguments
+	bool errors = false;
+	// Whether or not the data should be output in CSV format
+	bool csvMode = false;
+	// Whether or not the CSV headers should not be included
+	bool noHeaders = false;
+
+	// Any errors encountered while parsing arguments
+	std::string errorMessage = "";
+
+	explicit Options(int argc, char* argv[])
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			std::string arg = argv[i];
+
+			if(arg == "-h" || arg == "--help")
+			{
+				help = true;
+			}
+			else if(arg == "-g" || arg == "--histogram")
+			{
+				histogram = true;
+			}
+			else if(arg == "-e" || arg == "--codec")
+			{
+				codec = true;
+			}
+			else if(arg == "-k" || arg == "--kernels")
+			{
+				kernels = true;
+			}
+			else if(arg == "-d" || arg == "--directory")
+			{
+				if(i < argc-1)
+				{
+					TestDirectories.push_back(argv[++i]);
+				}
+				else
+				{
+					notEnoughParameters(arg, "<string>");
+				}
+			}
+			else if(arg == "-b" || arg == "--block-size")
+			{
+				parseNumber(argc, argv, i, BlockSize);
+			}
+			else if(arg == "-f" || arg == "--file")
+			{
+				if(i < argc-1)
+				{
+					TestFilePaths.push_back(argv[++i]);
+				}
+				else
+				{
+					notEnoughParameters(arg, "<string>");
+				}
+			}
+			else if(arg == "-s" || arg == "--size")
+			{
+				parseNumber(argc, argv, i, SyntheticSize);
+			}
+			else if(arg == "-t" || arg == "--trials")
+			{
+				parseNumber(argc, argv, i, Trials);
+				if (Trials == 0) Trials = 1;
+			}
+			else if(arg == "-j" || arg == "--threads")
+			{
+				size_t threads = 0;
+				parseNumber(argc, argv, i, threads);
+				Threads = static_cast<unsigned>(threads);
+			}
+			else if(arg == "-c" || arg == "--csv")
+			{
+				csvMode = true;
+			}
+			else if(arg == "-n" || arg == "--no-headers")
+			{
+				csvMode = noHeaders = true;
+			}
+			else
+			{
+				errors = true;
+				errorMessage += "\t* ";
+				errorMessage += arg;
+				errorMessage += ": Unrecognized argument\n";
+			}
+		}
+	}
+
+private:
+	// Records an error for an argument that is missing its parameter
+	void notEnoughParameters(const std::string& arg, const std::string& expected)
+	{
+		errors = true;
+		errorMessage += "\t* ";
+		errorMessage += arg;
+		errorMessage += ": Not enough parameters (must be " + expected + ")\n";
+	}
+
+	// Parses the parameter after the argument at <i> into <value>, moving <i> past it
+	void parseNumber(int argc, char* argv[], int& i, size_t& value)
+	{
+		std::string arg = argv[i];
+
+		if (i >= argc - 1)
+		{
+			notEnoughParameters(arg, "<number>");
+			return;
+		}
+
+		try
+		{
+			value = static_cast<size_t>(std::stoul(argv[++i]));
+		}
+		catch (std::exception ex)
+		{
+			errors = true;
+			errorMessage += "\t* ";
+			errorMessage += arg;
+			errorMessage += ": Unable to parse argument (";
+			errorMessage += ex.what();
+			errorMessage += ")\n";
+		}
+	}
+};
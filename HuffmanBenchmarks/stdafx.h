@@ -1,5 +1,7 @@
 /*
- * Word.h - Definition for the Word payload
+ * stdafx.h - include file for standard system include files,
+ * or project specific include files that are used frequently, but
+ * are changed infrequently
  *
  * Built for EECS2510 - Nonlinear Data Structures
  *	at The University of Toledo, Spring 2016
@@ -26,24 +28,8 @@
  */
 
 #pragma once
-#include <string>
 
-// A structure for counting the number of times a word appears
-struct Word
-{
-	// The string representation of the word
-	std::string key;
-	// The number of times the word has occurred
-	uint64_t count;
+#include "targetver.h"
 
-	// Construct a word from the specified string with a word count of 1
-	explicit Word(std::string w) : Word(w, 1) {}
-
-	// Construct a word from the specified string and count
-	explicit Word(std::string w, uint64_t c) : key(w), count(c) {}
-
-	friend std::ostream& operator<<(std::ostream& os, const Word& obj)
-	{
-		return os << "key: " << obj.key << ", count: " << obj.count;
-	}
-};
+#include <stdio.h>
+#include <tchar.h>
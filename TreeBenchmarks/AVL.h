@@ -1,5 +1,5 @@
 /*
- * AVL.h - interface for an AVL Tree
+ * AVL.h - interface and implementation of an AVL Tree
  *
  * Built for EECS2510 - Nonlinear Data Structures
  *	at The University of Toledo, Spring 2016
@@ -27,12 +27,14 @@
 
 #pragma once
 #include "BST.h"
+#include <cassert>
 
 // A node in an AVL Tree. Basically, a Binary Tree Node
 // with an additional field for keeping track of the "balance factor"
-struct AVLTreeNode : BinaryTreeNode
+template <typename TKey, typename TValue>
+struct AVLTreeNode : BinaryTreeNode<TKey, TValue>
 {
-	explicit AVLTreeNode(Word* payload) : BinaryTreeNode(payload) {}
+	explicit AVLTreeNode(const TKey& key) : BinaryTreeNode<TKey, TValue>(key) {}
 
 	// The balance factor of the node
 	// This is the height of the left sub-tree minus the height of the right sub-tree
@@ -44,34 +46,324 @@ struct AVLTreeNode : BinaryTreeNode
 //
 // When a node's height is different by more than two nodes between its left and right sub-trees,
 // rotations are performed to return the tree to an acceptably balanced state.
-class AVL : public BST
+template <typename TKey, typename TValue = NoValue, typename TCompare = ThreeWayCompare<TKey>>
+class AVL : public BST<TKey, TValue, TCompare>
 {
 public:
-	AVL();
-	~AVL();
+	typedef BST<TKey, TValue, TCompare> Base;
+	using typename Base::Entry;
+	// The nodes of the tree
+	typedef AVLTreeNode<TKey, TValue> Node;
 
-	// Adds the word to the tree. If the word already exists, its occurrance count is incremeneted
+	explicit AVL(TCompare compare = TCompare()) : Base(compare) {}
+
+	// Adds the key to the tree. If the key already exists, its occurrance count is incremeneted
 	// Returns:
-	//		A pointer to the word represented by the key
-	Word* add(std::string key) override;
+	//		A pointer to the entry for the key
+	Entry* add(const TKey& key) override;
 
 	// Returns: The number of times the balance factor of any node was updated
 	size_t getBalanceFactorChangeCount() const { return balanceFactorChanges;  }
 
 private:
+	using Base::Root;
+	using Base::compare;
+	using Base::isEmpty;
+
 	size_t balanceFactorChanges = 0;
 
 	// Perform tree rotations at the specified rotation candidate according to its balance factor and the specified delta
 	// This is required to keep the tree acceptably balanced.
-	inline void doRotations(AVLTreeNode* lastRotationCandidate, AVLTreeNode*& nextAfterRotationCandidate, char delta);
+	inline void doRotations(Node* lastRotationCandidate, Node*& nextAfterRotationCandidate, char delta);
 
 	// Performs a rotation to handle the Left-Left case at the specified rotation candidate
-	inline void rotateLeftLeft(AVLTreeNode* lastRotationCandidate, AVLTreeNode*& nextAfterRotationCandidate);
+	inline void rotateLeftLeft(Node* lastRotationCandidate, Node*& nextAfterRotationCandidate);
 	// Performs a rotation to handle the Left-Right case at the specified rotation candidate
-	inline void rotateLeftRight(AVLTreeNode* lastRotationCandidate, AVLTreeNode*& nextAfterRotationCandidate);
+	inline void rotateLeftRight(Node* lastRotationCandidate, Node*& nextAfterRotationCandidate);
 	// Performs a rotation to handle the Right-Right case at the specified rotation candidate
-	inline void rotateRightRight(AVLTreeNode* lastRotationCandidate, AVLTreeNode*& nextAfterRotationCandidate);
+	inline void rotateRightRight(Node* lastRotationCandidate, Node*& nextAfterRotationCandidate);
 	// Performs a rotation to handle the Right-Left case at the specified rotation candidate
-	inline void rotateRightLeft(AVLTreeNode* lastRotationCandidate, AVLTreeNode*& nextAfterRotationCandidate);
+	inline void rotateRightLeft(Node* lastRotationCandidate, Node*& nextAfterRotationCandidate);
 };
 
+// Insert the specified key into the tree. If the key is not already in
+// the tree, the balance factors of nodes along the insertion path are updated
+// and rotations may be performed to keep the tree balanced.
+template <typename TKey, typename TValue, typename TCompare>
+typename AVL<TKey, TValue, TCompare>::Entry* AVL<TKey, TValue, TCompare>::add(const TKey& key)
+{
+	// The tree is empty, just update the root pointer
+	if (isEmpty())
+	{
+		this->referenceChanges++;
+		Root = new Node(key);
+		return &Root->Payload;
+	}
+
+	// Otherwise, we need to find where to put it (P in the slides)
+	Node* previous = static_cast<Node*>(Root);
+	// F in the slides
+	Node* lastRotationCandidateParent = nullptr;
+	// A in the slides
+	Node* lastRotationCandidate = static_cast<Node*>(Root);
+	// B in the slides
+	Node* nextAfterRotationCandidate;
+	// Q in the slides
+	Node* candidate = nullptr;
+	char delta = 0;
+
+	int branchComparisonResult;
+
+	// search tree for insertion point
+	while (previous != nullptr)
+	{
+		branchComparisonResult = compare(key, previous->Payload.key);
+		this->comparisons++;
+
+		if (branchComparisonResult == 0)
+		{
+			// The key we're inserting is already in the tree
+			previous->Payload.count++;
+			return &previous->Payload;
+		}
+
+		// If this node's balance factor is already +/- 1 it may go to +/- 2 after the insertion
+		// Remember where the last node like this is, since we may have to rotate around it later
+		if (previous->BalanceFactor != 0)
+		{
+			lastRotationCandidate = previous;
+			lastRotationCandidateParent = candidate;
+		}
+
+		// Remember where we used to be
+		candidate = previous;
+		previous = static_cast<Node*>((branchComparisonResult < 0) ? previous->Left : previous->Right);
+	}
+
+	// We didn't find the node already, so we have to insert a new one
+	auto toInsert = new Node(key);
+
+	// Graft the new leaf node into the tree
+	this->referenceChanges++;
+	if (branchComparisonResult < 0)
+	{
+		candidate->Left = toInsert;
+	}
+	else
+	{
+		candidate->Right = toInsert;
+	}
+
+	// Figure out if we took the left or right branch after the last node with
+	// a +/- 1 balance factor prior to the insert
+	this->comparisons++;
+	if (compare(key, lastRotationCandidate->Payload.key) < 0)
+	{
+		delta = 1;
+
+		previous = static_cast<Node*>(lastRotationCandidate->Left);
+		nextAfterRotationCandidate = previous;
+	}
+	else
+	{
+		delta = -1;
+
+		previous = static_cast<Node*>(lastRotationCandidate->Right);
+		nextAfterRotationCandidate = previous;
+	}
+
+	// Update balance factors, moving pointers along the way
+	while (previous != toInsert)
+	{
+		this->comparisons++;
+		this->balanceFactorChanges++;
+		if (compare(key, previous->Payload.key) > 0)
+		{
+			previous->BalanceFactor = -1;
+			previous = static_cast<Node*>(previous->Right);
+		}
+		else
+		{
+			previous->BalanceFactor = +1;
+			previous = static_cast<Node*>(previous->Left);
+		}
+	}
+
+	if (lastRotationCandidate->BalanceFactor == 0)
+	{
+		// Tree was perfectly balanced
+		this->balanceFactorChanges++;
+		lastRotationCandidate->BalanceFactor = delta;
+		return &toInsert->Payload;
+	}
+	
+	if (lastRotationCandidate->BalanceFactor == -delta)
+	{
+		// Tree was out of balance, but is now balanced
+		this->balanceFactorChanges++;
+		lastRotationCandidate->BalanceFactor = 0;
+		return &toInsert->Payload;
+	}
+
+	// Otherwise, we have rotations to do
+	doRotations(lastRotationCandidate, nextAfterRotationCandidate, delta);
+
+	// did we rebalance the root?
+	this->referenceChanges++;
+	if (lastRotationCandidateParent == nullptr)
+	{
+		Root = nextAfterRotationCandidate;
+	}
+
+	// otherwise, we rebalanced whatever was the
+	// child (left or right) of F.
+	else if (lastRotationCandidate == lastRotationCandidateParent->Left)
+	{
+		lastRotationCandidateParent->Left = nextAfterRotationCandidate;
+	}
+	else if (lastRotationCandidate == lastRotationCandidateParent->Right)
+	{
+		lastRotationCandidateParent->Right = nextAfterRotationCandidate;
+	}
+	else
+	{
+		assert(false);
+	}
+
+	return &toInsert->Payload;
+}
+
+// Perform rotations about the specified nodes to keep the tree balanced
+template <typename TKey, typename TValue, typename TCompare>
+void AVL<TKey, TValue, TCompare>::doRotations(Node* A, Node*& B, char delta)
+{
+	if (delta == 1) // left imbalance.  LL or LR?
+	{
+		if (B->BalanceFactor == 1)
+		{
+			rotateLeftLeft(A, B);
+		}
+		else
+		{
+			rotateLeftRight(A, B);
+		}
+	}
+	else // d=-1.  This is a right imbalance
+	{
+		if (B->BalanceFactor == -1)
+		{
+			rotateRightRight(A, B);
+		}
+		else
+		{
+			rotateRightLeft(A, B);
+		}
+	}
+}
+
+template <typename TKey, typename TValue, typename TCompare>
+void AVL<TKey, TValue, TCompare>::rotateLeftLeft(Node* A, Node*& B)
+{
+	// Change the child pointers at A and B to
+	// reflect the rotation. Adjust the BFs at A & B
+	this->referenceChanges += 2;
+	this->balanceFactorChanges += 2;
+	A->Left  = B->Right;
+	B->Right = A;
+	A->BalanceFactor = B->BalanceFactor = 0;
+}
+
+template <typename TKey, typename TValue, typename TCompare>
+void AVL<TKey, TValue, TCompare>::rotateLeftRight(Node* A, Node*& B)
+{
+	// Adjust the child pointers of nodes A, B, & C
+	// to reflect the new post-rotation structure
+	auto C  = static_cast<Node*>(B->Right); // C is B's right child
+	auto CL = static_cast<Node*>(C->Left);  // CL and CR are C's left
+	auto CR = static_cast<Node*>(C->Right); //    and right children
+
+	this->referenceChanges += 4;
+	B->Right = CL;
+	A->Left = CR;
+
+	C->Left = B;
+	C->Right = A;
+	/*
+	   A              A                     C
+	  /              /                   /    \
+	 B       ->     C         ->        B      A
+	  \            / \                   \    /
+	   C          B   CR                 CL  CR
+	  / \          \
+	CL   CR         CL
+
+	*/
+
+	this->balanceFactorChanges += 3;
+	switch (C->BalanceFactor)
+	{
+		// Set the new BFs at A and B, based on the
+		// BF at C. Note: There are 3 sub-cases
+		case  1: A->BalanceFactor = -1; B->BalanceFactor = 0; break;
+		case  0: A->BalanceFactor = B->BalanceFactor = 0; break;
+		case -1: A->BalanceFactor = 0; B->BalanceFactor = 1; break;
+		default: assert(false);
+	}
+
+	C->BalanceFactor = 0;
+	B = C;
+}
+
+template <typename TKey, typename TValue, typename TCompare>
+void AVL<TKey, TValue, TCompare>::rotateRightRight(Node* A, Node*& B)
+{
+	// Change the child pointers at A and B to
+	// reflect the rotation. Adjust the BFs at A & B
+	this->referenceChanges += 2;
+	this->balanceFactorChanges += 2;
+	A->Right = B->Left;
+	B->Left  = A;
+	A->BalanceFactor = B->BalanceFactor = 0;
+}
+
+template <typename TKey, typename TValue, typename TCompare>
+void AVL<TKey, TValue, TCompare>::rotateRightLeft(Node* A, Node*& B)
+{
+	// Adjust the child pointers of nodes A, B, & C
+	// to reflect the new post-rotation structure
+	auto C  = static_cast<Node*>(B->Left); // C is B's left child
+	auto CL = static_cast<Node*>(C->Left); // CL and CR are C's left
+	auto CR = static_cast<Node*>(C->Right);//    and right children
+
+	/*
+			A              A                      C
+			 \              \                   /   \
+			  B       ->     C         ->      A     B
+			 /              / \                 \   /
+			C             CL   B                CL CR
+		   / \                /
+		 CL   CR             CR
+
+	 */
+
+	this->referenceChanges += 4;
+	A->Right = CL;
+	B->Left  = CR;
+
+	C->Right = B;
+	C->Left  = A;
+
+	this->balanceFactorChanges += 3;
+	switch (C->BalanceFactor)
+	{
+		// Set the new BFs at A and B, based on the
+		// BF at C. Note: There are 3 sub-cases
+		case  1: A->BalanceFactor = 0; B->BalanceFactor = -1; break;
+		case  0: A->BalanceFactor = B->BalanceFactor = 0; break;
+		case -1: A->BalanceFactor = 1; B->BalanceFactor = 0; break;
+		default: assert(false);
+	}
+
+	C->BalanceFactor = 0;
+	B = C;
+}
@@ -1,5 +1,5 @@
 /*
- * BST.h - interface for a Binary Search Tree
+ * BST.h - interface and implementation of a Binary Search Tree, generic over its key, value and comparator
  *
  * Built for EECS2510 - Nonlinear Data Structures
  *	at The University of Toledo, Spring 2016
@@ -26,27 +26,119 @@
  */
 
 #pragma once
-#include "Word.h"
 #include "IPerformanceStatsTracker.h"
 #include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+// Compares two keys, returning a negative number if the first is less than the second, zero if they
+// are equal and a positive number if it is greater
+//
+// Any key with operator< works. Integer keys come down to a couple of inline integer compares, with
+// no calls and nothing allocated
+template <typename TKey>
+struct ThreeWayCompare
+{
+	int operator()(const TKey& a, const TKey& b) const
+	{
+		return (a < b) ? -1 : (b < a) ? 1 : 0;
+	}
+};
+
+// Strings are compared in a single pass, instead of once for each direction
+template <>
+struct ThreeWayCompare<std::string>
+{
+	int operator()(const std::string& a, const std::string& b) const
+	{
+		return a.compare(b);
+	}
+};
+
+// Fixed-size binary keys are compared as unsigned bytes with memcmp
+template <size_t N>
+struct ThreeWayCompare<std::array<unsigned char, N>>
+{
+	int operator()(const std::array<unsigned char, N>& a, const std::array<unsigned char, N>& b) const
+	{
+		return std::memcmp(a.data(), b.data(), N);
+	}
+};
+
+// The value of a tree that only counts its keys
+struct NoValue
+{
+};
+
+// Writes the specified key to the stream
+template <typename TKey>
+void writeKey(std::ostream& os, const TKey& key)
+{
+	os << key;
+}
+
+// Writes a fixed-size binary key to the stream in hex
+template <size_t N>
+void writeKey(std::ostream& os, const std::array<unsigned char, N>& key)
+{
+	auto flags = os.flags();
+	auto fill = os.fill('0');
+
+	os << std::hex;
+	for (auto b : key) os << std::setw(2) << static_cast<unsigned>(b);
+
+	os.flags(flags);
+	os.fill(fill);
+}
+
+// The payload of a node: a key, the number of times it was added to the tree and the value stored with it
+template <typename TKey, typename TValue = NoValue>
+struct TreeEntry
+{
+	// The key the tree is ordered by
+	TKey key;
+	// The number of times the key has been added
+	uint64_t count;
+	// The value stored with the key, which starts out value-initialized
+	TValue value;
+
+	// Construct an entry for the specified key with a count of 1
+	explicit TreeEntry(const TKey& k) : TreeEntry(k, 1) {}
+
+	// Construct an entry for the specified key and count
+	explicit TreeEntry(const TKey& k, uint64_t c) : key(k), count(c), value() {}
+
+	friend std::ostream& operator<<(std::ostream& os, const TreeEntry& obj)
+	{
+		os << "key: ";
+		writeKey(os, obj.key);
+		return os << ", count: " << obj.count;
+	}
+};
 
 // A node in a Binary Tree
+//
+// The payload is kept in the node, so adding a key takes a single allocation
+template <typename TKey, typename TValue>
 struct BinaryTreeNode
 {
 	// The payload the node contains
-	Word* Payload;
+	TreeEntry<TKey, TValue> Payload;
 
 	// The Left Child Node
 	BinaryTreeNode* Left = nullptr;
 	// The Right Child Node
 	BinaryTreeNode* Right = nullptr;
 
-	// Construct a binary tree node with the specified Word as a payload
-	explicit BinaryTreeNode(Word* payload) : Payload(payload){}
+	// Construct a binary tree node with a payload for the specified key
+	explicit BinaryTreeNode(const TKey& key) : Payload(key){}
 
 	virtual ~BinaryTreeNode()
 	{
-		if (Payload != nullptr) delete Payload;
 		if (Left != nullptr) delete Left;
 		if (Right != nullptr) delete Right;
 	}
@@ -57,12 +149,12 @@ struct BinaryTreeNode
 	// The total height of the sub-tree from this node (1 plus the total height of each the left and right sub-tree)
 	virtual size_t totalHeight() const { return 1 + (Left == nullptr ? 0 : Left->totalHeight()) + (Right == nullptr ? 0 : Right->totalHeight()); }
 
-	// The total word count of the sub-tree from this node (the payload count plus the sum of the payloads of the left and right sub-trees)
-	virtual size_t payloadSum() const { return Payload->count + (Left == nullptr ? 0 : Left->payloadSum()) + (Right == nullptr ? 0 : Right->payloadSum()); }
+	// The total key count of the sub-tree from this node (the payload count plus the sum of the payloads of the left and right sub-trees)
+	virtual size_t payloadSum() const { return Payload.count + (Left == nullptr ? 0 : Left->payloadSum()) + (Right == nullptr ? 0 : Right->payloadSum()); }
 
 	friend std::ostream& operator<<(std::ostream& os, const BinaryTreeNode& obj)
 	{
-		return os << "Payload: " << *obj.Payload;
+		return os << "Payload: " << obj.Payload;
 	}
 
 };
@@ -73,25 +165,33 @@ struct BinaryTreeNode
 //		* All items on the leftBranch of the node are "less" than k
 //		* All items on the rightBranch of the node are "greater" than k
 //
-// Due to time constraints, the tree only accepts payloads of type Word and is not templated
+// The tree is generic over the key, the value stored with each key and the comparator, which returns
+// a negative number, zero or a positive number like std::string::compare (see ThreeWayCompare). Keys
+// must be default-constructible and printable with operator<<, or be a std::array of bytes
+template <typename TKey, typename TValue = NoValue, typename TCompare = ThreeWayCompare<TKey>>
 class BST : public IPerformanceStatsTracker
 {
 public:
-	BST();
+	// The payload of each node
+	typedef TreeEntry<TKey, TValue> Entry;
+	// The nodes of the tree
+	typedef BinaryTreeNode<TKey, TValue> Node;
+
+	explicit BST(TCompare compare = TCompare()) : compare(compare) {}
 	~BST();
 
-	// Adds the word to the tree. If the word already exists, its occurrance count is incremeneted
+	// Adds the key to the tree. If the key already exists, its occurrance count is incremeneted
 	// Returns:
-	//		A pointer to the word represented by the key
-	virtual Word* add(std::string key);
+	//		A pointer to the entry for the key
+	virtual Entry* add(const TKey& key);
 
-	// Finds the word in the tree with the specified tree. 
+	// Finds the entry in the tree with the specified key. 
 	// Returns:
-	//		A pointer to the word represented by the specified key
+	//		A pointer to the entry for the specified key
 	//		A null pointer if the key does not exist in the tree
-	Word* get(std::string key);
+	Entry* get(const TKey& key);
 
-	// Prints all words and their occurrance count in alphabetical order to std::cout
+	// Prints all keys and their occurrance count in order to std::cout
 	void inOrderPrint() const { inOrderPrint(Root); }
 
 	// Returns true iff the tree is empty
@@ -99,18 +199,149 @@ public:
 
 	// The height (number of levels) of the tree
 	size_t height() const { return isEmpty() ? 0 : Root->height(); }
-	// The total number of words in the tree
+	// The total number of keys added to the tree
 	size_t totalWords() const { return isEmpty() ? 0 : Root->payloadSum(); }
 	// The total number of nodes in the tree
-	// This is the number of distinct words encountered
+	// This is the number of distinct keys encountered
 	size_t totalNodes() const { return isEmpty() ? 0 : Root->totalHeight(); }
 protected:
 	// The node at the root of the tree
-	BinaryTreeNode* Root = nullptr;
+	Node* Root = nullptr;
+
+	// Compares keys
+	TCompare compare;
 
 	// Finds a node in the tree with the specified key
-	BinaryTreeNode* find(std::string key);
+	Node* find(const TKey& key);
 
 	// Recursively prints the subtree starting from the specified node in order
-	virtual void inOrderPrint(BinaryTreeNode* node) const;
+	virtual void inOrderPrint(Node* node) const;
 };
+
+template <typename TKey, typename TValue, typename TCompare>
+BST<TKey, TValue, TCompare>::~BST()
+{
+	// Free the root pointer. This will also free all child nodes
+	if (Root != nullptr) delete Root;
+}
+
+// Adds the key to the tree. If the key already exists, its occurrance count is incremeneted
+// This method will take care of maintaining the Binary Search Tree Property:
+// For a given key k,
+//		* All elements in the left subtree of a node with key k are "less" than k
+//		* All elements in the right subtree of a node with key k are "greater" than k
+template <typename TKey, typename TValue, typename TCompare>
+typename BST<TKey, TValue, TCompare>::Entry* BST<TKey, TValue, TCompare>::add(const TKey& key)
+{
+	// The tree is empty, just update the root pointer
+	if (isEmpty())
+	{
+		this->referenceChanges++;
+		Root = new Node(key);
+		return &Root->Payload;
+	}
+	
+	// Otherwise, we need to find where to put it
+	Node* previous;
+	Node* candidate = Root;
+
+	int branchComparisonResult;
+
+	do
+	{
+		// Remember where we used to be
+		previous = candidate;
+
+		// Find which branch to take
+		branchComparisonResult = compare(key, candidate->Payload.key);
+		this->comparisons++;
+
+		if (branchComparisonResult < 0)
+		{
+			// The key we're inserting is less than the candidate
+			// Take the left branch
+			candidate = candidate->Left;
+		}
+		else if (branchComparisonResult == 0)
+		{
+			// The key we're inserting is already in the tree
+			candidate->Payload.count++;
+			return &candidate->Payload;
+		}
+		else
+		{
+			// The key we're inserting is greater than the candidate
+			// Take the right branch
+			candidate = candidate->Right;
+		}
+	} while (candidate != nullptr);
+
+	auto toInsert = new Node(key);
+
+	// Graft the new leaf node into the tree
+	this->referenceChanges++;
+	if(branchComparisonResult < 0)
+	{
+		previous->Left = toInsert;
+	}
+	else
+	{
+		previous->Right = toInsert;
+	}
+
+	return &toInsert->Payload;
+}
+
+// Finds the entry in the tree with the specified key by performing a binary search
+template <typename TKey, typename TValue, typename TCompare>
+typename BST<TKey, TValue, TCompare>::Entry* BST<TKey, TValue, TCompare>::get(const TKey& key)
+{
+	auto node = find(key);
+
+	// Make sure the key is in the tree to start with
+	if (node == nullptr) return nullptr;
+	return &node->Payload;
+}
+
+// A helper function to find a node in the tree with the specified key
+template <typename TKey, typename TValue, typename TCompare>
+typename BST<TKey, TValue, TCompare>::Node* BST<TKey, TValue, TCompare>::find(const TKey& key)
+{
+	// The tree is empty, so there is no node that is identified by the specified key
+	if (Root == nullptr) return nullptr;
+
+	auto candidate = Root;
+	do
+	{
+		int branch = compare(key, candidate->Payload.key);
+		this->comparisons++;
+
+		if (branch < 0)
+		{
+			candidate = candidate->Left;
+		}
+		else if(branch == 0)
+		{
+			// We found the node!
+			return candidate;
+		}
+		else
+		{
+			candidate = candidate->Right;
+		}
+	} while (candidate != nullptr);
+
+	// We didn't find the node :(
+	return nullptr;
+}
+
+// A helper function to recursively print the payloads of the specified sub-tree in-order
+template <typename TKey, typename TValue, typename TCompare>
+void BST<TKey, TValue, TCompare>::inOrderPrint(Node* node) const
+{
+	if (node == nullptr) return;
+
+	inOrderPrint(node->Left);
+	std::cout << *node << std::endl;
+	inOrderPrint(node->Right);
+}
@@ -1,5 +1,5 @@
 /*
- * RBT.h - interface for a Red-Black tree
+ * RBT.h - interface and implementation of a Red-Black Tree
  *
  * Built for EECS2510 - Nonlinear Data Structures
  *	at The University of Toledo, Spring 2016
@@ -37,30 +37,33 @@ enum NodeColor
 // A node in an Red-Black tree. Basically, a Binary Tree Node
 // with an additional field for keeping track of the node color
 // and the parent pointer
-struct RedBlackNode : BinaryTreeNode
+template <typename TKey, typename TValue>
+struct RedBlackNode : BinaryTreeNode<TKey, TValue>
 {
-	explicit RedBlackNode(Word* payload) : BinaryTreeNode(payload) {}
+	typedef BinaryTreeNode<TKey, TValue> Base;
+
+	explicit RedBlackNode(const TKey& key) : Base(key) {}
 
 	~RedBlackNode()
 	{
-		if (Left != nullptr && !(static_cast<RedBlackNode*>(Left))->isMasterLeaf()) delete Left;
-		if (Right != nullptr && !(static_cast<RedBlackNode*>(Right))->isMasterLeaf()) delete Right;
+		if (this->Left != nullptr && !(static_cast<RedBlackNode*>(this->Left))->isMasterLeaf()) delete this->Left;
+		if (this->Right != nullptr && !(static_cast<RedBlackNode*>(this->Right))->isMasterLeaf()) delete this->Right;
 		
 		Parent = nullptr;
-		Left = Right = nullptr;
+		this->Left = this->Right = nullptr;
 	}
 
 	RedBlackNode* Parent = nullptr;
 	NodeColor Color = RED;
 
-	size_t height() const override { return isMasterLeaf() ? 0 : this->BinaryTreeNode::height(); }
-	size_t totalHeight() const override { return isMasterLeaf() ? 0 : this->BinaryTreeNode::totalHeight(); }
-	size_t payloadSum() const override { return isMasterLeaf() ? 0 : this->BinaryTreeNode::payloadSum(); }
+	size_t height() const override { return isMasterLeaf() ? 0 : this->Base::height(); }
+	size_t totalHeight() const override { return isMasterLeaf() ? 0 : this->Base::totalHeight(); }
+	size_t payloadSum() const override { return isMasterLeaf() ? 0 : this->Base::payloadSum(); }
 
 	// Whether or not this node is the leaf "supernode"
 	bool isMasterLeaf() const
 	{
-		return Left == Right && Left == Parent && Color == BLACK;
+		return this->Left == this->Right && this->Left == Parent && Color == BLACK;
 	}
 
 };
@@ -75,31 +78,270 @@ struct RedBlackNode : BinaryTreeNode
 //
 // After inserting a new element, rotations and recolorings occur to ensure the tree conforms
 // to the rules defined above.
-class RBT : public BST
+template <typename TKey, typename TValue = NoValue, typename TCompare = ThreeWayCompare<TKey>>
+class RBT : public BST<TKey, TValue, TCompare>
 {
 public:
-	RBT();
+	typedef BST<TKey, TValue, TCompare> Base;
+	using typename Base::Entry;
+	// The nodes of the tree
+	typedef RedBlackNode<TKey, TValue> Node;
+
+	explicit RBT(TCompare compare = TCompare());
 	~RBT();
 
-	// Adds the word to the tree. If the word already exists, its occurrance count is incremeneted
+	// Adds the key to the tree. If the key already exists, its occurrance count is incremeneted
 	// Returns:
-	//		A pointer to the word represented by the key
-	Word* add(std::string key) override;
+	//		A pointer to the entry for the key
+	Entry* add(const TKey& key) override;
 
 	// Returns: The number of times the color of any node was changed
 	size_t getRecolorCount() const { return recolorCount; }
 private:
+	using Base::Root;
+	using Base::compare;
+	using Base::isEmpty;
+
 	size_t recolorCount = 0;
-	RedBlackNode* leafNodes;
+	Node* leafNodes;
 
 	// Recolor nodes and rotate subtrees such that the tree conforms to the rules of a Red-Black Tree
-	void fixup(RedBlackNode* z);
+	void fixup(Node* z);
 	// Rotate the sub-tree pointed at by node x to the left
-	void rotateLeft(RedBlackNode* x);
+	void rotateLeft(Node* x);
 	// Rotate the sub-tree pointed at by the node y to the right
-	void rotateRight(RedBlackNode* x);
+	void rotateRight(Node* x);
 
 	// Overridden to not include the leaf supernode
-	void inOrderPrint(BinaryTreeNode* node) const override;
+	void inOrderPrint(typename Base::Node* node) const override;
 };
 
+// Construct an empty tree, which only has the leaf supernode
+template <typename TKey, typename TValue, typename TCompare>
+RBT<TKey, TValue, TCompare>::RBT(TCompare compare) : Base(compare)
+{
+	this->recolorCount++;
+	this->referenceChanges += 3;
+	leafNodes = new Node(TKey());
+	leafNodes->Color = BLACK;
+	leafNodes->Left = leafNodes->Right = leafNodes->Parent = leafNodes;
+}
+
+// Free the nodes of the tree, then the leaf supernode they all share
+template <typename TKey, typename TValue, typename TCompare>
+RBT<TKey, TValue, TCompare>::~RBT()
+{
+	// We have to delete the nodes ourselves first so the leaf supernode can be properly free'd
+	if (Root != nullptr) delete Root;
+	delete leafNodes;
+
+	// We have to set the root to a null pointer so the base destructor doesn't try to double-free the nodes
+	Root = nullptr;
+	leafNodes = nullptr;
+}
+
+// Insert the specified key into the tree. If the key is not already in
+// the tree, it is added and the tree is recolored and rotated as needed
+template <typename TKey, typename TValue, typename TCompare>
+typename RBT<TKey, TValue, TCompare>::Entry* RBT<TKey, TValue, TCompare>::add(const TKey& key)
+{
+	// The tree is empty, just update the root pointer
+	if (isEmpty())
+	{
+		this->referenceChanges += 4;
+		this->recolorCount++;
+		Root = new Node(key);
+		(static_cast<Node*>(Root))->Color = BLACK;
+		(static_cast<Node*>(Root))->Parent = leafNodes;
+		Root->Left = Root->Right = leafNodes;
+		return &Root->Payload;
+	}
+
+	// Otherwise, we need to find where to put it
+	Node* previous = static_cast<Node*>(Root);
+	Node* candidate = nullptr;
+
+	int branchComparisonResult;
+
+	// search tree for insertion point
+	while (previous != leafNodes)
+	{
+		branchComparisonResult = compare(key, previous->Payload.key);
+		this->comparisons++;
+
+		if (branchComparisonResult == 0)
+		{
+			// The key we're inserting is already in the tree
+			previous->Payload.count++;
+			return &previous->Payload;
+		}
+
+		// Remember where we used to be
+		candidate = previous;
+		previous = static_cast<Node*>((branchComparisonResult < 0) ? previous->Left : previous->Right);
+	}
+
+	// We didn't find the node already, so we have to insert a new one
+	auto toInsert = new Node(key);
+	this->referenceChanges += 4;
+	toInsert->Parent = candidate;
+	toInsert->Left = toInsert->Right = leafNodes;
+
+	// Graft the new leaf node into the tree
+	if (branchComparisonResult < 0)
+	{
+		candidate->Left = toInsert;
+	}
+	else
+	{
+		candidate->Right = toInsert;
+	}
+
+	// Recolor and rotate if needed to keep the tree balanced
+	fixup(toInsert);
+
+	return &toInsert->Payload;
+}
+
+// Recolors and optionally rotates the nodes starting at the specified node
+// to keep the tree balanced.
+template <typename TKey, typename TValue, typename TCompare>
+void RBT<TKey, TValue, TCompare>::fixup(Node* z)
+{
+	while(z->Parent->Color == RED)
+	{
+		if(z->Parent == z->Parent->Parent->Left)
+		{
+			auto y = static_cast<Node*>(z->Parent->Parent->Right);
+			if (y->Color == RED)
+			{
+				// Case 1, re-color only
+				this->recolorCount += 3;
+				z->Parent->Color = BLACK;
+				y->Color = BLACK;
+				z->Parent->Parent->Color = RED;
+				z = z->Parent->Parent;
+			}
+			else
+			{
+				if(z == z->Parent->Right)
+				{
+					// Case 2
+					z = z->Parent;
+					rotateLeft(z);
+				}
+				// Case 3
+				this->recolorCount += 3;
+				z->Parent->Color = BLACK;
+				z->Parent->Parent->Color = RED;
+				rotateRight(z->Parent->Parent);
+			}
+		}
+		else
+		{
+			auto y = static_cast<Node*>(z->Parent->Parent->Left);
+			if (y->Color == RED)
+			{
+				// Case 1, re-color only
+				this->recolorCount += 3;
+				z->Parent->Color = BLACK;
+				y->Color = BLACK;
+				z->Parent->Parent->Color = RED;
+				z = z->Parent->Parent;
+			}
+			else
+			{
+				if (z == z->Parent->Left)
+				{
+					// Case 2
+					z = z->Parent;
+					rotateRight(z);
+				}
+				// Case 3
+				this->recolorCount += 2;
+				z->Parent->Color = BLACK;
+				z->Parent->Parent->Color = RED;
+				rotateLeft(z->Parent->Parent);
+			}
+		}
+	}
+
+	// The root should always be black
+	(static_cast<Node*>(Root))->Color = BLACK;
+}
+
+// Rotate the sub-tree pointed at by node x to the left
+template <typename TKey, typename TValue, typename TCompare>
+void RBT<TKey, TValue, TCompare>::rotateLeft(Node* x)
+{
+	auto y = static_cast<Node*>(x->Right);
+	x->Right = y->Left;
+	this->referenceChanges++;
+
+	if(y->Left != leafNodes)
+	{
+		(static_cast<Node*>(y->Left))->Parent = x;
+		this->referenceChanges++;
+	}
+
+	this->referenceChanges += 4;
+	y->Parent = x->Parent;
+	if (x->Parent == leafNodes)
+	{
+		Root = y;
+	}
+	else if (x == x->Parent->Left)
+	{
+		x->Parent->Left = y;
+	}
+	else
+	{
+		x->Parent->Right = y;
+	}
+
+	y->Left = x;
+	x->Parent = y;
+}
+
+// Rotate the sub-tree pointed at by the node y to the right
+template <typename TKey, typename TValue, typename TCompare>
+void RBT<TKey, TValue, TCompare>::rotateRight(Node* x)
+{
+	auto y = static_cast<Node*>(x->Left);
+	x->Left = y->Right;
+	this->referenceChanges++;
+
+	if (y->Right != leafNodes)
+	{
+		this->referenceChanges++;
+		(static_cast<Node*>(y->Right))->Parent = x;
+	}
+	
+	this->referenceChanges += 4;
+	y->Parent = x->Parent;
+	if (x->Parent == leafNodes)
+	{
+		Root = y;
+	}
+	else if (x == x->Parent->Right)
+	{
+		x->Parent->Right = y;
+	}
+	else
+	{
+		x->Parent->Left = y;
+	}
+
+	y->Right = x;
+	x->Parent = y;
+}
+
+// Prints the sub-tree in order, skipping the leaf supernode
+template <typename TKey, typename TValue, typename TCompare>
+void RBT<TKey, TValue, TCompare>::inOrderPrint(typename Base::Node* node) const
+{
+	// Don't try to print the leaf supernode
+	if ((static_cast<Node*>(node))->isMasterLeaf()) return;
+
+	this->Base::inOrderPrint(node);
+}
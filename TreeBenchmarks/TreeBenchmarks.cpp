@@ -37,9 +37,10 @@
 
 using namespace std;
 
-BST* binarySearchTree;
-AVL* avlTree;
-RBT* redBlackTree;
+// The trees count the occurrences of each word they are given
+BST<string>* binarySearchTree;
+AVL<string>* avlTree;
+RBT<string>* redBlackTree;
 
 // When benchmarking random strings, they will be made up of these characters
 const string alphabet = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
@@ -49,8 +50,8 @@ void printHelp();
 inline string generateRandomString(size_t len);
 int runFileBenchmarks(Options options);
 int runRandomBenchmarks(Options options);
-double benchmarkFile(BST* tree, string path);
-double benchmarkRandom(BST* tree, size_t count, size_t itemLength);
+double benchmarkFile(BST<string>* tree, string path);
+double benchmarkRandom(BST<string>* tree, size_t count, size_t itemLength);
 
 int main(int argc, char* argv[])
 {
@@ -133,9 +134,9 @@ int runFileBenchmarks(Options options)
 	reader.close();
 
 	// initialize the trees
-	binarySearchTree = new BST();
-	avlTree = new AVL();
-	redBlackTree = new RBT();
+	binarySearchTree = new BST<string>();
+	avlTree = new AVL<string>();
+	redBlackTree = new RBT<string>();
 
 	// Run the benchmarks, recording the time
 	auto overhead = benchmarkFile(nullptr, path);
@@ -186,9 +187,9 @@ int runFileBenchmarks(Options options)
 int runRandomBenchmarks(Options options)
 {
 	// Initialize the trees
-	binarySearchTree = new BST();
-	avlTree = new AVL();
-	redBlackTree = new RBT();
+	binarySearchTree = new BST<string>();
+	avlTree = new AVL<string>();
+	redBlackTree = new RBT<string>();
 
 	// Run the benchmarks and record the times
 	auto bstTime = benchmarkRandom(binarySearchTree, options.RandomCount, options.RandomSize);
@@ -234,7 +235,7 @@ int runRandomBenchmarks(Options options)
 }
 
 // Run a file benchmark against the specified tree implementation and file
-double benchmarkFile(BST* tree, string path)
+double benchmarkFile(BST<string>* tree, string path)
 {
 	auto start = std::chrono::high_resolution_clock::now();
 
@@ -268,7 +269,7 @@ double benchmarkFile(BST* tree, string path)
 // Run a random benchmark against the specified tree, generating "count" random
 // alphanumeric strings of length "itemLength". Returns the time in milliseconds
 // it took to run
-double benchmarkRandom(BST* tree, size_t count, size_t itemLength)
+double benchmarkRandom(BST<string>* tree, size_t count, size_t itemLength)
 {
 	auto start = chrono::high_resolution_clock::now();
 